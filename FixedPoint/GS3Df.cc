@@ -49,16 +49,26 @@
 // ============================================================================
 
 #include <stdio.h>      // Standard input/output (printf, fgets, etc.)
-#include <asm.h>        // ORCA specific assembler functions
 #include <string.h>     // String manipulation (strlen, strcmp, etc.)
-#include <misctool.h>   // ORCA misc tools (GetTick, keypress, etc.)
 #include <stdlib.h>     // Standard functions (malloc, free, atof, etc.)
 #include <math.h>       // Math functions (cos, sin, sqrt, etc.)
+#ifdef __ORCAC__
+#include <asm.h>        // ORCA specific assembler functions
+#include <misctool.h>   // ORCA misc tools (GetTick, keypress, etc.)
 #include <quickdraw.h>  // Apple IIGS QuickDraw graphics API
 #include <event.h>      // System event management
 #include <memory.h>     // Advanced memory management (NewHandle, etc.)
 #include <window.h>     // Window management
 #include <orca.h>       // ORCA specific functions (startgraph, etc.)
+#else
+#include "host_toolbox.h" // Headless toolbox stand-ins (host profile)
+#include <pthread.h>    // Worker threads of the host thread pool (GS3D_THREADS)
+#include <unistd.h>     // sysconf (online CPU count)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <smmintrin.h>  // SSE4.1 intrinsics of the host vertex kernel (GS3D_SIMD)
+#include <cpuid.h>      // __get_cpuid: SSE4.1 present on this CPU
+#endif
+#endif
 
 // --- Variable globale pour la vérification des indices de sommet dans readFaces ---
 // (Ajouté pour garantir la cohérence OBJ)
@@ -69,6 +79,93 @@ int readVertices_last_count = 0;
 static Handle globalPolyHandle = NULL;
 static int poly_handle_locked = 0;  // Track lock state
 
+// --- Screen-space culling state (see calculateFaceDepths) ---
+// Threshold is adjustable at runtime with 'P'; counter is refreshed every frame
+static int subpixel_area_min;        // Minimum |2 x signed area| in pixels², 0 = off
+static int frame_culled_subpixel = 0; // Faces dropped by the area test in the last frame
+static int frame_culled_winding = 0;  // Faces dropped by the winding test in the last frame
+static int frame_clusters_accepted = 0; // Last frame: clusters facing the kept side as a whole
+static int frame_clusters_rejected = 0; // ... culled as a whole
+static int frame_clusters_partial = 0;  // ... tested face by face
+static int frame_octree_nodes = 0;     // Last frame: octree nodes visited
+static long frame_octree_outside = 0;  // ... faces skipped with their nodes
+static int frame_octree_listed = -1;   // ... faces handed to the depth pass, -1 = all (whole model in view),
+                                       // OCTREE_NOT_WALKED = convex or cached frame
+static long convex_frames = 0;        // Frames processed without depths or sort
+
+// --- Binary frame trace ('T' key, or every frame with ENABLE_DEBUG_SAVE) ---
+static FILE *trace_file = NULL;
+static long trace_frames = 0;
+
+// --- Vertex transform kernel (see transformVertices) ---
+static int transform_kernel = 1;           // KERNEL_SPLIT32 unless the self-check fails
+static int transform_kernel_checked = 0;   // 1 = split kernel verified bit-exact
+static int transform_kernel_simd = 0;      // 1 = SSE4.1 on this CPU and kernel verified bit-exact
+
+// --- Rasterization mode and tile binning report (see drawPolygons) ---
+static int render_mode = 0;                // RENDER_PAINTER, cycled with R
+static long tile_load_max = 0;             // Most faces binned to one tile, last tiled frame
+static long tile_load_total = 0;           // Face-in-tile references, last tiled frame
+static int tile_load_used = 0;             // Tiles with at least one face
+static int tile_load_raster = 0;           // 1 = last tiled frame painted by rasterTiles (pool)
+
+// --- Feature outlines (see FEATURE OUTLINES section) ---
+static int outline_mode = 0;               // OUTLINE_FRAME, toggled with O
+static Word outline_stamp = 0;             // Current outline pass (edges.stamp)
+static int outline_edges_drawn = 0;        // Last frame: feature edges drawn
+
+// --- Flat shading state (see FLAT SHADING section) ---
+static int shade_mode = 0;                 // 1 = Lambert flat shading, toggled with L
+static long shade_light_x = 0;             // Light direction of the current view,
+static long shade_light_y = 0;             // object space, Fixed32 >> 8
+static long shade_light_z = 0;
+
+// --- Off-screen frame (see offscreenBegin) ---
+static Handle offscreen_handle = NULL;     // Locked, page-aligned block of the pixel image
+static Byte *offscreen_pixels = NULL;      // Last frame, kept across endgraph (*offscreen_handle)
+static int offscreen_valid = 0;            // 1 = buffer holds the frame of the current geometry
+static int drawing_offscreen = 0;          // QuickDraw and fbPresent target the buffer
+static long offscreen_draws = 0;           // Frames drawn off-screen then flipped
+static long offscreen_blits = 0;           // Redraws served by a blit alone
+static int offscreen_have_frame = 0;       // Buffer holds the last complete frame
+static int prev_x0, prev_y0, prev_x1, prev_y1; // Its bounds (logical 320x200, [x0, x1))
+static int dirty_x0 = 0, dirty_y0 = 0;     // Region repainted this frame (logical, [x0, x1))
+static int dirty_x1 = 320, dirty_y1 = 200;
+static long dirty_pixels = 0;              // Last frame: pixels repainted
+static int dirty_faces_skipped = 0;        // Last frame: faces outside the region
+
+// --- Interruptible drawing (see renderPoll) ---
+static int render_interruptible = 1;       // Toggled with I
+static int frame_aborted = 0;              // Last drawPolygons stopped on a key
+static long render_polls = 0;              // Keyboard polls made while drawing
+static long render_aborts = 0;             // Frames abandoned
+static long nav_coalesced = 0;             // Navigation keys merged into a pending view change
+static int (*render_poll_hook)(void) = NULL; // Replaces the keyboard poll (headless tests)
+
+// --- Progressive refinement (see progressiveBegin) ---
+static int progressive_mode = 1;           // Toggled with G
+static int progressive_pending = 0;        // Coarse faces are in model->faces
+static int progressive_refining = 0;       // Full frame of this view being drawn
+static int progressive_saved_render = 0;   // Modes forced during the coarse pass
+static int progressive_saved_outline = 0;
+static int progressive_saved_cache = 0;
+static long progressive_start_ticks = 0;   // Tick of the last view change
+static long progressive_coarse_ticks = 0;  // View change -> coarse picture
+static long progressive_full_ticks = 0;    // View change -> full picture
+static long progressive_skipped = 0;       // Refinements dropped for a new key
+
+// --- Level of detail (see lodSelectLevel) ---
+static int lod_mode = 1;                   // Toggled with E
+static int lod_radius_px = 0;              // Last view: projected bounding radius (-1 = inside)
+
+// --- View cache state (see VIEW CACHE section) ---
+static int view_cache_mode = 0;           // VIEW_CACHE_OFF, cycled with V
+static long view_cache_bytes = 0;          // Bytes held by cached face orders
+static unsigned long view_cache_clock = 0; // LRU clock
+static long view_cache_hits = 0;
+static long view_cache_misses = 0;
+static int view_cache_dirty = 0;           // Vertex arrays / face order not the current view
+
 // ============================================================================
 //                            FIXED POINT DEFINITIONS
 // ============================================================================
@@ -85,7 +182,11 @@ static int poly_handle_locked = 0;  // Track lock state
  */
 
 // Basic fixed-point definitions
+#ifdef __ORCAC__
 typedef long Fixed32;           // 32-bit fixed point number (16.16)
+#else
+typedef int32_t Fixed32;        // 32-bit on every host (long is 64-bit on LP64)
+#endif
 typedef long long Fixed64;      // 64-bit for intermediate calculations
 
 #define FIXED_SHIFT     16                    // Number of fractional bits
@@ -167,20 +268,271 @@ static const Fixed32 deg_to_rad_table[361] = {
 #define FIXED_DIV_64(a, b)  ((Fixed32)(((Fixed64)(a) << FIXED_SHIFT) / (Fixed64)(b)))
 #define FIXED64_TO_32(x)    ((Fixed32)(x))
 
+// 32-bit-only multiplication on pre-split operands (transform kernel).
+// a = ah * 65536 + al with ah = a >> 16 (signed) and al = a & 0xFFFF, so
+// (a * b) >> 16 = ah*bh*65536 + ah*bl + al*bh + ((al*bl) >> 16) exactly:
+// same bits as FIXED_MUL_64, without any 64-bit arithmetic. Splitting an
+// operand once and reusing it across several products is the saving.
+#define FIXED_HI(a)         ((long)(a) >> FIXED_SHIFT)
+#define FIXED_LO(a)         ((unsigned long)(a) & 0xFFFFUL)
+#define FIXED_MUL_SPLIT(ah, al, bh, bl) \
+    ((Fixed32)(((unsigned long)((ah) * (bh)) << FIXED_SHIFT) \
+             + (unsigned long)((ah) * (long)(bl)) \
+             + (unsigned long)((long)(al) * (bh)) \
+             + (((al) * (bl)) >> FIXED_SHIFT)))
+#define FIXED_MUL_32(a, b)  FIXED_MUL_SPLIT(FIXED_HI(a), FIXED_LO(a), FIXED_HI(b), FIXED_LO(b))
+
 // ============================================================================
 //                            GLOBAL CONSTANTS
 // ============================================================================
 
 // Performance and debug configuration
-#define ENABLE_DEBUG_SAVE 0     // 1 = Enable debug save (SLOW!), 0 = Disable
+#define ENABLE_DEBUG_SAVE 0     // 1 = Trace every frame to TRACE_FILE from startup, 0 = only with 'T'
 //#define PERFORMANCE_MODE 0      // 1 = Optimized performance mode, 0 = Debug mode
 // OPTIMIZATION: Performance mode - disable printf
 #define PERFORMANCE_MODE 1      // 1 = no printf, 0 = normal printf
+#define ENABLE_STATS 1          // 1 = per-frame counters and timing ring ('S'/'D' keys), 0 = compiled out
+#define STATS_FILL_AREA 0       // 1 = shoelace area of every QuickDraw face into STAT_PIXELS_FILLED (2n multiplies per face)
 
 #define MAX_LINE_LENGTH 256     // Maximum file line size
-#define MAX_VERTICES 6000       // Maximum vertices in a 3D model
-#define MAX_FACES 6000          // Maximum faces in a 3D model (using parallel arrays)
+
+// Model size profile: GS3D_LARGE_MODELS = 0 keeps the compact 65816 layout
+// (Word indices and offsets, 16-bit int counters). GS3D_LARGE_MODELS = 1 is
+// for host builds loading meshes of hundreds of thousands of faces: 32-bit
+// indices and offsets, limits set by int and available memory only.
+// Defaults to the compact layout under ORCA/C, large everywhere else.
+// Host builds take the toolbox from host_toolbox.h (headless, no QuickDraw
+// output): cc -x c -std=gnu99 -O2 -pthread -o gs3df FixedPoint/GS3Df.cc -lm
+#ifndef GS3D_LARGE_MODELS
+#ifdef __ORCAC__
+#define GS3D_LARGE_MODELS 0
+#else
+#define GS3D_LARGE_MODELS 1
+#endif
+#endif
+
+// Host thread pool: GS3D_THREADS = 1 runs the transform, depth and radix
+// sort stages of large models in chunks on worker threads (pthreads, see
+// HOST THREAD POOL). Output is the same for any thread count. Off under
+// ORCA/C: the 65816 has one CPU and no threads.
+#ifndef GS3D_THREADS
+#ifdef __ORCAC__
+#define GS3D_THREADS 0
+#else
+#define GS3D_THREADS 1
+#endif
+#endif
+#define POOL_MAX_THREADS 16     // Threads of one stage, calling thread included ('F')
+#define POOL_MAX_CHUNKS 64      // Chunks of one stage (radix histograms: 64 x 1 KB)
+#define POOL_CHUNKS_PER_THREAD 4 // Chunks per thread: a slow chunk does not hold the others
+#define POOL_MIN_ITEMS 8192L    // Stages over fewer vertices or faces stay on the calling thread
+#define POOL_SCALING_REPS 5     // Timed runs per thread count in the scaling report ('Q')
+
+// SSE4.1 vertex kernel (KERNEL_SSE41): host x86 builds with GCC or Clang,
+// compiled through a target attribute (no -msse4.1 needed). Used only when
+// cpuid reports SSE4.1 and the kernel self-check finds it bit-exact.
+#ifndef GS3D_SIMD
+#if !defined(__ORCAC__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GS3D_SIMD 1
+#else
+#define GS3D_SIMD 0
+#endif
+#endif
+
+#if GS3D_LARGE_MODELS
+typedef unsigned int VertexIndex;   // 1-based vertex index stored in faces (32-bit on hosts)
+typedef unsigned int IndexOffset;   // Offset into the packed index buffer
+#define MAX_VERTICES 2147483647L    // Maximum vertices in a 3D model (int counters)
+#define MAX_FACES 2147483647L       // Maximum faces in a 3D model (int counters)
+#define MAX_TOTAL_INDICES 2147483647L // Packed index buffer: 32-bit offsets, long counters
+#else
+typedef Word VertexIndex;           // 1-based vertex index stored in faces
+typedef Word IndexOffset;           // Offset into the packed index buffer
+#define MAX_VERTICES 32767          // Maximum vertices in a 3D model (int counters, Word indices)
+#define MAX_FACES 32767             // Maximum faces in a 3D model (int counters)
+#define MAX_TOTAL_INDICES 65535L    // Packed index buffer is addressed with Word offsets
+#endif
 #define MAX_FACE_VERTICES 6     // Maximum vertices per face (triangles/quads/hexagons)
+#define DEPTH_SORT_RADIX 1      // 1 = stable byte-wise radix sort on z_max, 0 = quicksort
+#define SUBPIXEL_AREA_MIN 2     // Default culling threshold: |2 x area| below this is dropped
+#define AREA_COORD_LIMIT 8191   // Screen deltas above this skip the area test (32-bit safe)
+
+// View cache (precomputed face order for the 10-degree interaction grid)
+#define VIEW_CACHE_OFF   0      // Always depth-sort
+#define VIEW_CACHE_LAZY  1      // Remember views as they are rendered
+#define VIEW_CACHE_IDLE  2      // ... and precompute neighbouring views while waiting for a key
+#define VIEW_CACHE_SLOTS 64     // Maximum number of cached views
+#define VIEW_CACHE_BUDGET 65536L // Memory budget for cached face orders (bytes)
+#define VIEW_CACHE_STEP 10      // Angle step of the interaction grid (degrees)
+#define VIEW_CACHE_RADIUS 2     // Idle precompute covers +/- RADIUS grid steps around the view
+
+// Frame statistics (ENABLE_STATS): one counter per pipeline stage, see FrameStats
+#define STAT_VERTS_TRANSFORMED 0 // Vertices through transformVertices
+#define STAT_VERTS_BEHIND      1 // ... of which behind the camera (zo <= 0)
+#define STAT_FACES_BEHIND      2 // Faces hidden because a vertex is behind the camera
+#define STAT_FACES_WINDING     3 // Faces hidden by the winding test
+#define STAT_FACES_SUBPIXEL    4 // Faces hidden by the sub-pixel area test
+#define STAT_FACES_SORTED      5 // Faces through sortFacesByDepth (0 on a view cache hit)
+#define STAT_FACES_DRAWN       6 // Faces filled by drawPolygons
+#define STAT_PIXELS_FILLED     7 // Sum of drawn polygon areas (approximate pixels)
+#define STAT_TICKS_TRANSFORM   8 // Ticks in transform + projection
+#define STAT_TICKS_DEPTH       9 // Ticks in calculateFaceDepths (culling + z)
+#define STAT_TICKS_SORT       10 // Ticks in sortFacesByDepth
+#define STAT_TICKS_DRAW       11 // Ticks in drawPolygons
+#define STAT_STATE_CHANGES    12 // Pen and fill color switches issued by drawPolygons
+#define STAT_PIXELS_REPAINTED 13 // Pixels of the dirty rectangle cleared and redrawn
+#define STAT_LOD_LEVEL        14 // Level of detail processed (0 = full mesh)
+#define STAT_TRIANGLES        15 // Triangles of the processed faces (sum of vertex_count - 2)
+#define STAT_CLUSTERS_ACCEPTED 16 // Clusters wholly facing the kept side (no per-face winding test)
+#define STAT_CLUSTERS_REJECTED 17 // Clusters culled whole (no per-face work)
+#define STAT_CLUSTERS_PARTIAL  18 // Clusters tested face by face
+#define STAT_FACES_OUTSIDE     19 // Faces of octree nodes outside the view (no per-face work)
+#define STAT_OCTREE_NODES      20 // Octree nodes visited by the frustum walk
+#define STAT_COUNT            21
+#define STATS_RING_FRAMES     32 // Frames kept for the min/avg/p95 summary
+#define STATS_DUMP_FILE "stats.txt"
+
+#if ENABLE_STATS
+#define STATS_ADD(stat, n)  (stats_current.value[stat] += (long)(n))
+#else
+#define STATS_ADD(stat, n)  ((void)0)
+#endif
+
+// Binary frame trace (see traceWriteFrame, decoded offline by decode_trace.py)
+#define TRACE_FILE "trace.bin"
+#define TRACE_MAGIC 0x47533354L // "GS3T"
+#define TRACE_VERSION 3
+#define TRACE_HEADER_LONGS 18   // Frame header: 18 values of 4 bytes (little-endian), then the raw arrays
+
+// Keyboard data register: bit 7 set when a key is waiting (see main loop)
+#ifdef __ORCAC__
+#define KBD_DATA (*(volatile unsigned char *)0x00C000L)
+#define KBD_STROBE (*(volatile unsigned char *)0x00C010L)  // Write: clears bit 7 of KBD_DATA
+#else
+#define KBD_DATA host_kbd_data      // Host profile: no key ever waiting (host_toolbox.h)
+#define KBD_STROBE host_kbd_data
+#endif
+
+// Interruptible drawing (renderPoll, 'I' key)
+#define RENDER_POLL_FACES 16    // Faces (or edges) between keyboard polls, power of two
+
+// Vertex transform kernels (transformVertices, 'K' key)
+#define KERNEL_SCALAR64 0       // Reference: one FIXED_MUL_64 per product
+#define KERNEL_SPLIT32  1       // Operands split once, 32-bit products only (default)
+#define KERNEL_SSE41    2       // Host x86: 4 vertices per step, SSE4.1 (GS3D_SIMD, cpuid)
+#if GS3D_LARGE_MODELS
+#define KERNEL_TEST_VERTICES 1003 // Generated vertices per view in the kernel test ('U'), odd tail
+#define KERNEL_TEST_STEP 30     // Degrees between tested angles, each of h, v and w
+#else
+#define KERNEL_TEST_VERTICES 103 // Smaller grid on the 65816: 256 views instead of 6912
+#define KERNEL_TEST_STEP 90
+#endif
+
+// Rasterization modes (drawPolygons, 'R' key)
+#define RENDER_PAINTER 0        // Sorted faces filled back to front, whole screen
+#define RENDER_TILED   1        // Same order, binned per screen tile and drawn tile by tile
+#define RENDER_ZBUFFER 2        // No sort: software scanline fill with a 16-bit depth buffer
+#define RENDER_SBUFFER 3        // Sorted faces front to back, span coverage: each pixel written once
+#define RENDER_WIREFRAME 4      // No sort, no fill: each unique edge of the visible faces drawn once
+#define RENDER_MODE_COUNT 5
+
+// Edge list (buildEdgeList): hash buckets of the load-time deduplication
+#define EDGE_HASH_MAX 8192      // Power of two
+#define EDGE_CREASE   0x01      // Adjacent faces meet at more than CREASE_ANGLE degrees
+#define EDGE_BOUNDARY 0x02      // Only one adjacent face
+#define CREASE_ANGLE 40         // Degrees between face normals
+
+// OBJ materials (usemtl): per-face fill color
+#define MAX_MATERIALS 16        // Material 0 = faces before any usemtl
+#define MATERIAL_NAME_LEN 32
+#define DEFAULT_FILL_COLOR 14   // Faces without a material
+#define FRAME_COLOR 7           // FramePoly pen, never used as a fill
+#define MATERIAL_COLORS 14, 9, 11, 10, 6, 12, 13, 8, 4, 5, 2, 3, 1, 15  // Without Kd, in order of use
+
+// Progressive refinement ('G' key): coarse level drawn first on big models
+#define PROGRESSIVE_GRID 12         // Vertex clustering cells per axis
+#define PROGRESSIVE_MIN_FACES 400   // Smaller models are drawn at full detail directly
+
+// Distance level of detail ('E' key): edge-collapse meshes chosen by projected size
+#define LOD_LEVELS 4                // Level 0 = full mesh, level k ~ face_count >> k
+#define LOD_MIN_FACES 200           // Smaller models keep the full mesh only
+#define LOD_MAX_PASSES 24           // Greedy collapse passes per level
+#define LOD_THRESHOLDS 48, 24, 12   // Projected bounding radius (pixels) below which level 1, 2, 3 apply
+
+// Convex models: winding culling alone gives the image, no depth sort
+#define CONVEX_UNCHECKED -1         // Too many plane tests for the load (see CONVEX_MAX_TESTS)
+#define CONVEX_NO         0
+#define CONVEX_YES        1
+#define CONVEX_MAX_TESTS 20000L     // faces x vertices above this: not checked (load time)
+#define CONVEX_EPSILON 0.001        // Plane tolerance, fraction of the bounding radius
+#define CONVEX_GRID 8192.0          // Bounding radius on the integer test grid
+#define CONVEX_NORMAL_ONE 16384.0   // Unit normal on the integer test grid
+
+// Face clusters with normal cones (whole-cluster winding culling)
+#define CLUSTER_MAX_FACES 64        // Runs of 32..64 faces; models under 2x this have none
+#define CLUSTER_CONE_MARGIN 2.0     // Degrees added to each cone (Fixed32 axis, spread and eye)
+
+// Octree over face boxes (view frustum culling, see buildOctree)
+#define OCTREE_LEAF_FACES 32        // Nodes with more faces are split; models under 2x this have none
+#define OCTREE_MAX_DEPTH 6          // Levels below the root
+#define OCTREE_VIEW_SLOPE 1.89      // Screen half-diagonal (189 px, any angle_w) / projection scale (100)
+#define OCTREE_PLANE_NORM 2.139     // sqrt(1 + OCTREE_VIEW_SLOPE^2), rounded up
+#define OCTREE_SQRT3 1.7321         // Cube half edge -> bounding sphere radius
+#define OCTREE_NOT_WALKED (-2)      // frame_octree_listed of frames that need no depth pass
+
+// Face outlines of the fill modes ('O' key)
+#define OUTLINE_FRAME   0       // FramePoly on every face (default)
+#define OUTLINE_FEATURE 1       // Silhouette, crease and boundary edges only
+
+// Per-span operation of the software rasterizer
+#define RASTER_PAINT   0        // Write every pixel (back-to-front painter)
+#define RASTER_ZTEST   1        // Write where closer than the depth buffer
+#define RASTER_SBUFFER 2        // Write where no earlier (closer) span covers the pixel
+
+// Software rasterizer (z-buffer mode, render benchmark)
+#ifdef __ORCAC__
+#define SHR_SCREEN 0xE12000L    // Super Hi-Res pixel memory, 160 bytes per line
+#else
+#define SHR_SCREEN host_shr_screen
+#endif
+#define SHR_PIXEL_BYTES 32000L  // 200 lines of 160 bytes (320 and 640 modes)
+#define ZBUF_EDGE_BIAS 2        // Outline pixels pass within this many depth keys of the fill
+#define BENCH_FRAMES 8          // Views per model in the render benchmark
+#define BENCH_FILE "bench.txt"
+#define BENCH_MODELS "a.obj", "b.obj", "c1.obj", "cone.obj", "hexa.obj", "m.obj", "x.obj", "car2.obj", "car3.obj"
+
+// Screen tiles for RENDER_TILED (320x200 logical coordinates)
+#define TILE_W 80
+#define TILE_H 50
+#define TILES_X (320 / TILE_W)
+#define TILES_Y (200 / TILE_H)
+#define TILE_COUNT (TILES_X * TILES_Y)
+#define TILE_BINS_MAX 65536L    // Face-in-tile references; beyond, the frame is drawn by the painter
+
+// Flat shading ('L' key): grey ramp in palette entries 1..SHADE_LEVELS, with
+// SHADE_DITHER ordered-dither steps between two neighbouring entries
+#define SHADE_LEVELS 15
+#define SHADE_DITHER 4
+#define SHADE_COUNT ((SHADE_LEVELS - 1) * SHADE_DITHER + 1)  // Shades, darkest first
+#define SHADE_AMBIENT 6          // Shade of a face lit edge-on
+#define SHADE_NORMAL_ONE 127     // Face normals stored as signed bytes, 127 = 1.0
+#define SHADE_FRAME 0            // 1 = keep the FramePoly outline pass when shading
+// Light direction on screen (unit vector toward the light): upper left, from the viewer
+#define SHADE_LIGHT_X (-26214L)  // -0.40
+#define SHADE_LIGHT_Y 32768L     //  0.50
+#define SHADE_LIGHT_Z (-50332L)  // -0.768
+
+// Screen-space winding culling modes (Model3D.cull_mode)
+#define CULL_NONE  0            // Draw every face (default: some OBJ files mix windings)
+#define CULL_BACK  1            // Drop faces that appear clockwise on screen
+#define CULL_FRONT 2            // Drop faces that appear counter-clockwise on screen
+
+// Result of the per-face depth pass (faceDepth), counted by the callers
+#define FACE_SHOWN           0  // Display bit to set
+#define FACE_CULLED_WINDING  1  // Rejected winding (frame_culled_winding)
+#define FACE_CULLED_SUBPIXEL 2  // Under subpixel_area_min (frame_culled_subpixel)
+#define FACE_CULLED_BEHIND   3  // A vertex at zo <= 0 (STAT_FACES_BEHIND)
+#define FACE_RESULTS         4
 #define PI 3.14159265359        // Mathematical constant Pi
 #define CENTRE_X 160            // Screen center in X (320/2)
 #define CENTRE_Y 100            // Screen center in Y (200/2)
@@ -221,6 +573,39 @@ typedef struct {
     int vertex_count;
 } VertexArrays3D;
 
+/**
+ * Structure FaceCluster
+ * 
+ * DESCRIPTION:
+ *   A run of faces that share a bounding sphere and a normal cone
+ *   (see FACE CLUSTERS). Rejected or accepted as a whole by the winding
+ *   culling of calculateFaceDepths.
+ */
+typedef struct {
+    int first;                  // First face of the run (faces are stored in cluster order)
+    int count;
+    Fixed32 cx, cy, cz;         // Bounding sphere, object space
+    Fixed32 radius;
+    Fixed32 ax, ay, az;         // Unit cone axis
+    Fixed32 spread;             // 2 sin(half-angle / 2), -1 = cone too wide to test
+} FaceCluster;
+
+/**
+ * Structure OctreeNode
+ * 
+ * DESCRIPTION:
+ *   A cube of the octree over the face boxes (see OCTREE OVER FACE BOXES).
+ *   Its own faces and those of its subtree are ranges of octree_faces.
+ */
+typedef struct {
+    Fixed32 cx, cy, cz;         // Cube centre, object space
+    Fixed32 half;               // Half edge
+    int child;                  // First of 8 consecutive children, -1 = leaf
+    int first;                  // Own faces: octree_faces[first..first + count)
+    int count;
+    int total;                  // Faces of the subtree: octree_faces[first..first + total)
+} OctreeNode;
+
 /**
  * Structure FaceArrays3D - Compact dynamic face storage with depth-sorted rendering
  * Each face stores ONLY the vertices it needs:
@@ -229,13 +614,20 @@ typedef struct {
  * - vertex_indices_ptr: Offset array pointing to each face's slice in the buffer
  * - sorted_face_indices: Array of face indices SORTED by depth (for painter's algorithm)
  * - z_max: Depth for sorting
- * - display_flag: Culling flag
+ * - display_flag: Culling bitset, one bit per face (see FACE_VISIBLE)
  * 
  * MEMORY LAYOUT:
  * Instead of 4 arrays of 6000 elements each, we use ONE packed buffer.
  * Triangles (1538 faces × 3 indices) + Quads (2504 faces × 4 indices) = packed linearly
  * Saves ~40-60% memory vs fixed 4 vertices/face
  * 
+ * COMPACT TYPES:
+ * Arrays are sized exactly from the file (scanObjCounts pre-pass), not MAX_FACES.
+ * Indices and offsets are VertexIndex/IndexOffset (Word on the 65816 profile,
+ * 32-bit with GS3D_LARGE_MODELS), vertex counts Byte, visibility 1 bit.
+ * For car2.obj (2504 quads) that is 2504 + 2504*4*2 + 2504*2 + 313 bytes
+ * instead of 6000*(4+5*4+4+4) bytes with the old int layout.
+ * 
  * DEPTH SORTING STRATEGY:
  * Instead of moving data around (complex with variable-length indices), we maintain
  * sorted_face_indices[] which contains face numbers in depth order (farthest first).
@@ -243,23 +635,46 @@ typedef struct {
  * This keeps the buffer untouched while providing correct rendering order.
  */
 typedef struct {
-    Handle vertex_countHandle;           // 1 array: face_count × 4 bytes
+    Handle vertex_countHandle;           // 1 array: face_count × 1 byte
     Handle vertex_indicesBufferHandle;   // 1 buffer: all indices packed (NO WASTED SLOTS!)
     Handle vertex_indicesPtrHandle;      // 1 array: offset to each face's indices
     Handle z_maxHandle;                  // 1 array: face_count × 4 bytes
-    Handle display_flagHandle;           // 1 array: face_count × 4 bytes
+    Handle display_flagHandle;           // 1 bitset: (face_count + 7) / 8 bytes
     Handle sorted_face_indicesHandle;    // 1 array: face numbers sorted by depth
     
-    int *vertex_count;                   // Points to: [3, 3, 4, 3, 4, ...]
-    int *vertex_indices_buffer;          // Points to: [v1, v2, v3, v1, v2, v3, v4, v1, v2, v3, ...]
-    int *vertex_indices_ptr;             // Points to: [offset0, offset3, offset6, offset10, ...]
+    Byte *vertex_count;                  // Points to: [3, 3, 4, 3, 4, ...]
+    VertexIndex *vertex_indices_buffer;  // Points to: [v1, v2, v3, v1, v2, v3, v4, v1, v2, v3, ...]
+    IndexOffset *vertex_indices_ptr;     // Points to: [offset0, offset3, offset6, offset10, ...]
     Fixed32 *z_max;
-    int *display_flag;
+    Byte *display_flag;                  // Bit (i & 7) of byte (i >> 3) = face i visible
     int *sorted_face_indices;            // Points to: [face_id1, face_id2, ...] sorted by z_max
+    int *sort_scratch;                   // Second index buffer for the radix sort passes
+    Byte *color;                         // Fill color (palette index) from the face material
+    signed char *normal_x;               // Unit face normal (object space), x SHADE_NORMAL_ONE
+    signed char *normal_y;
+    signed char *normal_z;
     int face_count;                      // Actual number of loaded faces
-    int total_indices;                   // Total indices across all faces (sum of all vertex_counts)
+    int draw_count;                      // Entries of sorted_face_indices to draw this frame
+    int face_capacity;                   // Faces the carved arrays can hold (from pre-scan)
+    long index_capacity;                 // Indices the packed buffer can hold (from pre-scan)
+    long total_indices;                  // Total indices across all faces (sum of all vertex_counts)
+    int degenerate_removed;              // Faces dropped at load (repeated indices, < 3 vertices)
+    int material_count;                  // Distinct usemtl names (0 = no materials)
+    int triangle_count;                  // Sum of (vertex_count - 2): triangles drawn for all faces
+    int convex;                          // CONVEX_* (only the loaded faces are ever checked)
+    FaceCluster *clusters;               // Own block, loaded faces only (NULL on derived levels)
+    int *cluster_source;                 // Loaded face number of each face before clustering (NULL = same order)
+    int cluster_count;
+    OctreeNode *octree;                  // Own blocks, loaded faces only (NULL on derived levels)
+    int *octree_faces;                   // Face numbers, node by node
+    int octree_nodes;
 } FaceArrays3D;
 
+// Visibility bitset access (FaceArrays3D.display_flag)
+#define FACE_FLAG_BYTES(n)       (((n) + 7) >> 3)
+#define FACE_VISIBLE(bits, i)    ((bits)[(i) >> 3] & (Byte)(1 << ((i) & 7)))
+#define FACE_SET_VISIBLE(bits, i) ((bits)[(i) >> 3] |= (Byte)(1 << ((i) & 7)))
+
 /**
  * Structure Face3D
  * 
@@ -338,6 +753,127 @@ typedef struct {
     Fixed32 distance;  // Observer-object distance (perspective, Fixed Point)
 } ObserverParams;
 
+/**
+ * Structure ModelArena
+ * 
+ * DESCRIPTION:
+ *   One malloc'd block holding every SoA array of a model (vertices and
+ *   faces). Its size comes from a pre-scan of the file (scanObjCounts), so
+ *   a model takes exactly the memory it needs, destroying it is one free(),
+ *   and loading another model ('N') reuses the block when it is big enough.
+ * 
+ * FIELDS:
+ *   base     : Start of the block (NULL until the first load)
+ *   capacity : Size of the block in bytes
+ *   used     : Bytes already carved for the current model
+ */
+typedef struct {
+    char *base;
+    long capacity;
+    long used;
+} ModelArena;
+
+/**
+ * Structure ViewCacheEntry
+ * 
+ * DESCRIPTION:
+ *   One cached view of the interaction grid: the culled, depth-sorted face
+ *   order computed for (angle_h, angle_v, distance). The screen rotation
+ *   angle_w does not change the order, so it is not part of the key.
+ * 
+ * FIELDS:
+ *   angle_h, angle_v : Key, whole degrees normalized to 0..359
+ *   distance         : Key, the view is only valid for this distance
+ *   count            : Number of visible faces in 'order'
+ *   order            : Visible face numbers, farthest first (malloc'd)
+ *   last_used        : LRU stamp (view_cache_clock at last hit or store)
+ */
+typedef struct {
+    int angle_h, angle_v;
+    Fixed32 distance;
+    int count;
+    int *order;
+    unsigned long last_used;
+} ViewCacheEntry;
+
+/**
+ * Structure FrameStats
+ * 
+ * DESCRIPTION:
+ *   Counters of one rendered frame, indexed by the STAT_* constants.
+ *   stats_current is filled while the frame runs (STATS_ADD) and pushed
+ *   into the ring buffer by statsEndFrame().
+ */
+typedef struct {
+    long value[STAT_COUNT];
+} FrameStats;
+
+#if ENABLE_STATS
+static FrameStats stats_current;      // Frame being measured
+#endif
+
+/**
+ * Structure FrameBuffer
+ * 
+ * DESCRIPTION:
+ *   Software render target: one color index byte per pixel and, for the
+ *   z-buffer, one 16-bit depth key per pixel (see SOFTWARE RASTERIZER).
+ *   For the S-buffer, each row keeps a sorted list of covered intervals.
+ *   Disjoint, non-adjacent intervals need at least one free pixel between
+ *   them, so width / 2 + 1 per row can never overflow.
+ *   Width and height are free, so the render benchmark can run above the
+ *   screen resolution. The rasterizer only writes inside the clip
+ *   rectangle (the whole buffer after fbReserve). A tile task draws
+ *   through a copy of the structure with its own clip rectangle and
+ *   pixel counters, sharing the pixels.
+ */
+typedef struct {
+    int width, height;
+    long capacity;                    // Pixels the buffers can hold
+    Byte *color;                      // width x height color indices
+    Word *depth;                      // width x height depth keys (NULL until needed)
+    Word *span_start, *span_end;      // S-buffer: covered [start, end) intervals, per row
+    int *span_count;                  // S-buffer: intervals used on each row
+    int span_row_capacity;            // S-buffer: intervals each row can hold (width / 2 + 1)
+    int clip_x0, clip_y0;             // Pixels drawn: clip_x0 <= x < clip_x1, clip_y0 <= y < clip_y1
+    int clip_x1, clip_y1;
+    long pixels_rasterized;           // Span pixels produced since last reset
+    long pixels_written;              // ... of which actually written (passed the test)
+    long pixels_covered;              // S-buffer: pixels covered so far this frame
+} FrameBuffer;
+
+/**
+ * Structure EdgeArrays3D
+ * 
+ * DESCRIPTION:
+ *   Unique edges of the model, built once at load from the face index
+ *   buffer (buildEdgeList). An edge shared by two faces appears once.
+ * 
+ * FIELDS:
+ *   v0, v1       : 1-based vertex indices, v0 < v1
+ *   face0, face1 : adjacent faces; face1 = -1 on a boundary edge. Edges of
+ *                  non-manifold meshes keep their first two faces
+ *   flags        : EDGE_CREASE / EDGE_BOUNDARY, view independent
+ *   face_edge    : per slot of vertex_indices_buffer, the edge from that
+ *                  vertex to the next one of the face
+ *   stamp        : outline pass bookkeeping (see drawFeatureEdges)
+ *   face_stamp   : per face, the last outline pass that paints it
+ *   front        : per-face bitset, faces turned toward the observer
+ *                  (outlineSetView, FACE_VISIBLE macros)
+ *   block        : single malloc block backing all the arrays
+ */
+typedef struct {
+    VertexIndex *v0, *v1;
+    int *face0, *face1;
+    int *face_edge;
+    Word *stamp;
+    Word *face_stamp;
+    Byte *flags;
+    Byte *front;
+    int edge_count;
+    void *block;
+} EdgeArrays3D;
+
 /**
  * Structure Model3D
  * 
@@ -350,9 +886,10 @@ typedef struct {
  *   faces         : Pointer to dynamic face array
  *   vertex_count  : Actual number of loaded vertices
  *   face_count    : Actual number of loaded faces
+ *   cull_mode     : Screen-space winding culling for this model (see CULL_*)
  * 
  * MEMORY MANAGEMENT:
- *   - Arrays are dynamically allocated (malloc)
+ *   - All arrays are carved from one arena block (malloc)
  *   - Allows exceeding Apple IIGS stack limits
  *   - Mandatory cleanup with destroyModel3D()
  * 
@@ -365,6 +902,19 @@ typedef struct {
 typedef struct {
     VertexArrays3D vertices;          // Parallel arrays for all vertex data
     FaceArrays3D faces;               // Parallel arrays for all face data
+    int cull_mode;                    // CULL_NONE / CULL_BACK / CULL_FRONT (winding test)
+    ModelArena arena;                 // Single block backing all the arrays above
+    EdgeArrays3D edges;               // Unique edges (own block, sized after deduplication)
+    FaceArrays3D coarse;              // Decimated faces over the same vertices (progressive pass)
+    void *coarse_block;               // Single block backing the coarse arrays
+    FaceArrays3D lod[LOD_LEVELS];     // Edge-collapse levels over the same vertices (lod[0] unused)
+    void *lod_block[LOD_LEVELS];      // One block per level
+    int lod_count;                    // Levels available, full mesh included
+    int lod_active;                   // Level in faces; lod[lod_active] then holds the full mesh
+    Fixed32 bound_x, bound_y, bound_z; // Bounding sphere centre (object space)
+    Fixed32 bound_r;                  // ... and radius (0 = empty model)
+    long convex_tests;                // Vertex/plane tests made by detectConvex
+    Fixed32 eye_x, eye_y, eye_z;      // Observer in object space, set by transformVertices
 } Model3D;
 
 // ============================================================================
@@ -410,6 +960,134 @@ Fixed32 cos_fixed(Fixed32 angle);
  */
 int readVertices(const char* filename, VertexArrays3D* vtx, int max_vertices);
 
+/**
+ * scanObjCounts
+ * 
+ * DESCRIPTION:
+ *   Quick pre-pass counting "v " lines, "f " lines and the indices on each
+ *   face, without converting any number. Used to size the model arena.
+ * 
+ * RETURN:
+ *   0 on success, -1 if the file cannot be opened
+ */
+int scanObjCounts(const char* filename, int* vertex_count, int* face_count, long* index_count);
+
+/**
+ * Arena functions
+ * 
+ * DESCRIPTION:
+ *   arenaReserve : makes sure the block holds at least 'bytes' (reuses it if
+ *                  possible) and resets it to empty. 0 on success, -1 on error.
+ *   arenaCarve   : returns the next 'bytes' of the block (4-byte aligned)
+ *   arenaRelease : frees the block
+ *   carveModelArrays : sizes the arena for the given counts and points every
+ *                  vertex and face array of the model into it
+ */
+int arenaReserve(ModelArena* arena, long bytes);
+void* arenaCarve(ModelArena* arena, long bytes);
+void arenaRelease(ModelArena* arena);
+int carveModelArrays(Model3D* model, int vertex_count, int face_count, long index_count);
+int readFaces_model(const char* filename, Model3D* model);
+
+/**
+ * buildEdgeList / releaseEdgeList
+ * 
+ * DESCRIPTION:
+ *   Deduplicates the edges of every face into model->edges with their two
+ *   adjacent faces (hash on the vertex pair, temporary tables freed on
+ *   return). Replaces the list of a previous model.
+ * 
+ * RETURN:
+ *   Number of unique edges, or -1 on memory error (list left empty)
+ */
+int buildEdgeList(Model3D* model);
+void releaseEdgeList(EdgeArrays3D* edges);
+
+/**
+ * buildCoarseLevel / releaseCoarseLevel
+ * 
+ * DESCRIPTION:
+ *   Decimates the faces by vertex clustering on a PROGRESSIVE_GRID grid
+ *   over the Fixed32 bounding box into model->coarse, which shares the
+ *   vertex arrays. Only built for models of PROGRESSIVE_MIN_FACES faces
+ *   or more, and kept only if it removes at least a quarter of them.
+ * 
+ * RETURN:
+ *   Number of coarse faces (0 = no coarse level), or -1 on memory error
+ */
+int buildCoarseLevel(Model3D* model);
+void releaseCoarseLevel(Model3D* model);
+
+/**
+ * buildLodLevels / releaseLodLevels
+ * 
+ * DESCRIPTION:
+ *   Computes the bounding sphere, then, for models of LOD_MIN_FACES faces
+ *   or more, up to LOD_LEVELS - 1 decimated levels by quadric error edge
+ *   collapse into model->lod[1..]. Levels share the vertex arrays and are
+ *   only kept while they keep reducing the face count.
+ * 
+ * RETURN:
+ *   Number of levels below the full mesh, or -1 on memory error
+ */
+int buildLodLevels(Model3D* model);
+void releaseLodLevels(Model3D* model);
+
+/**
+ * lodSelectLevel / lodActivate
+ * 
+ * DESCRIPTION:
+ *   lodSelectLevel returns the level for a view from the projected
+ *   bounding sphere (0 when LOD is off or a mode needs the full faces);
+ *   lodActivate swaps that level into model->faces.
+ */
+int lodSelectLevel(Model3D* model, ObserverParams* params);
+void lodActivate(Model3D* model, int level);
+
+/**
+ * detectConvex
+ * 
+ * DESCRIPTION:
+ *   Sets model->faces.convex: CONVEX_YES when every vertex lies behind or
+ *   on every face plane, with the same side for all faces (consistent
+ *   winding). Stops at the first vertex in front of a plane; models above
+ *   CONVEX_MAX_TESTS vertex/plane pairs are left CONVEX_UNCHECKED.
+ * 
+ * RETURN:
+ *   The CONVEX_* result
+ */
+int detectConvex(Model3D* model);
+
+/**
+ * buildFaceClusters / releaseFaceClusters
+ * 
+ * DESCRIPTION:
+ *   Reorders the loaded faces into clusters of at most CLUSTER_MAX_FACES
+ *   faces (same dominant normal, close centroids) and stores a bounding
+ *   sphere and a normal cone per cluster. Must run after the face normals
+ *   and before anything that stores face numbers (edges, levels). The
+ *   loaded number of each face is kept in faces.cluster_source.
+ * 
+ * RETURN:
+ *   Number of clusters (0 for small models), or -1 on memory error
+ */
+int buildFaceClusters(Model3D* model);
+void releaseFaceClusters(FaceArrays3D* faces);
+
+/**
+ * buildOctree / releaseOctree
+ * 
+ * DESCRIPTION:
+ *   Builds the octree over the bounding boxes of the loaded faces (at most
+ *   OCTREE_LEAF_FACES faces per leaf, OCTREE_MAX_DEPTH levels). Must run
+ *   after buildFaceClusters, which renumbers the faces.
+ * 
+ * RETURN:
+ *   Number of nodes (0 for small models), or -1 on memory error
+ */
+int buildOctree(Model3D* model);
+void releaseOctree(FaceArrays3D* faces);
+
 /**
  * readFaces
  * 
@@ -523,17 +1201,129 @@ void projectTo2D(VertexArrays3D* vtx, Fixed32 angle_w);
  *   - Faces with less than 3 visible vertices ignored
  *   - Off-screen vertices handled correctly
  */
-void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_count_total);
+void drawPolygons(Model3D* model, Byte* vertex_count, int face_count, int vertex_count_total);
+
+/**
+ * drawPolygonsTiled
+ * 
+ * DESCRIPTION:
+ *   RENDER_TILED path of drawPolygons: bins the first face_count sorted
+ *   faces into TILE_COUNT screen tiles, then draws each tile with its own
+ *   clip rectangle. Updates tile_load_max/total/used. Returns -1, nothing
+ *   drawn, when the bins exceed TILE_BINS_MAX or cannot be allocated.
+ */
+int drawPolygonsTiled(Model3D* model, int face_count, Handle polyHandle);
+
+/**
+ * SOFTWARE RASTERIZER FUNCTIONS
+ * =============================
+ * 
+ * fbReserve / fbRelease / fbClear : frame buffer management
+ * fbPresent            : copies a 320x200 frame buffer to the SHR screen
+ *                        (or to the off-screen frame while drawing there)
+ * offscreenBegin/End   : redirect QuickDraw to the off-screen frame, limited
+ *                        to the dirty rectangle of the new frame
+ * dirtyClip            : ClipRect to a logical rectangle within the dirty one
+ * offscreenBlit        : copies the off-screen frame to the SHR screen
+ * rasterReserve        : per-vertex raster arrays for vertex_count vertices
+ * rasterPrepareVertices: frame buffer coordinates and depth keys per vertex
+ * zbufferReady         : 1 when this frame really draws through the z-buffer
+ * rasterFace           : fills and frames one face, optionally depth tested
+ * rasterTiles          : paints the binned tiles, each clipped to its tile
+ *                        (on the pool threads with GS3D_THREADS)
+ * drawTilesRaster      : RENDER_TILED through rasterTiles on the screen
+ *                        frame buffer, -1 when QuickDraw must draw the tiles
+ * drawPolygonsZBuffer  : RENDER_ZBUFFER path of drawPolygons
+ * sbufReserve          : allocates the S-buffer span lists of a frame buffer
+ * drawPolygonsSBuffer  : RENDER_SBUFFER path of drawPolygons
+ * drawPolygonsWireframe: RENDER_WIREFRAME path of drawPolygons
+ * runRenderBenchmark   : sort + paint versus z-buffer over BENCH_MODELS
+ */
+int fbReserve(FrameBuffer* fb, int width, int height, int with_depth);
+void fbRelease(FrameBuffer* fb);
+void fbClear(FrameBuffer* fb, Byte color, int clear_depth);
+void fbPresent(FrameBuffer* fb);
+int offscreenBegin(Model3D* model);
+int dirtyClip(int x0, int y0, int x1, int y1);
+void offscreenEnd(void);
+void offscreenBlit(void);
+int rasterReserve(long vertex_count);
+int rasterPrepareVertices(Model3D* model, FrameBuffer* fb);
+int zbufferReady(Model3D* model);
+void rasterFace(FrameBuffer* fb, Model3D* model, int face_id, int raster_op);
+long rasterTiles(FrameBuffer* fb, Model3D* model);
+int drawTilesRaster(Model3D* model);
+int drawPolygonsZBuffer(Model3D* model, int face_count);
+int sbufReserve(FrameBuffer* fb);
+int drawPolygonsSBuffer(Model3D* model, int face_count);
+void drawPolygonsWireframe(Model3D* model);
+void runRenderBenchmark(ObserverParams* params);
 void calculateFaceDepths(Model3D* model, Face3D* faces, int face_count);
+void calculateFaceDepthsList(Model3D* model, int count);
+int octreeCollect(Model3D* model, ObserverParams* params);
+int calculateViewDepths(Model3D* model, ObserverParams* params);
+int convexFastPath(Model3D* model);
+void cullFacesConvex(Model3D* model);
 void sortFacesByDepth(Model3D* model, int face_count);
 void sortFacesByDepth_insertion(FaceArrays3D* faces, int face_count);
 void sortFacesByDepth_insertion_range(FaceArrays3D* faces, int low, int high);
 void sortFacesByDepth_quicksort(FaceArrays3D* faces, int low, int high);
 int sortFacesByDepth_partition(FaceArrays3D* faces, int low, int high);
+void sortFacesByDepth_radix(FaceArrays3D* faces, int face_count);
 int partition_median3(Face3D* faces, int low, int high);
 
-// Function to save debug data to disk
-void saveDebugData(Model3D* model, const char* debug_filename);
+/**
+ * BINARY FRAME TRACE
+ * ==================
+ * 
+ * traceOpen       : creates 'filename' and starts a capture
+ * traceWriteFrame : appends the raw arrays of the current frame
+ * traceClose      : ends the capture, returns the number of frames written
+ */
+int traceOpen(const char* filename);
+void traceWriteFrame(Model3D* model, ObserverParams* params);
+long traceClose(void);
+
+/**
+ * FLAT SHADING
+ * ============
+ * 
+ * computeFaceNormals : unit normal of every face, once at load (Newell method)
+ * shadeSetView       : light direction of the current view, in object space
+ * shadeSetPalette    : loads the grey ramp into palette 0 (after startgraph)
+ */
+void computeFaceNormals(Model3D* model);
+void shadeSetView(ObserverParams* params);
+void shadeSetPalette(void);
+
+/**
+ * FEATURE OUTLINES
+ * ================
+ * 
+ * outlineSetView   : marks the faces turned toward the observer (edges.front)
+ * outlineBeginPass : starts a painter pass over 'count' faces of 'list'
+ *                    (shared edges drawn once per pass)
+ * drawFeatureEdges : silhouette, crease and boundary edges of one face
+ */
+void outlineSetView(Model3D* model);
+void outlineBeginPass(Model3D* model, const int* list, long count);
+void drawFeatureEdges(Model3D* model, int face_id);
+
+/**
+ * FRAME PRESENTATION
+ * ==================
+ * 
+ * renderFrame      : draws the processed frame off-screen and flips it
+ * renderSetPollHook: replaces the keyboard poll of interruptible drawing
+ * runAbortCheck    : forces aborts at known polls, checks the counters
+ * progressiveBegin : swaps the coarse faces in for a first quick frame
+ * progressiveEnd   : swaps the full faces back
+ */
+void renderFrame(Model3D* model);
+void renderSetPollHook(int (*hook)(void));
+int runAbortCheck(Model3D* model);
+void progressiveBegin(Model3D* model);
+void progressiveEnd(Model3D* model);
 
 /**
  * UTILITY FUNCTIONS
@@ -565,17 +1355,15 @@ void delay(int seconds);
  * createModel3D
  * 
  * DESCRIPTION:
- *   Creates and initializes a new Model3D structure with dynamic
- *   allocation of vertex and face arrays.
+ *   Creates and initializes a new, empty Model3D structure.
+ *   Vertex and face arrays are allocated by loadModel3D().
  * 
  * RETURN:
  *   Pointer to the new structure, or NULL on memory error
  * 
  * MEMORY MANAGEMENT:
- *   - Main structure allocation
- *   - Vertex array allocation (MAX_VERTICES)
- *   - Face array allocation (MAX_FACES)
- *   - Automatic cleanup on partial failure
+ *   - Main structure allocation only
+ *   - Arena block sized at load time (exact size from file)
  */
 Model3D* createModel3D(void);
 
@@ -589,8 +1377,9 @@ Model3D* createModel3D(void);
  *   model : Pointer to the model to destroy (can be NULL)
  * 
  * CLEANUP:
- *   - Vertex array
- *   - Face array  
+ *   - Arena block (all vertex and face arrays)
+ *   - Edge list block
+ *   - Coarse level block
  *   - Main structure
  */
 void destroyModel3D(Model3D* model);
@@ -610,6 +1399,8 @@ void destroyModel3D(Model3D* model);
  *   0 on success, -1 on error
  * 
  * PROCESSING:
+ *   - Count elements with scanObjCounts()
+ *   - Carve exact-size arrays from the arena (reused across loads)
  *   - Read vertices with readVertices()
  *   - Read faces with readFaces()
  *   - Update counters in the structure
@@ -640,6 +1431,18 @@ int loadModel3D(Model3D* model, const char* filename);
  */
 void getObserverParams(ObserverParams* params);
 
+/**
+ * applyNavigationKey
+ * 
+ * DESCRIPTION:
+ *   Applies a view key (A/Z distance, arrows, W/X screen rotation) to the
+ *   observer parameters.
+ * 
+ * RETURN:
+ *   1 if the key is a navigation key, 0 otherwise (params unchanged)
+ */
+int applyNavigationKey(ObserverParams* params, int key);
+
 /**
  * displayModelInfo
  * 
@@ -678,6 +1481,96 @@ void displayResults(Model3D* model);
  */
 void processModelFast(Model3D* model, ObserverParams* params, const char* filename);
 
+/**
+ * transformVertices
+ * 
+ * DESCRIPTION:
+ *   The vertex stage of processModelFast: rotation, translation and
+ *   perspective projection of every vertex (xo, yo, zo, x2d, y2d).
+ */
+void transformVertices(Model3D* model, ObserverParams* params);
+
+/**
+ * transformKernelSelfCheck
+ * 
+ * DESCRIPTION:
+ *   Runs the vertex kernels on the loaded model (and FIXED_MUL_32 on edge
+ *   values) and compares the results bit for bit. Selects KERNEL_SSE41
+ *   when the CPU has it and it agrees, else KERNEL_SPLIT32 when it agrees,
+ *   falls back to KERNEL_SCALAR64 otherwise.
+ * 
+ * RETURNS:
+ *   1 if the kernels agree, 0 on any mismatch, -1 if no memory for the check
+ */
+int transformKernelSelfCheck(Model3D* model, ObserverParams* params);
+
+/**
+ * runTransformKernelTest
+ * 
+ * DESCRIPTION:
+ *   'U' key, runs headless. Every kernel against transformVertices_scalar64
+ *   on generated vertices (edge values, random coordinates, vertices behind
+ *   the observer) over a grid of views, independent of the loaded model.
+ * 
+ * RETURNS:
+ *   Number of views where a kernel differs from the reference, -1 if no memory
+ */
+int runTransformKernelTest(void);
+
+/**
+ * VIEW CACHE FUNCTIONS
+ * ====================
+ * 
+ * viewCacheLookup : on a hit, copies the cached face order into
+ *                   sorted_face_indices and returns 1 (no depth/sort needed)
+ * viewCacheStore  : remembers the current sorted, culled order for 'params'
+ *                   (evicts least recently used views if allow_evict)
+ * viewCacheFlush  : forgets every view (model, distance or culling changed)
+ * viewCachePrecomputeStep : builds one missing neighbouring view; returns 1
+ *                   when it was stored, -1 when it did not fit (vertex arrays
+ *                   overwritten all the same), 0 when there is nothing left
+ *                   to do within the budget
+ */
+int viewCacheLookup(Model3D* model, ObserverParams* params);
+int viewCacheStore(Model3D* model, ObserverParams* params, int allow_evict);
+void viewCacheFlush(void);
+int viewCachePrecomputeStep(Model3D* model, ObserverParams* params);
+int normalizeDegrees(Fixed32 angle);
+
+#if ENABLE_STATS
+/**
+ * FRAME STATISTICS FUNCTIONS
+ * ==========================
+ * 
+ * statsBeginFrame : clears the counters of the frame about to be processed
+ * statsEndFrame   : pushes the current counters into the ring buffer
+ * statsDropFrame  : clears the counters of an aborted frame, keeps it out of the ring
+ * statsSummary    : min/avg/p95 of every counter over the ring to 'out'
+ * statsDump       : summary followed by one line per recorded frame
+ */
+void statsBeginFrame(void);
+void statsEndFrame(void);
+void statsDropFrame(void);
+void statsSummary(FILE* out);
+int statsDump(const char* filename);
+#endif
+
+#if GS3D_THREADS
+/**
+ * HOST THREAD POOL
+ * ================
+ * 
+ * poolInit         : counts the online CPUs and uses them all
+ * poolChunks       : splits 'items' into chunks of whole display flag bytes
+ * poolRun          : runs task(arg, chunk) for every chunk on the pool threads
+ * runThreadScaling : times the stages for 1..N threads, checks the output
+ */
+void poolInit(void);
+int poolChunks(long items, int* chunk_items);
+void poolRun(void (*task)(void* arg, int chunk), void* arg, int chunks);
+int runThreadScaling(Model3D* model, ObserverParams* params);
+#endif
+
 // ============================================================================
 //                          FUNCTION IMPLEMENTATIONS
 // ============================================================================
@@ -754,1086 +1647,5311 @@ Fixed32 cos_fixed(Fixed32 angle) {
  * CREATING A NEW 3D MODEL
  * ========================
  * 
- * This function dynamically allocates all structures necessary
- * for a 3D model. Dynamic allocation is crucial on Apple IIGS
- * because the stack is limited and cannot contain large arrays.
- * 
- * ALLOCATION STRATEGY:
- * 1. Main Model3D structure allocation
- * 2. Vertex array allocation (MAX_VERTICES elements)
- * 3. Face array allocation (MAX_FACES elements)
- * 4. On failure: cleanup of previous allocations
+ * Only the Model3D structure itself is allocated here. All arrays live in
+ * the model arena, which is sized by loadModel3D() once the file has been
+ * pre-scanned. Dynamic allocation is crucial on Apple IIGS because the
+ * stack is limited and cannot contain large arrays.
  * 
  * ERROR HANDLING:
- * - Check each allocation
- * - Automatic cascade cleanup on partial failure
  * - Return NULL if unable to allocate
  */
 Model3D* createModel3D(void) {
-    // Step 1: Main structure allocation
     Model3D* model = (Model3D*)malloc(sizeof(Model3D));
     if (model == NULL) {
         return NULL;
     }
-    int n = MAX_VERTICES;
-    model->vertices.vertex_count = n;
-    
-    // Step 2: Allocate vertex arrays using malloc (handles bank crossing better)
-    // Note: malloc() should handle bank boundaries better than NewHandle()
-    model->vertices.x = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.y = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.z = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.xo = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.yo = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.zo = (Fixed32*)malloc(n * sizeof(Fixed32));
-    model->vertices.x2d = (int*)malloc(n * sizeof(int));
-    model->vertices.y2d = (int*)malloc(n * sizeof(int));
-    
-    if (!model->vertices.x || !model->vertices.y || !model->vertices.z ||
-        !model->vertices.xo || !model->vertices.yo || !model->vertices.zo ||
-        !model->vertices.x2d || !model->vertices.y2d) {
-        printf("Error: Unable to allocate memory for vertex arrays\n");
-        keypress();
-        // Allocation failed, cleanup
-        if (model->vertices.x) free(model->vertices.x);
-        if (model->vertices.y) free(model->vertices.y);
-        if (model->vertices.z) free(model->vertices.z);
-        if (model->vertices.xo) free(model->vertices.xo);
-        if (model->vertices.yo) free(model->vertices.yo);
-        if (model->vertices.zo) free(model->vertices.zo);
-        if (model->vertices.x2d) free(model->vertices.x2d);
-        if (model->vertices.y2d) free(model->vertices.y2d);
-        free(model);
-        return NULL;
-    }
-    
-    // Set dummy handles to NULL (not used with malloc)
-    model->vertices.xHandle = NULL;
-    model->vertices.yHandle = NULL;
-    model->vertices.zHandle = NULL;
-    model->vertices.xoHandle = NULL;
-    model->vertices.yoHandle = NULL;
-    model->vertices.zoHandle = NULL;
-    model->vertices.x2dHandle = NULL;
-    model->vertices.y2dHandle = NULL;
-    
-    // Step 3: Face array allocation using parallel arrays (like vertices)
-    // Each element stored separately to fit 32KB limit per allocation
-    int nf = MAX_FACES;
-    
-    // Allocate vertex count array: nf * 4 bytes = 24KB
-    model->faces.vertex_count = (int*)malloc(nf * sizeof(int));
-    if (!model->faces.vertex_count) {
-        printf("Error: Unable to allocate memory for face vertex_count array\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
+    // All pointers and dummy handles NULL, all counters 0, empty arena
+    memset(model, 0, sizeof(Model3D));
+    model->cull_mode = CULL_NONE;
+    return model;
+}
+
+/**
+ * DESTROYING A 3D MODEL
+ * ======================
+ * 
+ * Every vertex and face array is a slice of the arena block, so freeing
+ * the model is one free() for the block and one for the structure.
+ * 
+ * SAFETY:
+ * - NULL check to avoid segmentation errors
+ */
+void destroyModel3D(Model3D* model) {
+    if (model != NULL) {
+        releaseLodLevels(model);
+        releaseFaceClusters(&model->faces);
+        releaseOctree(&model->faces);
+        arenaRelease(&model->arena);
+        releaseEdgeList(&model->edges);
+        releaseCoarseLevel(model);
         free(model);
-        return NULL;
     }
-    
-    // Allocate SINGLE packed buffer for all vertex indices
-    // Estimate: average 3.5 indices per face (mix of triangles and quads)
-    // For 6000 faces: ~21KB. We allocate conservatively at 5 per face = 120KB max
-    int estimated_total_indices = nf * 5;
-    model->faces.vertex_indices_buffer = (int*)malloc(estimated_total_indices * sizeof(int));
-    if (!model->faces.vertex_indices_buffer) {
-        printf("Error: Unable to allocate memory for vertex_indices_buffer\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
-        free(model->faces.vertex_count);
-        free(model);
-        return NULL;
+}
+
+/**
+ * MODEL ARENA
+ * ===========
+ * 
+ * Bump allocator over a single block. arenaReserve() keeps the existing
+ * block when it is large enough (typical for 'N' reloads of models of
+ * similar size) and only reallocates when a bigger model arrives.
+ * With GS3D_LARGE_MODELS the block at least doubles on each reallocation,
+ * so a session loading ever larger meshes reallocates O(log n) times;
+ * the 65816 profile keeps exact sizes (memory is the scarce resource).
+ * Slices are 4-byte aligned so Fixed32 arrays stay aligned on any host.
+ */
+int arenaReserve(ModelArena* arena, long bytes) {
+    if (arena->base == NULL || arena->capacity < bytes) {
+#if GS3D_LARGE_MODELS
+        if (bytes < arena->capacity * 2) bytes = arena->capacity * 2;
+#endif
+        arenaRelease(arena);
+        arena->base = (char*)malloc(bytes);
+        if (arena->base == NULL) {
+            printf("Error: Unable to allocate %ld bytes for model arena\n", bytes);
+            keypress();
+            return -1;
+        }
+        arena->capacity = bytes;
     }
-    
-    // Allocate offset array: one offset per face into the packed buffer
-    model->faces.vertex_indices_ptr = (int*)malloc(nf * sizeof(int));
-    if (!model->faces.vertex_indices_ptr) {
-        printf("Error: Unable to allocate memory for vertex_indices_ptr array\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
-        free(model->faces.vertex_count);
-        free(model->faces.vertex_indices_buffer);
-        free(model);
-        return NULL;
+    arena->used = 0;
+    return 0;
+}
+
+void* arenaCarve(ModelArena* arena, long bytes) {
+    char* slice;
+    bytes = (bytes + 3) & ~3L;
+    if (arena->used + bytes > arena->capacity) {
+        return NULL;  // Caller sized the arena wrongly
     }
+    slice = arena->base + arena->used;
+    arena->used += bytes;
+    return slice;
+}
+
+void arenaRelease(ModelArena* arena) {
+    if (arena->base) free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+// Aligned size of one arena slice
+#define ARENA_SLICE(bytes)  ((((long)(bytes)) + 3) & ~3L)
+
+/**
+ * CARVING THE MODEL ARRAYS
+ * ========================
+ * 
+ * Computes the exact arena size for the pre-scanned counts, reserves it,
+ * then points every SoA array into the block:
+ *   vertices : x, y, z, xo, yo, zo (Fixed32), x2d, y2d (int)
+ *   faces    : vertex_count (Byte), vertex_indices_buffer (VertexIndex),
+ *              vertex_indices_ptr (IndexOffset), z_max (Fixed32),
+ *              display_flag (bitset), sorted_face_indices, sort_scratch (int),
+ *              color (Byte), normal_x, normal_y, normal_z (signed char)
+ */
+int carveModelArrays(Model3D* model, int vertex_count, int face_count, long index_count) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    long nv = (vertex_count > 0) ? vertex_count : 1;
+    long nf = (face_count > 0) ? face_count : 1;
+    long ni = (index_count > 0) ? index_count : 1;
+    long bytes;
     
-    // Allocate z_max array: nf * 4 bytes = 24KB
-    model->faces.z_max = (Fixed32*)malloc(nf * sizeof(Fixed32));
-    if (!model->faces.z_max) {
-        printf("Error: Unable to allocate memory for face z_max array\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
-        free(model->faces.vertex_count);
-        free(model->faces.vertex_indices_buffer);
-        free(model->faces.vertex_indices_ptr);
-        free(model);
-        return NULL;
+    bytes = 6 * ARENA_SLICE(nv * sizeof(Fixed32)) + 2 * ARENA_SLICE(nv * sizeof(int))
+          + ARENA_SLICE(nf * sizeof(Byte)) + ARENA_SLICE(ni * sizeof(VertexIndex))
+          + ARENA_SLICE(nf * sizeof(IndexOffset)) + ARENA_SLICE(nf * sizeof(Fixed32))
+          + ARENA_SLICE(FACE_FLAG_BYTES(nf)) + 2 * ARENA_SLICE(nf * sizeof(int))
+          + 4 * ARENA_SLICE(nf);
+    
+    if (arenaReserve(&model->arena, bytes) < 0) {
+        return -1;
     }
     
-    // Allocate display_flag array: nf * 4 bytes = 24KB
-    model->faces.display_flag = (int*)malloc(nf * sizeof(int));
-    if (!model->faces.display_flag) {
-        printf("Error: Unable to allocate memory for face display_flag array\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
-        free(model->faces.vertex_count);
-        free(model->faces.vertex_indices_buffer);
-        free(model->faces.vertex_indices_ptr);
-        free(model->faces.z_max);
-        free(model);
-        return NULL;
+    vtx->x = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->y = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->z = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->xo = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->yo = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->zo = (Fixed32*)arenaCarve(&model->arena, nv * sizeof(Fixed32));
+    vtx->x2d = (int*)arenaCarve(&model->arena, nv * sizeof(int));
+    vtx->y2d = (int*)arenaCarve(&model->arena, nv * sizeof(int));
+    vtx->vertex_count = 0;
+    
+    faces->vertex_count = (Byte*)arenaCarve(&model->arena, nf * sizeof(Byte));
+    faces->vertex_indices_buffer = (VertexIndex*)arenaCarve(&model->arena, ni * sizeof(VertexIndex));
+    faces->vertex_indices_ptr = (IndexOffset*)arenaCarve(&model->arena, nf * sizeof(IndexOffset));
+    faces->z_max = (Fixed32*)arenaCarve(&model->arena, nf * sizeof(Fixed32));
+    faces->display_flag = (Byte*)arenaCarve(&model->arena, FACE_FLAG_BYTES(nf));
+    faces->sorted_face_indices = (int*)arenaCarve(&model->arena, nf * sizeof(int));
+    faces->sort_scratch = (int*)arenaCarve(&model->arena, nf * sizeof(int));
+    faces->color = (Byte*)arenaCarve(&model->arena, nf);
+    faces->normal_x = (signed char*)arenaCarve(&model->arena, nf);
+    faces->normal_y = (signed char*)arenaCarve(&model->arena, nf);
+    faces->normal_z = (signed char*)arenaCarve(&model->arena, nf);
+    faces->face_count = 0;
+    faces->face_capacity = face_count;
+    faces->index_capacity = index_count;
+    faces->total_indices = 0;
+    faces->degenerate_removed = 0;
+    faces->material_count = 0;
+    
+    memset(faces->display_flag, 0xFF, FACE_FLAG_BYTES(nf));  // Displayable by default
+    return 0;
+}
+
+/**
+ * UNIQUE EDGE LIST
+ * ================
+ * 
+ * Each face edge (a, b) is keyed as (min, max) and looked up in a chained
+ * hash; the first face becomes face0, the second face1. Edges are
+ * collected in temporary arrays sized for the worst case (every index an
+ * edge of its own), then copied into one exact block, so a closed mesh
+ * keeps about half of that.
+ */
+void releaseEdgeList(EdgeArrays3D* edges) {
+    if (edges->block != NULL) {
+        free(edges->block);
     }
+    memset(edges, 0, sizeof(EdgeArrays3D));
+}
+
+int buildEdgeList(Model3D* model) {
+    FaceArrays3D* faces = &model->faces;
+    EdgeArrays3D* edges = &model->edges;
+    long ni = faces->total_indices;
+    unsigned int buckets = 16;
+    VertexIndex *t_v0, *t_v1;
+    int *t_f0, *t_f1, *t_next, *t_slot, *head;
+    void *tmp;
+    int count = 0;
+    int i, j;
+    long bytes;
+    long crease_dot = (long)(cos(CREASE_ANGLE * PI / 180.0) * SHADE_NORMAL_ONE * SHADE_NORMAL_ONE);
     
-    // Initialize structure
-    model->faces.vertex_countHandle = NULL;
-    model->faces.vertex_indicesBufferHandle = NULL;
-    model->faces.vertex_indicesPtrHandle = NULL;
-    model->faces.z_maxHandle = NULL;
-    model->faces.display_flagHandle = NULL;
-    model->faces.sorted_face_indicesHandle = NULL;
-    model->faces.total_indices = 0;
+    releaseEdgeList(edges);
+    if (ni <= 0) return 0;
+    while (buckets < (unsigned int)ni && buckets < EDGE_HASH_MAX) buckets <<= 1;
     
-    // Allocate sorted_face_indices array: nf * 4 bytes = 24KB max
-    model->faces.sorted_face_indices = (int*)malloc(nf * sizeof(int));
-    if (!model->faces.sorted_face_indices) {
-        printf("Error: Unable to allocate memory for sorted_face_indices array\n");
-        keypress();
-        free(model->vertices.x);
-        free(model->vertices.y);
-        free(model->vertices.z);
-        free(model->vertices.xo);
-        free(model->vertices.yo);
-        free(model->vertices.zo);
-        free(model->vertices.x2d);
-        free(model->vertices.y2d);
-        free(model->faces.vertex_count);
-        free(model->faces.vertex_indices_buffer);
-        free(model->faces.vertex_indices_ptr);
-        free(model->faces.z_max);
-        free(model->faces.display_flag);
-        free(model);
-        return NULL;
+    tmp = malloc((size_t)(ni * (2 * sizeof(VertexIndex) + 4 * sizeof(int)) + buckets * sizeof(int)));
+    if (tmp == NULL) return -1;
+    t_v0 = (VertexIndex*)tmp;
+    t_v1 = t_v0 + ni;
+    t_f0 = (int*)(t_v1 + ni);
+    t_f1 = t_f0 + ni;
+    t_next = t_f1 + ni;
+    t_slot = t_next + ni;
+    head = t_slot + ni;
+    for (i = 0; i < (int)buckets; i++) head[i] = -1;
+    
+    for (i = 0; i < faces->face_count; i++) {
+        IndexOffset offset = faces->vertex_indices_ptr[i];
+        VertexIndex *idx = &faces->vertex_indices_buffer[offset];
+        int n = faces->vertex_count[i];
+        for (j = 0; j < n; j++) {
+            VertexIndex a = idx[j];
+            VertexIndex b = idx[(j + 1 == n) ? 0 : j + 1];
+            unsigned int h;
+            int e;
+            if (a > b) { VertexIndex t = a; a = b; b = t; }
+            h = ((unsigned int)a * 31u + (unsigned int)b) & (buckets - 1);
+            for (e = head[h]; e >= 0; e = t_next[e]) {
+                if (t_v0[e] == a && t_v1[e] == b) break;
+            }
+            if (e < 0) {
+                t_v0[count] = a;
+                t_v1[count] = b;
+                t_f0[count] = i;
+                t_f1[count] = -1;
+                t_next[count] = head[h];
+                head[h] = e = count++;
+            } else if (t_f1[e] < 0 && t_f0[e] != i) {
+                t_f1[e] = i;
+            }
+            t_slot[offset + j] = e;
+        }
     }
     
-    return model;
+    bytes = (long)count * (2 * sizeof(VertexIndex) + 2 * sizeof(int) + sizeof(Word) + 1)
+          + ni * sizeof(int) + (long)faces->face_count * sizeof(Word) + FACE_FLAG_BYTES(faces->face_count);
+    edges->block = malloc((size_t)bytes);
+    if (edges->block == NULL) {
+        free(tmp);
+        return -1;
+    }
+    edges->v0 = (VertexIndex*)edges->block;
+    edges->v1 = edges->v0 + count;
+    edges->face0 = (int*)(edges->v1 + count);
+    edges->face1 = edges->face0 + count;
+    edges->face_edge = edges->face1 + count;
+    edges->stamp = (Word*)(edges->face_edge + ni);
+    edges->face_stamp = edges->stamp + count;
+    edges->flags = (Byte*)(edges->face_stamp + faces->face_count);
+    edges->front = edges->flags + count;
+    memcpy(edges->v0, t_v0, (size_t)count * sizeof(VertexIndex));
+    memcpy(edges->v1, t_v1, (size_t)count * sizeof(VertexIndex));
+    memcpy(edges->face0, t_f0, (size_t)count * sizeof(int));
+    memcpy(edges->face1, t_f1, (size_t)count * sizeof(int));
+    memcpy(edges->face_edge, t_slot, (size_t)ni * sizeof(int));
+    memset(edges->stamp, 0, (size_t)count * sizeof(Word));
+    memset(edges->face_stamp, 0, (size_t)faces->face_count * sizeof(Word));
+    memset(edges->front, 0xFF, FACE_FLAG_BYTES(faces->face_count));
+    
+    // Creases from the load-time normals (same orientation convention as the winding)
+    for (i = 0; i < count; i++) {
+        int f0 = t_f0[i], f1 = t_f1[i];
+        if (f1 < 0) {
+            edges->flags[i] = EDGE_BOUNDARY;
+        } else {
+            long dot = (long)faces->normal_x[f0] * faces->normal_x[f1]
+                     + (long)faces->normal_y[f0] * faces->normal_y[f1]
+                     + (long)faces->normal_z[f0] * faces->normal_z[f1];
+            edges->flags[i] = (dot < crease_dot) ? EDGE_CREASE : 0;
+        }
+    }
+    edges->edge_count = count;
+    free(tmp);
+    return count;
 }
 
+#ifdef __ORCAC__
+segment "GS3DLOD";     // Load segment: levels of detail, clusters, octree
+#endif
+
 /**
- * DESTROYING A 3D MODEL
- * ======================
- * 
- * This function properly frees all memory allocated for a
- * 3D model. It follows the LIFO principle (Last In, First Out) for
- * cleanup: last allocated = first freed.
- * 
- * CLEANUP ORDER:
- * 1. Face array (if allocated)
- * 2. Vertex array (if allocated)  
- * 3. Main structure
+ * DERIVED FACE LEVELS
+ * ===================
  * 
- * SAFETY:
- * - NULL check to avoid segmentation errors
- * - Selective cleanup based on successful allocations
+ * The coarse level and the LOD levels are FaceArrays3D over the same
+ * vertex SoA: a vertex map (1-based, each vertex to its representative)
+ * rewrites every face, repeated consecutive vertices (last == first too)
+ * are dropped as in readFaces_model, and faces left with fewer than 3
+ * vertices disappear. faceLevelCount sizes the
+ * result so each level gets one exact malloc, laid out like
+ * carveModelArrays. Face colors follow their source face; normals are
+ * recomputed on the level itself.
  */
-void destroyModel3D(Model3D* model) {
-    if (model != NULL) {
-        // Free all vertex arrays
-        if (model->vertices.x) free(model->vertices.x);
-        if (model->vertices.y) free(model->vertices.y);
-        if (model->vertices.z) free(model->vertices.z);
-        if (model->vertices.xo) free(model->vertices.xo);
-        if (model->vertices.yo) free(model->vertices.yo);
-        if (model->vertices.zo) free(model->vertices.zo);
-        if (model->vertices.x2d) free(model->vertices.x2d);
-        if (model->vertices.y2d) free(model->vertices.y2d);
-        
-        // Free all face arrays (now simplified with packed buffer)
-        if (model->faces.vertex_count) free(model->faces.vertex_count);
-        if (model->faces.vertex_indices_buffer) free(model->faces.vertex_indices_buffer);
-        if (model->faces.vertex_indices_ptr) free(model->faces.vertex_indices_ptr);
-        if (model->faces.z_max) free(model->faces.z_max);
-        if (model->faces.display_flag) free(model->faces.display_flag);
-        if (model->faces.sorted_face_indices) free(model->faces.sorted_face_indices);
-        
-        // Free main structure
-        free(model);
+static void swapFaceArrays(FaceArrays3D* a, FaceArrays3D* b) {
+    FaceArrays3D t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static int faceTriangles(FaceArrays3D* faces) {
+    int i, count = 0;
+    for (i = 0; i < faces->face_count; i++) {
+        count += faces->vertex_count[i] - 2;
+    }
+    return count;
+}
+
+static int faceLevelRemap(FaceArrays3D* src, int i, VertexIndex* map, VertexIndex* out) {
+    VertexIndex *idx = &src->vertex_indices_buffer[src->vertex_indices_ptr[i]];
+    int j, n = 0;
+    for (j = 0; j < src->vertex_count[i]; j++) {
+        VertexIndex v = map[idx[j] - 1];
+        if (n == 0 || out[n - 1] != v) out[n++] = v;
     }
+    while (n > 1 && out[n - 1] == out[0]) n--;
+    return n;
+}
+
+static int faceLevelCount(FaceArrays3D* src, VertexIndex* map, long* indices) {
+    VertexIndex tmp[MAX_FACE_VERTICES];
+    int i, n, count = 0;
+    *indices = 0;
+    for (i = 0; i < src->face_count; i++) {
+        n = faceLevelRemap(src, i, map, tmp);
+        if (n < 3) continue;
+        *indices += n;
+        count++;
+    }
+    return count;
+}
+
+static void* faceLevelBuild(Model3D* model, FaceArrays3D* level, VertexIndex* map) {
+    FaceArrays3D* src = &model->faces;
+    VertexIndex tmp[MAX_FACE_VERTICES];
+    Byte *block, *base;
+    long nf, ni, bytes, pos = 0;
+    int i, n, count = 0;
+    
+    nf = faceLevelCount(src, map, &ni);
+    if (nf == 0) return NULL;
+    bytes = ARENA_SLICE(nf * sizeof(Byte)) + ARENA_SLICE(ni * sizeof(VertexIndex))
+          + ARENA_SLICE(nf * sizeof(IndexOffset)) + ARENA_SLICE(nf * sizeof(Fixed32))
+          + ARENA_SLICE(FACE_FLAG_BYTES(nf)) + 2 * ARENA_SLICE(nf * sizeof(int))
+          + 4 * ARENA_SLICE(nf);
+    base = block = (Byte*)malloc((size_t)bytes);
+    if (block == NULL) return NULL;
+    memset(level, 0, sizeof(FaceArrays3D));
+    level->vertex_count = block;                           block += ARENA_SLICE(nf * sizeof(Byte));
+    level->vertex_indices_buffer = (VertexIndex*)block;    block += ARENA_SLICE(ni * sizeof(VertexIndex));
+    level->vertex_indices_ptr = (IndexOffset*)block;       block += ARENA_SLICE(nf * sizeof(IndexOffset));
+    level->z_max = (Fixed32*)block;                        block += ARENA_SLICE(nf * sizeof(Fixed32));
+    level->display_flag = block;                           block += ARENA_SLICE(FACE_FLAG_BYTES(nf));
+    level->sorted_face_indices = (int*)block;              block += ARENA_SLICE(nf * sizeof(int));
+    level->sort_scratch = (int*)block;                     block += ARENA_SLICE(nf * sizeof(int));
+    level->color = block;                                  block += ARENA_SLICE(nf);
+    level->normal_x = (signed char*)block;                 block += ARENA_SLICE(nf);
+    level->normal_y = (signed char*)block;                 block += ARENA_SLICE(nf);
+    level->normal_z = (signed char*)block;
+    
+    for (i = 0; i < src->face_count; i++) {
+        n = faceLevelRemap(src, i, map, tmp);
+        if (n < 3) continue;
+        memcpy(&level->vertex_indices_buffer[pos], tmp, n * sizeof(VertexIndex));
+        level->vertex_count[count] = (Byte)n;
+        level->vertex_indices_ptr[count] = (IndexOffset)pos;
+        level->color[count] = src->color[i];
+        level->sorted_face_indices[count] = count;
+        pos += n;
+        count++;
+    }
+    level->face_count = count;
+    level->face_capacity = count;
+    level->index_capacity = pos;
+    level->total_indices = pos;
+    level->draw_count = count;
+    level->material_count = src->material_count;
+    level->triangle_count = faceTriangles(level);
+    memset(level->display_flag, 0xFF, FACE_FLAG_BYTES(nf));
+    
+    swapFaceArrays(&model->faces, level);
+    computeFaceNormals(model);
+    swapFaceArrays(&model->faces, level);
+    return base;
 }
 
 /**
- * COMPLETE 3D MODEL LOADING
- * ==========================
- * 
- * This function coordinates the complete loading of an OBJ file
- * by successively calling the vertex and face reading functions.
- * 
- * LOADING PIPELINE:
- * 1. Input parameter validation
- * 2. Read vertices from file
- * 3. Read faces from file  
- * 4. Update counters in structure
+ * COARSE LEVEL (VERTEX CLUSTERING)
+ * ================================
  * 
- * ERROR HANDLING:
- * - Vertex reading failure: immediate stop
- * - Face reading failure: warning but continue
- *   (vertices-only model remains usable)
+ * The bounding box is cut into PROGRESSIVE_GRID^3 cells; the first vertex
+ * met in a cell represents every vertex of that cell. No new vertex is
+ * created, so the same transform serves both levels.
  */
-int loadModel3D(Model3D* model, const char* filename) {
-    // Input parameter validation
-    if (model == NULL || filename == NULL) {
-        return -1;  // Invalid parameters
+void releaseCoarseLevel(Model3D* model) {
+    if (model->coarse_block != NULL) {
+        free(model->coarse_block);
     }
+    model->coarse_block = NULL;
+    memset(&model->coarse, 0, sizeof(FaceArrays3D));
+}
+
+static void swapFaceLevels(Model3D* model) {
+    swapFaceArrays(&model->faces, &model->coarse);
+}
+
+int buildCoarseLevel(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    Fixed32 min_x, min_y, min_z, max_x, max_y, max_z;
+    Fixed32 span_x, span_y, span_z;
+    VertexIndex *rep, *map;
+    long ni;
+    int i, count;
     
-    // Step 1: Read vertices from OBJ file
-    // --- MAJ du compteur global pour la vérification des indices de faces ---
-    readVertices_last_count = model->vertices.vertex_count;
+    releaseCoarseLevel(model);
+    if (faces->face_count < PROGRESSIVE_MIN_FACES || vtx->vertex_count <= 0) return 0;
     
-    int vcount = readVertices(filename, &model->vertices, MAX_VERTICES);
-    if (vcount < 0) {
-        return -1;  // Critical failure: unable to read vertices
+    // Cell of every vertex -> representative vertex (1-based, 0 = empty cell)
+    rep = (VertexIndex*)calloc((size_t)PROGRESSIVE_GRID * PROGRESSIVE_GRID * PROGRESSIVE_GRID, sizeof(VertexIndex));
+    map = (VertexIndex*)malloc((size_t)vtx->vertex_count * sizeof(VertexIndex));
+    if (rep == NULL || map == NULL) {
+        if (rep != NULL) free(rep);
+        if (map != NULL) free(map);
+        return -1;
     }
-    model->vertices.vertex_count = vcount;
-    
-    // Step 2: Read faces from OBJ file (using chunked allocation)
-    // This function handles reading faces into 2 chunks transparently
-    int fcount = readFaces_model(filename, model);
-    if (fcount < 0) {
-        // Critical failure: unable to read faces
-        printf("\nWarning: Unable to read faces\n");
-        model->faces.face_count = 0;  // No faces available
-    } else {
-        model->faces.face_count = fcount;
+    min_x = max_x = vtx->x[0];
+    min_y = max_y = vtx->y[0];
+    min_z = max_z = vtx->z[0];
+    for (i = 1; i < vtx->vertex_count; i++) {
+        if (vtx->x[i] < min_x) min_x = vtx->x[i];
+        if (vtx->x[i] > max_x) max_x = vtx->x[i];
+        if (vtx->y[i] < min_y) min_y = vtx->y[i];
+        if (vtx->y[i] > max_y) max_y = vtx->y[i];
+        if (vtx->z[i] < min_z) min_z = vtx->z[i];
+        if (vtx->z[i] > max_z) max_z = vtx->z[i];
+    }
+    span_x = (max_x - min_x) / PROGRESSIVE_GRID + 1;
+    span_y = (max_y - min_y) / PROGRESSIVE_GRID + 1;
+    span_z = (max_z - min_z) / PROGRESSIVE_GRID + 1;
+    for (i = 0; i < vtx->vertex_count; i++) {
+        int cx = (int)((vtx->x[i] - min_x) / span_x);
+        int cy = (int)((vtx->y[i] - min_y) / span_y);
+        int cz = (int)((vtx->z[i] - min_z) / span_z);
+        int cell = (cz * PROGRESSIVE_GRID + cy) * PROGRESSIVE_GRID + cx;
+        if (rep[cell] == 0) rep[cell] = (VertexIndex)(i + 1);
+        map[i] = rep[cell];
     }
+    free(rep);
     
-    return 0;  // Success: model loaded (with or without faces)
+    count = faceLevelCount(faces, map, &ni);
+    if (count == 0 || count > faces->face_count - faces->face_count / 4) {
+        free(map);
+        return 0;  // Not worth a pass of its own
+    }
+    model->coarse_block = faceLevelBuild(model, &model->coarse, map);
+    free(map);
+    if (model->coarse_block == NULL) {
+        memset(&model->coarse, 0, sizeof(FaceArrays3D));
+        return -1;
+    }
+    return model->coarse.face_count;
 }
 
-// ============================================================================
-//                    USER INTERFACE FUNCTIONS
-// ============================================================================
-
 /**
- * OBSERVER PARAMETER INPUT
- * ========================
+ * LEVELS OF DETAIL (QUADRIC ERROR EDGE COLLAPSE)
+ * ==============================================
  * 
- * This function presents a text interface to allow the
- * user to specify 3D visualization parameters.
+ * Garland-Heckbert quadrics, restricted to half-edge collapses: a vertex
+ * is merged into one of its neighbours, never moved, so every level still
+ * indexes the original vertex SoA and the transform is shared.
  * 
- * REQUESTED PARAMETERS:
- * - Horizontal angle: rotation around Y-axis (left/right view)
- * - Vertical angle: rotation around X-axis (up/down view)
- * - Distance: observer distance (zoom)
- * - Screen rotation angle: final rotation in 2D plane
+ * Each vertex starts with the sum of the plane quadrics of its faces
+ * (area weighted). A pass lists the edges of the current mesh with the
+ * cheaper direction of their collapse, sorts them by error and applies
+ * them greedily, skipping edges that touch a vertex already moved in this
+ * pass (costs of the pass stay valid). The merged vertex inherits the sum
+ * of both quadrics. Passes repeat until the level reaches face_count >> k
+ * faces; level k+1 continues from level k, so errors accumulate the way
+ * a single collapse sequence would. All of it is float work at load time.
  * 
- * ERROR HANDLING:
- * - Default values if input failure
- * - Automatic string->Fixed32 conversion with atof() then FLOAT_TO_FIXED
+ * Levels share nothing with the edge list or the coarse level: while one
+ * is active (lodActivate swaps it into model->faces) wireframe, feature
+ * outlines and the progressive pass are not used (lodSelectLevel).
  */
-void getObserverParams(ObserverParams* params) {
-    char input[50];  // Buffer for user input
+typedef struct {
+    float cost;
+    VertexIndex from;       // 0-based: vertex removed
+    VertexIndex to;         // 0-based: vertex kept
+} LodCollapse;
+
+static int lodCompareCollapse(const void* a, const void* b) {
+    float ca = ((const LodCollapse*)a)->cost;
+    float cb = ((const LodCollapse*)b)->cost;
+    return (ca < cb) ? -1 : (ca > cb);
+}
+
+static float lodError(const float* q, float x, float y, float z) {
+    // v' Q v for the symmetric 4x4 [q0 q1 q2 q3; . q4 q5 q6; . . q7 q8; . . . q9]
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+         + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+         + q[7] * z * z + 2.0 * q[8] * z + q[9];
+}
+
+static VertexIndex lodFind(VertexIndex* map, int v) {
+    // 1-based representatives; path halving keeps chains short
+    while (map[v] != (VertexIndex)(v + 1)) {
+        map[v] = map[map[v] - 1];
+        v = map[v] - 1;
+    }
+    return (VertexIndex)(v + 1);
+}
+
+void releaseLodLevels(Model3D* model) {
+    int k;
+    if (model->lod_active != 0) lodActivate(model, 0);
+    for (k = 1; k < LOD_LEVELS; k++) {
+        if (model->lod_block[k] != NULL) free(model->lod_block[k]);
+        model->lod_block[k] = NULL;
+        memset(&model->lod[k], 0, sizeof(FaceArrays3D));
+    }
+    model->lod_count = 1;
+}
+
+int buildLodLevels(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int nv = vtx->vertex_count;
+    float *quad = NULL;
+    float min_x, min_y, min_z, max_x, max_y, max_z, r2 = 0.0;
+    VertexIndex *map = NULL, tmp[MAX_FACE_VERTICES];
+    LodCollapse *cand = NULL;
+    Byte *moved = NULL;
+    long ni;
+    int i, j, k, alive, pass;
     
-    // Display section header
-    printf("\nObserver parameters:\n");
-    printf("============================\n");
-    printf("(Press ENTER to use default values)\n");
-    printf("(Enter 'debug' to see values used)\n");
+    releaseLodLevels(model);
+    model->bound_r = 0;
+    if (nv <= 0) return 0;
     
-    // Input horizontal angle (rotation around Y)
-    printf("Horizontal angle (degrees, default 30): ");
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline
-        input[strcspn(input, "\n")] = 0;
-        if (strlen(input) == 0) {
-            params->angle_h = FLOAT_TO_FIXED(30.0);     // Default value if ENTER (Fixed Point)
-        } else {
-            params->angle_h = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
-        }
-    } else {
-        params->angle_h = FLOAT_TO_FIXED(30.0);         // Default value if error (Fixed Point)
+    // Bounding sphere: box centre, farthest vertex
+    min_x = max_x = FIXED_TO_FLOAT(vtx->x[0]);
+    min_y = max_y = FIXED_TO_FLOAT(vtx->y[0]);
+    min_z = max_z = FIXED_TO_FLOAT(vtx->z[0]);
+    for (i = 1; i < nv; i++) {
+        float x = FIXED_TO_FLOAT(vtx->x[i]), y = FIXED_TO_FLOAT(vtx->y[i]), z = FIXED_TO_FLOAT(vtx->z[i]);
+        if (x < min_x) min_x = x;
+        if (x > max_x) max_x = x;
+        if (y < min_y) min_y = y;
+        if (y > max_y) max_y = y;
+        if (z < min_z) min_z = z;
+        if (z > max_z) max_z = z;
     }
+    model->bound_x = FLOAT_TO_FIXED((min_x + max_x) * 0.5);
+    model->bound_y = FLOAT_TO_FIXED((min_y + max_y) * 0.5);
+    model->bound_z = FLOAT_TO_FIXED((min_z + max_z) * 0.5);
+    for (i = 0; i < nv; i++) {
+        float dx = FIXED_TO_FLOAT(vtx->x[i] - model->bound_x);
+        float dy = FIXED_TO_FLOAT(vtx->y[i] - model->bound_y);
+        float dz = FIXED_TO_FLOAT(vtx->z[i] - model->bound_z);
+        float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 > r2) r2 = d2;
+    }
+    model->bound_r = FLOAT_TO_FIXED(sqrt(r2));
+    if (faces->face_count < LOD_MIN_FACES) return 0;
     
-    // Input vertical angle (rotation around X)  
-    printf("Vertical angle (degrees, default 20): ");
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline
-        input[strcspn(input, "\n")] = 0;
-        if (strlen(input) == 0) {
-            params->angle_v = FLOAT_TO_FIXED(20.0);     // Default value if ENTER (Fixed Point)
-        } else {
-            params->angle_v = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
-        }
-    } else {
-        params->angle_v = FLOAT_TO_FIXED(20.0);         // Default value if error (Fixed Point)
+    quad = (float*)calloc((size_t)nv * 10, sizeof(float));
+    map = (VertexIndex*)malloc((size_t)nv * sizeof(VertexIndex));
+    moved = (Byte*)malloc((size_t)nv);
+    cand = (LodCollapse*)malloc((size_t)faces->total_indices * sizeof(LodCollapse));
+    if (quad == NULL || map == NULL || moved == NULL || cand == NULL) {
+        if (quad != NULL) free(quad);
+        if (map != NULL) free(map);
+        if (moved != NULL) free(moved);
+        if (cand != NULL) free(cand);
+        return -1;
     }
+    for (i = 0; i < nv; i++) map[i] = (VertexIndex)(i + 1);
     
-
-    // Input screen rotation angle (final 2D rotation)
-    printf("Screen rotation angle (degrees, default 0): ");
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline
-        input[strcspn(input, "\n")] = 0;
-        if (strlen(input) == 0) {
-            params->angle_w = FLOAT_TO_FIXED(0.0);      // Default value if ENTER (Fixed Point)
-        } else {
-            params->angle_w = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
+    // Plane quadric of every face, added to each of its vertices
+    for (i = 0; i < faces->face_count; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        int n = faces->vertex_count[i];
+        int v0 = idx[0] - 1;
+        float nx = 0.0, ny = 0.0, nz = 0.0, len, area, p[4];
+        for (j = 0; j < n; j++) {
+            int a = idx[j] - 1;
+            int b = idx[(j + 1 == n) ? 0 : j + 1] - 1;
+            float xa = FIXED_TO_FLOAT(vtx->x[a]), ya = FIXED_TO_FLOAT(vtx->y[a]), za = FIXED_TO_FLOAT(vtx->z[a]);
+            float xb = FIXED_TO_FLOAT(vtx->x[b]), yb = FIXED_TO_FLOAT(vtx->y[b]), zb = FIXED_TO_FLOAT(vtx->z[b]);
+            nx += (ya - yb) * (za + zb);
+            ny += (za - zb) * (xa + xb);
+            nz += (xa - xb) * (ya + yb);
+        }
+        len = sqrt(nx * nx + ny * ny + nz * nz);
+        if (len <= 0.0) continue;
+        area = len * 0.5;
+        p[0] = nx / len; p[1] = ny / len; p[2] = nz / len;
+        p[3] = -(p[0] * FIXED_TO_FLOAT(vtx->x[v0]) + p[1] * FIXED_TO_FLOAT(vtx->y[v0])
+               + p[2] * FIXED_TO_FLOAT(vtx->z[v0]));
+        for (j = 0; j < n; j++) {
+            float *q = &quad[(long)(idx[j] - 1) * 10];
+            q[0] += area * p[0] * p[0]; q[1] += area * p[0] * p[1]; q[2] += area * p[0] * p[2];
+            q[3] += area * p[0] * p[3]; q[4] += area * p[1] * p[1]; q[5] += area * p[1] * p[2];
+            q[6] += area * p[1] * p[3]; q[7] += area * p[2] * p[2]; q[8] += area * p[2] * p[3];
+            q[9] += area * p[3] * p[3];
         }
-    } else {
-        params->angle_w = FLOAT_TO_FIXED(0.0);          // No rotation by default (Fixed Point)
     }
-
-    // Input observation distance (zoom/perspective)
-    printf("Distance (default 30): ");
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline
-        input[strcspn(input, "\n")] = 0;
-        if (strlen(input) == 0) {
-            params->distance = FLOAT_TO_FIXED(30.0);    // Default value if ENTER (Fixed Point)
-        } else {
-            params->distance = FLOAT_TO_FIXED(atof(input)); // String->Fixed32 conversion
+    
+    alive = faces->face_count;
+    for (k = 1; k < LOD_LEVELS; k++) {
+        int target = faces->face_count >> k;
+        for (pass = 0; pass < LOD_MAX_PASSES && alive > target; pass++) {
+            int count = 0, done = 0, budget;
+            // Edges of the current mesh, cheaper direction of each
+            for (i = 0; i < faces->face_count; i++) {
+                VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+                int n = 0;
+                for (j = 0; j < faces->vertex_count[i]; j++) {
+                    VertexIndex v = lodFind(map, idx[j] - 1);
+                    if (n == 0 || tmp[n - 1] != v) tmp[n++] = v;
+                }
+                while (n > 1 && tmp[n - 1] == tmp[0]) n--;
+                if (n < 3) continue;
+                for (j = 0; j < n; j++) {
+                    int a = tmp[j] - 1, b = tmp[(j + 1 == n) ? 0 : j + 1] - 1;
+                    float q[10], ca, cb;
+                    int m;
+                    if (a > b) continue;  // Interior edges are listed from both faces
+                    for (m = 0; m < 10; m++) q[m] = quad[(long)a * 10 + m] + quad[(long)b * 10 + m];
+                    ca = lodError(q, FIXED_TO_FLOAT(vtx->x[a]), FIXED_TO_FLOAT(vtx->y[a]), FIXED_TO_FLOAT(vtx->z[a]));
+                    cb = lodError(q, FIXED_TO_FLOAT(vtx->x[b]), FIXED_TO_FLOAT(vtx->y[b]), FIXED_TO_FLOAT(vtx->z[b]));
+                    cand[count].cost = (ca < cb) ? ca : cb;
+                    cand[count].from = (VertexIndex)((ca < cb) ? b : a);
+                    cand[count].to = (VertexIndex)((ca < cb) ? a : b);
+                    count++;
+                }
+            }
+            qsort(cand, (size_t)count, sizeof(LodCollapse), lodCompareCollapse);
+            
+            // A collapse removes about two faces
+            budget = (alive - target + 1) / 2;
+            memset(moved, 0, (size_t)nv);
+            for (i = 0; i < count && done < budget; i++) {
+                int from = cand[i].from, to = cand[i].to, m;
+                if (moved[from] || moved[to]) continue;
+                map[from] = (VertexIndex)(to + 1);
+                for (m = 0; m < 10; m++) quad[(long)to * 10 + m] += quad[(long)from * 10 + m];
+                moved[from] = moved[to] = 1;
+                done++;
+            }
+            if (done == 0) break;
+            for (i = 0; i < nv; i++) lodFind(map, i);  // Flatten for faceLevelCount
+            alive = faceLevelCount(faces, map, &ni);
         }
-    } else {
-        params->distance = FLOAT_TO_FIXED(30.0);        // Default distance: balanced view (Fixed Point)
+        if (alive >= model->lod[k - 1].face_count && k > 1) break;  // No further reduction
+        if (alive >= faces->face_count || alive == 0) break;
+        model->lod_block[k] = faceLevelBuild(model, &model->lod[k], map);
+        if (model->lod_block[k] == NULL) break;
+        model->lod_count = k + 1;
     }
+    
+    free(quad);
+    free(map);
+    free(moved);
+    free(cand);
+    return model->lod_count - 1;
 }
 
 /**
- * MODEL INFORMATION DISPLAY
- * =========================
+ * CONVEXITY TEST
+ * ==============
  * 
- * Displays a statistical summary of the loaded 3D model:
- * number of vertices and number of faces.
+ * On a closed convex mesh with a consistent winding, the faces turned
+ * toward the observer never overlap on screen: winding culling alone
+ * leaves a correct image in any draw order. Each face plane (Newell
+ * normal) is tested against every vertex; the first vertex found on the
+ * far side by more than CONVEX_EPSILON x bounding radius ends the test.
+ * The side holding the mesh must also be the same for all faces,
+ * otherwise culling would keep a mix of front and back faces.
  * 
- * This function serves as quick validation that loading
- * completed correctly.
+ * The cost is faces x vertices plane tests, bounded by CONVEX_MAX_TESTS:
+ * concave meshes usually exit within the first faces, but a large convex
+ * one would run through all of them. The tests are integer: vertices
+ * about the bounding centre on a CONVEX_GRID grid (differences fit 16
+ * bits), normals scaled to CONVEX_NORMAL_ONE, so a test is three 16 x 16
+ * bit products summed in a long (below 2^30). Both grids are finer than
+ * the tolerance. Float is left to one normal per face.
  */
-void displayModelInfo(Model3D* model) {
-    // printf("\nAnalysis summary:\n");
-    // printf("====================\n");
-    // printf("Number of vertices (3D points) found: %d\n", model->vertices.vertex_count);
-    // printf("Number of faces found: %d\n", model->faces.face_count);
+int detectConvex(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int nv = vtx->vertex_count;
+    int *gx, *gy, *gz;
+    float scale;
+    long eps;
+    int i, j, side = 0;
+    
+    model->convex_tests = 0;
+    faces->convex = CONVEX_UNCHECKED;
+    if (faces->face_count == 0 || model->bound_r <= 0 ||
+        (long)faces->face_count * nv > CONVEX_MAX_TESTS) return faces->convex;
+    gx = (int*)malloc((size_t)nv * 3 * sizeof(int));
+    if (gx == NULL) return faces->convex;
+    gy = gx + nv;
+    gz = gy + nv;
+    scale = CONVEX_GRID / FIXED_TO_FLOAT(model->bound_r);
+    for (i = 0; i < nv; i++) {
+        gx[i] = (int)floor(FIXED_TO_FLOAT(vtx->x[i] - model->bound_x) * scale + 0.5);
+        gy[i] = (int)floor(FIXED_TO_FLOAT(vtx->y[i] - model->bound_y) * scale + 0.5);
+        gz[i] = (int)floor(FIXED_TO_FLOAT(vtx->z[i] - model->bound_z) * scale + 0.5);
+    }
+    eps = (long)(CONVEX_EPSILON * CONVEX_GRID * CONVEX_NORMAL_ONE);
+    
+    faces->convex = CONVEX_YES;
+    for (i = 0; i < faces->face_count && faces->convex == CONVEX_YES; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        int n = faces->vertex_count[i];
+        int v0 = idx[0] - 1;
+        float nx = 0.0, ny = 0.0, nz = 0.0, len;
+        int inx, iny, inz;
+        for (j = 0; j < n; j++) {
+            int a = idx[j] - 1;
+            int b = idx[(j + 1 == n) ? 0 : j + 1] - 1;
+            nx += (float)(gy[a] - gy[b]) * (float)(gz[a] + gz[b]);
+            ny += (float)(gz[a] - gz[b]) * (float)(gx[a] + gx[b]);
+            nz += (float)(gx[a] - gx[b]) * (float)(gy[a] + gy[b]);
+        }
+        len = sqrt(nx * nx + ny * ny + nz * nz);
+        if (len <= 0.0) continue;  // Zero area: no plane to test
+        inx = (int)floor(nx * CONVEX_NORMAL_ONE / len + 0.5);
+        iny = (int)floor(ny * CONVEX_NORMAL_ONE / len + 0.5);
+        inz = (int)floor(nz * CONVEX_NORMAL_ONE / len + 0.5);
+        for (j = 0; j < nv; j++) {
+            long d = (long)inx * (gx[j] - gx[v0]) + (long)iny * (gy[j] - gy[v0]) + (long)inz * (gz[j] - gz[v0]);
+            model->convex_tests++;
+            if (d <= eps && d >= -eps) continue;
+            if (side == 0) side = (d > 0) ? 1 : -1;
+            if ((d > 0) != (side > 0)) {
+                faces->convex = CONVEX_NO;
+                break;
+            }
+        }
+    }
+    free(gx);
+    return faces->convex;
 }
 
 /**
- * DETAILED RESULTS DISPLAY
- * ========================
+ * FACE CLUSTERS (NORMAL CONES)
+ * ============================
  * 
- * This function displays all vertex coordinates through
- * the different stages of the rendering pipeline:
- * 1. Original coordinates (x, y, z)
- * 2. Transformed coordinates (xo, yo, zo)
- * 3. 2D projected coordinates (x2d, y2d)
+ * Faces are grouped by dominant normal direction (6 axis buckets), then
+ * ordered along a Morton curve of their centroids, and every bucket is cut
+ * into even runs of at most CLUSTER_MAX_FACES faces (32 to 64 once a
+ * bucket holds 32 faces or more). The face arrays
+ * are permuted into that order at load (before the edge list and derived
+ * levels are built), so a cluster is a plain range [first, first + count).
  * 
- * Also displays the list of faces with their vertices.
- * Useful for debugging and calculation verification.
- */
-void displayResults(Model3D* model) {
-    int i, j;
-    VertexArrays3D* vtx = &model->vertices;
-    // printf("\nComplete coordinates (Original -> 3D -> 2D):\n");
-    // printf("-----------------------------------------------\n");
-    // for (i = 0; i < vtx->vertex_count; i++) {
-    //     if (vtx->x2d[i] >= 0 && vtx->y2d[i] >= 0) {
-    //         printf("  Vertex %3d: (%.2f,%.2f,%.2f) -> (%.2f,%.2f,%.2f) -> (%d,%d)\n",
-    //                i + 1,
-    //                FIXED_TO_FLOAT(vtx->x[i]), FIXED_TO_FLOAT(vtx->y[i]), FIXED_TO_FLOAT(vtx->z[i]),
-    //                FIXED_TO_FLOAT(vtx->xo[i]), FIXED_TO_FLOAT(vtx->yo[i]), FIXED_TO_FLOAT(vtx->zo[i]),
-    //                vtx->x2d[i], vtx->y2d[i]);
-    //     } else {
-    //         printf("  Vertex %3d: (%.2f,%.2f,%.2f) -> (%.2f,%.2f,%.2f) -> (invisible)\n",
-    //                i + 1,
-    //                FIXED_TO_FLOAT(vtx->x[i]), FIXED_TO_FLOAT(vtx->y[i]), FIXED_TO_FLOAT(vtx->z[i]),
-    //                FIXED_TO_FLOAT(vtx->xo[i]), FIXED_TO_FLOAT(vtx->yo[i]), FIXED_TO_FLOAT(vtx->zo[i]));
-    //     }
-    // }
-    
-    if (model->faces.face_count > 0) {
-        // printf("\nFace list:\n");
-        // printf("----------------\n");
-        for (i = 0; i < model->faces.face_count; i++) {
-            // printf("  Face %3d (%d vertices, z_max=%.2f): ", i + 1, model->faces.vertex_count[i], FIXED_TO_FLOAT(model->faces.z_max[i]));
-            int offset = model->faces.vertex_indices_ptr[i];
-            // for (j = 0; j < model->faces.vertex_count[i]; j++) {
-            //     printf("%d", model->faces.vertex_indices_buffer[offset + j]);
-            //     if (j < model->faces.vertex_count[i] - 1) printf("-");
-            // }
-            // printf("\n");
-            // printf("       Coordinates of vertices of this face:\n");
-            for (j = 0; j < model->faces.vertex_count[i]; j++) {
-                int vertex_idx = model->faces.vertex_indices_buffer[offset + j] - 1;
-                if (vertex_idx >= 0 && vertex_idx < vtx->vertex_count) {
-                    // printf("         Vertex %d: (%.2f,%.2f,%.2f) -> (%d,%d)\n",
-                    //     model->faces.vertex_indices_buffer[offset + j],
-                    //     FIXED_TO_FLOAT(vtx->x[vertex_idx]), FIXED_TO_FLOAT(vtx->y[vertex_idx]), FIXED_TO_FLOAT(vtx->z[vertex_idx]),
-                    //     vtx->x2d[vertex_idx], vtx->y2d[vertex_idx]);
-                } else {
-                    // printf("         Vertex %d: ERROR - Index out of bounds!\n", model->faces.vertex_indices_buffer[offset + j]);
-                }
-            }
-            // printf("\n");
-        }
-        drawPolygons(model, model->faces.vertex_count, model->faces.face_count, vtx->vertex_count);
+ * Each cluster stores a bounding sphere (box centre, farthest vertex) and
+ * a normal cone: axis = normalized sum of the face normals, half-angle =
+ * widest normal + CLUSTER_CONE_MARGIN. With D the
+ * vector from the observer to the sphere centre, every face of the cluster
+ * is turned away from the observer when
+ * 
+ *   axis.D - radius > spread * |D|,   spread = 2 sin(half-angle / 2)
+ * 
+ * (|n - axis| <= spread bounds every normal n; any point of a face is
+ * within radius of the centre), and turned toward it when -axis.D passes
+ * the same test. calculateFaceDepths rejects or accepts whole clusters on
+ * that basis; cones of 90 degrees or more are never tested.
+ * 
+ * AGREEMENT WITH THE PER-FACE TEST:
+ *   faceWindingCulled takes the orientation of the projected v0-v1-v2
+ *   triangle, so the cone is built from the normals of that same triangle
+ *   (float, at load), not from the Newell normals: on a non-planar quad
+ *   the two differ. The exact screen orientation of a triangle in front of
+ *   the observer is the sign of n.(eye - v0), which the cone bounds, so
+ *   the tests differ only through the rounding of x2d/y2d. That moves
+ *   each vertex by at most half a pixel: a face can only change sides
+ *   when its doubled projected area is below its perimeter in pixels, a
+ *   sliver under a pixel wide (the cluster test then has the exact side).
+ *   A triangle with v0, v1, v2 in line is never culled per face, and its
+ *   cluster is never tested.
+ * 
+ * The loaded order is kept in cluster_source (trace and debugging).
+ * 
+ * The permutation reuses sorted_face_indices, sort_scratch and z_max as
+ * scratch (all rebuilt every frame): no temporary allocation.
+ */
+static const Fixed32 *cluster_sort_keys;
+
+static int clusterCompareFaces(const void* a, const void* b) {
+    Fixed32 ka = cluster_sort_keys[*(const int*)a];
+    Fixed32 kb = cluster_sort_keys[*(const int*)b];
+    return (ka < kb) ? -1 : (ka > kb);
+}
+
+static int faceDirection(FaceArrays3D* faces, int i) {
+    int nx = faces->normal_x[i], ny = faces->normal_y[i], nz = faces->normal_z[i];
+    int ax = nx < 0 ? -nx : nx, ay = ny < 0 ? -ny : ny, az = nz < 0 ? -nz : nz;
+    if (ax >= ay && ax >= az) return nx < 0 ? 1 : 0;
+    if (ay >= az) return ny < 0 ? 3 : 2;
+    return nz < 0 ? 5 : 4;
+}
+
+static long mortonSpread(long v) {
+    // 9 bits -> every third bit of 27
+    long r = 0;
+    int b;
+    for (b = 0; b < 9; b++) {
+        if (v & (1L << b)) r |= 1L << (3 * b);
     }
+    return r;
 }
 
-/**
- * ULTRA-FAST FUNCTION: Combined Transformation + Projection
- * ==========================================================
- */
-void processModelFast(Model3D* model, ObserverParams* params, const char* filename) {
+static void clusterPermute(Byte* a, int* perm, int* tmp, int n) {
     int i;
-    Fixed32 rad_h, rad_v, rad_w;
-    Fixed32 cos_h, sin_h, cos_v, sin_v, cos_w, sin_w;
-    Fixed32 x, y, z, zo, xo, yo;
-    Fixed32 inv_zo, x2d_temp, y2d_temp;
-    
-    // Direct table access - ultra-fast! (no function calls)
-    rad_h = deg_to_rad_table[FIXED_TO_INT(params->angle_h)];
-    rad_v = deg_to_rad_table[FIXED_TO_INT(params->angle_v)];
-    rad_w = deg_to_rad_table[FIXED_TO_INT(params->angle_w)];
-    
-    // Pre-calculate ALL trigonometric values in Fixed32 (ultra-fast)
-    cos_h = cos_fixed(rad_h);
-    sin_h = sin_fixed(rad_h);
-    cos_v = cos_fixed(rad_v);
-    sin_v = sin_fixed(rad_v);
-    cos_w = cos_fixed(rad_w);
-    sin_w = sin_fixed(rad_w);
-    
-    // Pre-calculate all trigonometric products in Fixed32 - using 64-bit multiply
-    const Fixed32 cos_h_cos_v = FIXED_MUL_64(cos_h, cos_v);
-    const Fixed32 sin_h_cos_v = FIXED_MUL_64(sin_h, cos_v);
-    const Fixed32 cos_h_sin_v = FIXED_MUL_64(cos_h, sin_v);
-    const Fixed32 sin_h_sin_v = FIXED_MUL_64(sin_h, sin_v);
-    const Fixed32 scale = FLOAT_TO_FIXED(100.0);
-    const Fixed32 centre_x_f = FLOAT_TO_FIXED((float)CENTRE_X);
-    const Fixed32 centre_y_f = FLOAT_TO_FIXED((float)CENTRE_Y);
-    const Fixed32 distance = params->distance;
-    
-    // Performance measurement
-    long start_transform_ticks = GetTick();
-    
-    // 100% Fixed32 loop - ZERO conversions, maximum speed!
+    for (i = 0; i < n; i++) tmp[i] = a[perm[i]];
+    for (i = 0; i < n; i++) a[i] = (Byte)tmp[i];
+}
+
+// Normal of the v0-v1-v2 triangle of a face (what faceWindingCulled projects)
+static void clusterTriangleNormal(Model3D* model, int face, float* nx, float* ny, float* nz) {
+    VertexArrays3D* vtx = &model->vertices;
+    VertexIndex *idx = &model->faces.vertex_indices_buffer[model->faces.vertex_indices_ptr[face]];
+    int v0 = idx[0] - 1, v1 = idx[1] - 1, v2 = idx[2] - 1;
+    float ax = FIXED_TO_FLOAT(vtx->x[v1] - vtx->x[v0]);
+    float ay = FIXED_TO_FLOAT(vtx->y[v1] - vtx->y[v0]);
+    float az = FIXED_TO_FLOAT(vtx->z[v1] - vtx->z[v0]);
+    float bx = FIXED_TO_FLOAT(vtx->x[v2] - vtx->x[v0]);
+    float by = FIXED_TO_FLOAT(vtx->y[v2] - vtx->y[v0]);
+    float bz = FIXED_TO_FLOAT(vtx->z[v2] - vtx->z[v0]);
+    *nx = ay * bz - az * by;
+    *ny = az * bx - ax * bz;
+    *nz = ax * by - ay * bx;
+}
+
+static void clusterBounds(Model3D* model, FaceCluster* cl) {
     VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    float min_x = 0.0, min_y = 0.0, min_z = 0.0, max_x = 0.0, max_y = 0.0, max_z = 0.0;
+    float cx, cy, cz, r2 = 0.0, sx = 0.0, sy = 0.0, sz = 0.0, len, cos_min = 1.0, angle;
+    int i, j, first = 1;
     
-    for (i = 0; i < vtx->vertex_count; i++) {
-        x = vtx->x[i];
-        y = vtx->y[i];
-        z = vtx->z[i];
-        // 3D transformation in pure Fixed32 (64-bit multiply)
-        Fixed32 term1 = FIXED_MUL_64(x, cos_h_cos_v);
-        Fixed32 term2 = FIXED_MUL_64(y, sin_h_cos_v);
-        Fixed32 term3 = FIXED_MUL_64(z, sin_v);
-        zo = FIXED_ADD(FIXED_SUB(FIXED_SUB(FIXED_NEG(term1), term2), term3), distance);
-        if (zo > 0) {
-            xo = FIXED_ADD(FIXED_NEG(FIXED_MUL_64(x, sin_h)), FIXED_MUL_64(y, cos_h));
-            yo = FIXED_ADD(FIXED_SUB(FIXED_NEG(FIXED_MUL_64(x, cos_h_sin_v)), FIXED_MUL_64(y, sin_h_sin_v)), FIXED_MUL_64(z, cos_v));
-            vtx->zo[i] = zo;
-            vtx->xo[i] = xo;
-            vtx->yo[i] = yo;
-            inv_zo = FIXED_DIV_64(scale, zo);
-            x2d_temp = FIXED_ADD(FIXED_MUL_64(xo, inv_zo), centre_x_f);
-            y2d_temp = FIXED_SUB(centre_y_f, FIXED_MUL_64(yo, inv_zo));
-            vtx->x2d[i] = FIXED_TO_INT(FIXED_ADD(FIXED_SUB(FIXED_MUL_64(cos_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(sin_w, FIXED_SUB(centre_y_f, y2d_temp))), centre_x_f));
-            vtx->y2d[i] = FIXED_TO_INT(FIXED_SUB(centre_y_f, FIXED_ADD(FIXED_MUL_64(sin_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(cos_w, FIXED_SUB(centre_y_f, y2d_temp)))));
-        } else {
-            vtx->zo[i] = zo;
-            vtx->xo[i] = 0;
-            vtx->yo[i] = 0;
-            vtx->x2d[i] = -1;
-            vtx->y2d[i] = -1;
+    for (i = cl->first; i < cl->first + cl->count; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        for (j = 0; j < faces->vertex_count[i]; j++) {
+            float x = FIXED_TO_FLOAT(vtx->x[idx[j] - 1]);
+            float y = FIXED_TO_FLOAT(vtx->y[idx[j] - 1]);
+            float z = FIXED_TO_FLOAT(vtx->z[idx[j] - 1]);
+            if (first || x < min_x) min_x = x;
+            if (first || x > max_x) max_x = x;
+            if (first || y < min_y) min_y = y;
+            if (first || y > max_y) max_y = y;
+            if (first || z < min_z) min_z = z;
+            if (first || z > max_z) max_z = z;
+            first = 0;
+        }
+    }
+    cx = (min_x + max_x) * 0.5;
+    cy = (min_y + max_y) * 0.5;
+    cz = (min_z + max_z) * 0.5;
+    for (i = cl->first; i < cl->first + cl->count; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        for (j = 0; j < faces->vertex_count[i]; j++) {
+            float dx = FIXED_TO_FLOAT(vtx->x[idx[j] - 1]) - cx;
+            float dy = FIXED_TO_FLOAT(vtx->y[idx[j] - 1]) - cy;
+            float dz = FIXED_TO_FLOAT(vtx->z[idx[j] - 1]) - cz;
+            if (dx * dx + dy * dy + dz * dz > r2) r2 = dx * dx + dy * dy + dz * dz;
         }
     }
+    cl->cx = FLOAT_TO_FIXED(cx);
+    cl->cy = FLOAT_TO_FIXED(cy);
+    cl->cz = FLOAT_TO_FIXED(cz);
+    cl->radius = FLOAT_TO_FIXED(sqrt(r2)) + 1;
     
-    long end_transform_ticks = GetTick();
+    cl->spread = -1;
+    for (i = cl->first; i < cl->first + cl->count; i++) {
+        float nx, ny, nz, n;
+        clusterTriangleNormal(model, i, &nx, &ny, &nz);
+        n = sqrt(nx * nx + ny * ny + nz * nz);
+        if (n <= 0.0) return;  // v0, v1, v2 in line: never culled per face
+        sx += nx / n;
+        sy += ny / n;
+        sz += nz / n;
+    }
+    len = sqrt(sx * sx + sy * sy + sz * sz);
+    if (len <= 0.0) return;
+    sx /= len;
+    sy /= len;
+    sz /= len;
+    for (i = cl->first; i < cl->first + cl->count; i++) {
+        float nx, ny, nz, c;
+        clusterTriangleNormal(model, i, &nx, &ny, &nz);
+        c = (nx * sx + ny * sy + nz * sz) / sqrt(nx * nx + ny * ny + nz * nz);
+        if (c < cos_min) cos_min = c;
+    }
+    if (cos_min > 1.0) cos_min = 1.0;
+    angle = acos(cos_min) * 180.0 / 3.14159265 + CLUSTER_CONE_MARGIN;
+    if (angle >= 90.0) return;
+    cl->ax = FLOAT_TO_FIXED(sx);
+    cl->ay = FLOAT_TO_FIXED(sy);
+    cl->az = FLOAT_TO_FIXED(sz);
+    cl->spread = FLOAT_TO_FIXED(2.0 * sin(angle * 3.14159265 / 360.0));
+}
+
+void releaseFaceClusters(FaceArrays3D* faces) {
+    if (faces->clusters != NULL) {
+        free(faces->clusters);
+    }
+    if (faces->cluster_source != NULL) {
+        free(faces->cluster_source);
+    }
+    faces->clusters = NULL;
+    faces->cluster_source = NULL;
+    faces->cluster_count = 0;
+}
+
+int buildFaceClusters(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int nf = faces->face_count;
+    int *perm = faces->sorted_face_indices;
+    int *tmp = faces->sort_scratch;
+    Fixed32 *keys = faces->z_max;
+    Fixed32 min_x, min_y, min_z, max_x, max_y, max_z, span_x, span_y, span_z;
+    int i, j, start, pass, count = 0;
     
-    // Face sorting after transformation
-    long start_calc_ticks = GetTick();
-    calculateFaceDepths(model, NULL, model->faces.face_count);
-    long end_calc_ticks = GetTick();
+    releaseFaceClusters(faces);
+    if (nf < 2 * CLUSTER_MAX_FACES || vtx->vertex_count <= 0) return 0;
     
-    // CRITICAL: Reset sorted_face_indices before each sort to prevent corruption
-    for (i = 0; i < model->faces.face_count; i++) {
-        model->faces.sorted_face_indices[i] = i;
+    min_x = max_x = vtx->x[0];
+    min_y = max_y = vtx->y[0];
+    min_z = max_z = vtx->z[0];
+    for (i = 1; i < vtx->vertex_count; i++) {
+        if (vtx->x[i] < min_x) min_x = vtx->x[i];
+        if (vtx->x[i] > max_x) max_x = vtx->x[i];
+        if (vtx->y[i] < min_y) min_y = vtx->y[i];
+        if (vtx->y[i] > max_y) max_y = vtx->y[i];
+        if (vtx->z[i] < min_z) min_z = vtx->z[i];
+        if (vtx->z[i] > max_z) max_z = vtx->z[i];
     }
+    span_x = (max_x - min_x) / 512 + 1;
+    span_y = (max_y - min_y) / 512 + 1;
+    span_z = (max_z - min_z) / 512 + 1;
     
-    long start_sort_ticks = GetTick();
-    sortFacesByDepth(model, model->faces.face_count);
-    long end_sort_ticks = GetTick();
+    // Sort key: direction bucket (bits 27-29), then Morton code of the centroid
+    for (i = 0; i < nf; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        int n = faces->vertex_count[i];
+        Fixed32 cx = 0, cy = 0, cz = 0;
+        for (j = 0; j < n; j++) {
+            cx += (vtx->x[idx[j] - 1] - min_x) / n;
+            cy += (vtx->y[idx[j] - 1] - min_y) / n;
+            cz += (vtx->z[idx[j] - 1] - min_z) / n;
+        }
+        keys[i] = ((long)faceDirection(faces, i) << 27)
+                | mortonSpread(cx / span_x) | (mortonSpread(cy / span_y) << 1) | (mortonSpread(cz / span_z) << 2);
+        perm[i] = i;
+    }
+    cluster_sort_keys = keys;
+    qsort(perm, (size_t)nf, sizeof(int), clusterCompareFaces);
+    faces->cluster_source = (int*)malloc((size_t)nf * sizeof(int));
+    if (faces->cluster_source == NULL) return -1;
+    memcpy(faces->cluster_source, perm, (size_t)nf * sizeof(int));
     
-#if !PERFORMANCE_MODE
-    printf("Transform+Project: %ld ticks (%.2f ms)\n", 
-           end_transform_ticks - start_transform_ticks, 
-           (end_transform_ticks - start_transform_ticks) * 1000.0 / 60.0);
-    printf("calculateFaceDepths: %ld ticks (%.2f ms)\n", 
-           end_calc_ticks - start_calc_ticks, 
-           (end_calc_ticks - start_calc_ticks) * 1000.0 / 60.0);
-    printf("sortFacesByDepth: %ld ticks (%.2f ms)\n", 
-           end_sort_ticks - start_sort_ticks,
-           (end_sort_ticks - start_sort_ticks) * 1000.0 / 60.0);
-    printf("\nHit a key to continue...\n");
-    keypress();
-#endif
+    clusterPermute(faces->vertex_count, perm, tmp, nf);
+    clusterPermute(faces->color, perm, tmp, nf);
+    clusterPermute((Byte*)faces->normal_x, perm, tmp, nf);
+    clusterPermute((Byte*)faces->normal_y, perm, tmp, nf);
+    clusterPermute((Byte*)faces->normal_z, perm, tmp, nf);
+    for (i = 0; i < nf; i++) tmp[i] = (int)faces->vertex_indices_ptr[perm[i]];
+    for (i = 0; i < nf; i++) faces->vertex_indices_ptr[i] = (IndexOffset)tmp[i];
+    
+    // Cut each direction bucket into near-equal runs of at most CLUSTER_MAX_FACES
+    for (pass = 0; pass < 2; pass++) {
+        count = 0;
+        for (start = 0; start < nf; start = i) {
+            int dir = faceDirection(faces, start), parts, size, extra, k, first = start;
+            for (i = start + 1; i < nf && faceDirection(faces, i) == dir; i++);
+            parts = (i - start + CLUSTER_MAX_FACES - 1) / CLUSTER_MAX_FACES;
+            size = (i - start) / parts;
+            extra = (i - start) % parts;
+            for (k = 0; k < parts; k++) {
+                int n = size + (k < extra ? 1 : 0);
+                if (pass == 1) {
+                    faces->clusters[count].first = first;
+                    faces->clusters[count].count = n;
+                    clusterBounds(model, &faces->clusters[count]);
+                }
+                first += n;
+                count++;
+            }
+        }
+        if (pass == 0) {
+            faces->clusters = (FaceCluster*)malloc((size_t)count * sizeof(FaceCluster));
+            if (faces->clusters == NULL) break;
+        }
+    }
+    for (i = 0; i < nf; i++) perm[i] = i;
+    if (faces->clusters == NULL) return -1;
+    faces->cluster_count = count;
+    return count;
 }
 
-// ============================================================================
-//                    BASIC FUNCTION IMPLEMENTATIONS
-// ============================================================================
-
 /**
- * VERTEX READING FROM OBJ FILE
- * ============================
- * 
- * This function parses an OBJ format file to extract
- * vertices (3D points). It searches for lines starting with "v "
- * and extracts X, Y, Z coordinates.
- * 
- * OBJ FORMAT FOR VERTICES:
- *   v 1.234 5.678 9.012
- *   v -2.5 0.0 3.14159
+ * OCTREE OVER FACE BOXES
+ * ======================
  * 
- * ALGORITHM:
- * 1. Open file in read mode
- * 2. Read line by line with fgets()
- * 3. Detect "v " lines with character verification
- * 4. Extract coordinates with sscanf()
- * 5. Store in array with bounds checking
- * 6. Progressive display for user feedback
+ * Spatial index of the loaded faces for views where most of the model is
+ * off screen (observer close to or inside a large scene). The root is the
+ * bounding cube of the vertices; a node holding more than
+ * OCTREE_LEAF_FACES faces is split at its centre into 8 cubes, down to
+ * OCTREE_MAX_DEPTH. Each face goes to the deepest cube containing its
+ * whole bounding box (Fixed32, object space): a face straddling a centre
+ * plane stays in the parent, so nodes never need to overlap.
  * 
- * ERROR HANDLING:
- * - File opening verification
- * - Array overflow protection
- * - Coordinate format validation
+ * octree_faces lists the face numbers node by node: a node's own faces,
+ * then the faces of its 8 children in octant order, so every subtree is
+ * the range [first, first + total). The list is partitioned in place by
+ * a counting pass per split, with z_max (octant codes) and sort_scratch
+ * (partition output) as scratch. Nodes grow with realloc while splitting
+ * and are trimmed at the end. Built after the clusters: it stores face
+ * numbers. Derived levels (coarse, LOD) have no octree.
  */
-int readVertices(const char* filename, VertexArrays3D* vtx, int max_vertices) {
-    FILE *file;
-    char line[MAX_LINE_LENGTH];
-    int line_number = 1;
-    int vertex_count = 0;
+static int octree_capacity;         // Nodes allocated while building
+
+// Octant of face in node n (bit 0 x, bit 1 y, bit 2 z above the centre),
+// or 8 when its bounding box straddles a centre plane
+static int octreeOctant(Model3D* model, int face, OctreeNode* n) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[face]];
+    int j, low = 7, high = 7, code = 0;
     
-    // Open file in read mode
-    file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("[DEBUG] readVertices: fopen failed\n");
-        printf("Error: Unable to open file '%s'\n", filename);
-        printf("Check that the file exists and you have read permissions.\n");
-        return -1;  // Return -1 on error
+    for (j = 0; j < faces->vertex_count[face]; j++) {
+        int v = idx[j] - 1;
+        if (vtx->x[v] > n->cx) low &= ~1;
+        if (vtx->x[v] < n->cx) high &= ~1;
+        if (vtx->y[v] > n->cy) low &= ~2;
+        if (vtx->y[v] < n->cy) high &= ~2;
+        if (vtx->z[v] > n->cz) low &= ~4;
+        if (vtx->z[v] < n->cz) high &= ~4;
     }
+    for (j = 1; j <= 4; j <<= 1) {
+        if (low & j) continue;
+        if (!(high & j)) return 8;
+        code |= j;
+    }
+    return code;
+}
+
+static int octreeSplit(Model3D* model, int node, int depth) {
+    FaceArrays3D* faces = &model->faces;
+    int *list = faces->octree_faces, *out = faces->sort_scratch;
+    Fixed32 *octant = faces->z_max;
+    OctreeNode n = faces->octree[node];  // Copy: realloc below may move the nodes
+    int count[9], start[9], i, k, first, child;
+    Fixed32 h = n.half / 2;
     
-    printf("\nReading vertices from file...'%s':\n", filename);
+    if (n.count <= OCTREE_LEAF_FACES || depth >= OCTREE_MAX_DEPTH) return 0;
+    for (k = 0; k < 9; k++) count[k] = 0;
+    for (i = n.first; i < n.first + n.count; i++) {
+        octant[i] = octreeOctant(model, list[i], &n);
+        count[octant[i]]++;
+    }
+    if (count[8] == n.count) return 0;  // Every face crosses the centre planes
     
-    // Read file line by line
-    while (fgets(line, sizeof(line), file) != NULL) {
-        // printf("%3d: %s", line_number, line);
-        if (line[0] == 'v' && line[1] == ' ') {
-            //printf("[DEBUG] readVertices: found vertex line %d\n", line_number);
-            if (vertex_count < max_vertices) {
-                float x, y, z;  // Temporary reading in float
-                if (sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3) {
-                    vtx->x[vertex_count] = FLOAT_TO_FIXED(x);
-                    vtx->y[vertex_count] = FLOAT_TO_FIXED(y);
-                    vtx->z[vertex_count] = FLOAT_TO_FIXED(z);
-                    vertex_count++;
-                    if (vertex_count % 10 == 0) printf("..");
-
-                } else {
-                    printf("[\nDEBUG] readVertices: sscanf failed at line %d: %s\n", line_number, line);
-                    keypress();
-                }
-            } else {
-                printf("\n[DEBUG] readVertices: vertex limit reached (%d)\n", max_vertices);
-                keypress();
-            }
-        }
-        line_number++;
+    // Faces kept at this node first, then octants 0..7
+    start[8] = n.first;
+    start[0] = n.first + count[8];
+    for (k = 1; k < 8; k++) start[k] = start[k - 1] + count[k - 1];
+    for (i = n.first; i < n.first + n.count; i++) out[start[octant[i]]++] = list[i];
+    memcpy(&list[n.first], &out[n.first], (size_t)n.count * sizeof(int));
+    
+    if (faces->octree_nodes + 8 > octree_capacity) {
+        OctreeNode* grown = (OctreeNode*)realloc(faces->octree,
+                                                 (size_t)octree_capacity * 2 * sizeof(OctreeNode));
+        if (grown == NULL) return -1;
+        faces->octree = grown;
+        octree_capacity *= 2;
     }
-    printf("\n");
-    printf("Reading vertices finished : %d vertices read.\n", vertex_count);
+    child = faces->octree_nodes;
+    faces->octree_nodes += 8;
+    faces->octree[node].child = child;
+    faces->octree[node].count = count[8];
+    first = n.first + count[8];
+    for (k = 0; k < 8; k++) {
+        OctreeNode* c = &faces->octree[child + k];
+        c->cx = n.cx + ((k & 1) ? h : -h);
+        c->cy = n.cy + ((k & 2) ? h : -h);
+        c->cz = n.cz + ((k & 4) ? h : -h);
+        c->half = h;
+        c->child = -1;
+        c->first = first;
+        c->count = count[k];
+        c->total = count[k];
+        first += count[k];
+    }
+    for (k = 0; k < 8; k++) {
+        if (octreeSplit(model, child + k, depth + 1) < 0) return -1;
+    }
+    return 0;
+}
 
-    // Close file
-    fclose(file);
-    
-    // printf("\n\nAnalyse terminee. %d lignes lues.\n", line_number - 1);
-    return vertex_count;  // Return the number of vertices read
+void releaseOctree(FaceArrays3D* faces) {
+    if (faces->octree != NULL) {
+        free(faces->octree);
+    }
+    if (faces->octree_faces != NULL) {
+        free(faces->octree_faces);
+    }
+    faces->octree = NULL;
+    faces->octree_faces = NULL;
+    faces->octree_nodes = 0;
 }
 
-// Function to read faces into parallel arrays in FaceArrays3D structure
-int readFaces_model(const char* filename, Model3D* model) {
-    FILE *file;
-    char line[MAX_LINE_LENGTH];
-    int line_number = 1;
-    int face_count = 0;
+int buildOctree(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int nf = faces->face_count;
+    Fixed32 min_x, min_y, min_z, max_x, max_y, max_z, span;
+    OctreeNode* root;
     int i;
     
-    // Validate model structure
-    if (model == NULL || model->faces.vertex_count == NULL) {
-        printf("Error: Invalid model structure for readFaces_model\n");
-        return -1;
+    releaseOctree(faces);
+    if (nf < 2 * OCTREE_LEAF_FACES || vtx->vertex_count <= 0) return 0;
+    
+    min_x = max_x = vtx->x[0];
+    min_y = max_y = vtx->y[0];
+    min_z = max_z = vtx->z[0];
+    for (i = 1; i < vtx->vertex_count; i++) {
+        if (vtx->x[i] < min_x) min_x = vtx->x[i];
+        if (vtx->x[i] > max_x) max_x = vtx->x[i];
+        if (vtx->y[i] < min_y) min_y = vtx->y[i];
+        if (vtx->y[i] > max_y) max_y = vtx->y[i];
+        if (vtx->z[i] < min_z) min_z = vtx->z[i];
+        if (vtx->z[i] > max_z) max_z = vtx->z[i];
     }
+    span = max_x - min_x;
+    if (max_y - min_y > span) span = max_y - min_y;
+    if (max_z - min_z > span) span = max_z - min_z;
     
-    // Open file in read mode
-    file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("Error: Unable to open file '%s' to read faces\n", filename);
+    octree_capacity = nf / OCTREE_LEAF_FACES * 2 + 9;
+    faces->octree = (OctreeNode*)malloc((size_t)octree_capacity * sizeof(OctreeNode));
+    faces->octree_faces = (int*)malloc((size_t)nf * sizeof(int));
+    if (faces->octree == NULL || faces->octree_faces == NULL) {
+        releaseOctree(faces);
+        return -1;
+    }
+    for (i = 0; i < nf; i++) faces->octree_faces[i] = i;
+    root = &faces->octree[0];
+    root->cx = min_x + (max_x - min_x) / 2;
+    root->cy = min_y + (max_y - min_y) / 2;
+    root->cz = min_z + (max_z - min_z) / 2;
+    root->half = span / 2 + 1;
+    root->child = -1;
+    root->first = 0;
+    root->count = nf;
+    root->total = nf;
+    faces->octree_nodes = 1;
+    
+    if (octreeSplit(model, 0, 0) < 0) {
+        releaseOctree(faces);
+        return -1;
+    }
+    if (faces->octree_nodes < octree_capacity) {
+        OctreeNode* trimmed = (OctreeNode*)realloc(faces->octree,
+                                                   (size_t)faces->octree_nodes * sizeof(OctreeNode));
+        if (trimmed != NULL) faces->octree = trimmed;
+    }
+    return faces->octree_nodes;
+}
+
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
+/**
+ * COMPLETE 3D MODEL LOADING
+ * ==========================
+ * 
+ * This function coordinates the complete loading of an OBJ file
+ * by successively calling the vertex and face reading functions.
+ * 
+ * LOADING PIPELINE:
+ * 1. Input parameter validation
+ * 2. Pre-scan: count vertices, faces and face indices
+ * 3. Carve exact-size arrays from the model arena
+ * 4. Read vertices from file
+ * 5. Read faces from file  
+ * 6. Update counters in structure
+ * 
+ * ERROR HANDLING:
+ * - Pre-scan, arena or vertex reading failure: immediate stop
+ * - Face reading failure: warning but continue
+ *   (vertices-only model remains usable)
+ */
+int loadModel3D(Model3D* model, const char* filename) {
+    int nv, nf;
+    long ni;
+    
+    // Input parameter validation
+    if (model == NULL || filename == NULL) {
+        return -1;  // Invalid parameters
+    }
+    
+    // Step 1: Pre-scan and arena sizing (full faces back in place on a reload)
+    releaseLodLevels(model);
+    releaseFaceClusters(&model->faces);
+    releaseOctree(&model->faces);
+    model->cull_mode = CULL_NONE;  // Per model: a new mesh may be open
+    if (scanObjCounts(filename, &nv, &nf, &ni) < 0) {
+        return -1;
+    }
+    if (carveModelArrays(model, nv, nf, ni) < 0) {
+        return -1;
+    }
+    
+    // Step 2: Read vertices from OBJ file
+    int vcount = readVertices(filename, &model->vertices, nv);
+    if (vcount < 0) {
+        return -1;  // Critical failure: unable to read vertices
+    }
+    model->vertices.vertex_count = vcount;
+    // --- MAJ du compteur global pour la vérification des indices de faces ---
+    readVertices_last_count = vcount;
+    
+    // Step 3: Read faces from OBJ file into the carved arrays
+    int fcount = readFaces_model(filename, model);
+    if (fcount < 0) {
+        // Critical failure: unable to read faces
+        printf("\nWarning: Unable to read faces\n");
+        model->faces.face_count = 0;  // No faces available
+    } else {
+        model->faces.face_count = fcount;
+    }
+    
+    // Step 4: Face normals for flat shading (object space, view independent)
+    computeFaceNormals(model);
+    model->faces.triangle_count = faceTriangles(&model->faces);
+    
+    // Step 5: Face clusters (reorders the faces: before any face numbers are kept)
+    if (buildFaceClusters(model) < 0) {
+        printf("\nWarning: Not enough memory for the face clusters\n");
+    }
+    
+    // Step 6: Octree over the face boxes (stores face numbers: after the clusters)
+    if (buildOctree(model) < 0) {
+        printf("\nWarning: Not enough memory for the octree\n");
+    }
+    
+    // Step 7: Unique edges for the wireframe mode
+    if (buildEdgeList(model) < 0) {
+        printf("\nWarning: Not enough memory for the edge list (no wireframe)\n");
+    }
+    
+    // Step 8: Decimated faces for the progressive first frame
+    if (buildCoarseLevel(model) < 0) {
+        printf("\nWarning: Not enough memory for the coarse level\n");
+    }
+    
+    // Step 9: Levels of detail for distant views
+    if (buildLodLevels(model) < 0) {
+        printf("\nWarning: Not enough memory for the levels of detail\n");
+    }
+    
+    // Step 10: Convexity (culling-only frames, see cullFacesConvex)
+    detectConvex(model);
+    
+    return 0;  // Success: model loaded (with or without faces)
+}
+
+// ============================================================================
+//                    USER INTERFACE FUNCTIONS
+// ============================================================================
+
+/**
+ * OBSERVER PARAMETER INPUT
+ * ========================
+ * 
+ * This function presents a text interface to allow the
+ * user to specify 3D visualization parameters.
+ * 
+ * REQUESTED PARAMETERS:
+ * - Horizontal angle: rotation around Y-axis (left/right view)
+ * - Vertical angle: rotation around X-axis (up/down view)
+ * - Distance: observer distance (zoom)
+ * - Screen rotation angle: final rotation in 2D plane
+ * 
+ * ERROR HANDLING:
+ * - Default values if input failure
+ * - Automatic string->Fixed32 conversion with atof() then FLOAT_TO_FIXED
+ */
+int applyNavigationKey(ObserverParams* params, int key) {
+    switch (key) {
+        case 65:  // 'A' - decrease distance
+        case 97:  // 'a'
+            params->distance = params->distance - (params->distance / 10);
+            return 1;
+        case 90:  // 'Z' - increase distance
+        case 122: // 'z'
+            params->distance = params->distance + (params->distance / 10);
+            return 1;
+        case 21:  // Right arrow - increase horizontal angle
+            params->angle_h = params->angle_h + INT_TO_FIXED(10);
+            return 1;
+        case 8:   // Left arrow - decrease horizontal angle
+            params->angle_h = params->angle_h - INT_TO_FIXED(10);
+            return 1;
+        case 10:  // Down arrow - decrease vertical angle
+            params->angle_v = params->angle_v - INT_TO_FIXED(10);
+            return 1;
+        case 11:  // Up arrow - increase vertical angle
+            params->angle_v = params->angle_v + INT_TO_FIXED(10);
+            return 1;
+        case 87:  // 'W' - increase screen rotation angle
+        case 119: // 'w'
+            params->angle_w = params->angle_w + INT_TO_FIXED(10);
+            return 1;
+        case 88:  // 'X' - decrease screen rotation angle
+        case 120: // 'x'
+            params->angle_w = params->angle_w - INT_TO_FIXED(10);
+            return 1;
+    }
+    return 0;
+}
+
+void getObserverParams(ObserverParams* params) {
+    char input[50];  // Buffer for user input
+    
+    // Display section header
+    printf("\nObserver parameters:\n");
+    printf("============================\n");
+    printf("(Press ENTER to use default values)\n");
+    printf("(Enter 'debug' to see values used)\n");
+    
+    // Input horizontal angle (rotation around Y)
+    printf("Horizontal angle (degrees, default 30): ");
+    if (fgets(input, sizeof(input), stdin) != NULL) {
+        // Remove newline
+        input[strcspn(input, "\n")] = 0;
+        if (strlen(input) == 0) {
+            params->angle_h = FLOAT_TO_FIXED(30.0);     // Default value if ENTER (Fixed Point)
+        } else {
+            params->angle_h = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
+        }
+    } else {
+        params->angle_h = FLOAT_TO_FIXED(30.0);         // Default value if error (Fixed Point)
+    }
+    
+    // Input vertical angle (rotation around X)  
+    printf("Vertical angle (degrees, default 20): ");
+    if (fgets(input, sizeof(input), stdin) != NULL) {
+        // Remove newline
+        input[strcspn(input, "\n")] = 0;
+        if (strlen(input) == 0) {
+            params->angle_v = FLOAT_TO_FIXED(20.0);     // Default value if ENTER (Fixed Point)
+        } else {
+            params->angle_v = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
+        }
+    } else {
+        params->angle_v = FLOAT_TO_FIXED(20.0);         // Default value if error (Fixed Point)
+    }
+    
+
+    // Input screen rotation angle (final 2D rotation)
+    printf("Screen rotation angle (degrees, default 0): ");
+    if (fgets(input, sizeof(input), stdin) != NULL) {
+        // Remove newline
+        input[strcspn(input, "\n")] = 0;
+        if (strlen(input) == 0) {
+            params->angle_w = FLOAT_TO_FIXED(0.0);      // Default value if ENTER (Fixed Point)
+        } else {
+            params->angle_w = FLOAT_TO_FIXED(atof(input));  // String->Fixed32 conversion
+        }
+    } else {
+        params->angle_w = FLOAT_TO_FIXED(0.0);          // No rotation by default (Fixed Point)
+    }
+
+    // Input observation distance (zoom/perspective)
+    printf("Distance (default 30): ");
+    if (fgets(input, sizeof(input), stdin) != NULL) {
+        // Remove newline
+        input[strcspn(input, "\n")] = 0;
+        if (strlen(input) == 0) {
+            params->distance = FLOAT_TO_FIXED(30.0);    // Default value if ENTER (Fixed Point)
+        } else {
+            params->distance = FLOAT_TO_FIXED(atof(input)); // String->Fixed32 conversion
+        }
+    } else {
+        params->distance = FLOAT_TO_FIXED(30.0);        // Default distance: balanced view (Fixed Point)
+    }
+}
+
+/**
+ * MODEL INFORMATION DISPLAY
+ * =========================
+ * 
+ * Displays a statistical summary of the loaded 3D model:
+ * number of vertices and number of faces.
+ * 
+ * This function serves as quick validation that loading
+ * completed correctly.
+ */
+void displayModelInfo(Model3D* model) {
+    // printf("\nAnalysis summary:\n");
+    // printf("====================\n");
+    // printf("Number of vertices (3D points) found: %d\n", model->vertices.vertex_count);
+    // printf("Number of faces found: %d\n", model->faces.face_count);
+}
+
+/**
+ * DETAILED RESULTS DISPLAY
+ * ========================
+ * 
+ * This function displays all vertex coordinates through
+ * the different stages of the rendering pipeline:
+ * 1. Original coordinates (x, y, z)
+ * 2. Transformed coordinates (xo, yo, zo)
+ * 3. 2D projected coordinates (x2d, y2d)
+ * 
+ * Also displays the list of faces with their vertices.
+ * Useful for debugging and calculation verification.
+ */
+void displayResults(Model3D* model) {
+    int i, j;
+    VertexArrays3D* vtx = &model->vertices;
+    // printf("\nComplete coordinates (Original -> 3D -> 2D):\n");
+    // printf("-----------------------------------------------\n");
+    // for (i = 0; i < vtx->vertex_count; i++) {
+    //     if (vtx->x2d[i] >= 0 && vtx->y2d[i] >= 0) {
+    //         printf("  Vertex %3d: (%.2f,%.2f,%.2f) -> (%.2f,%.2f,%.2f) -> (%d,%d)\n",
+    //                i + 1,
+    //                FIXED_TO_FLOAT(vtx->x[i]), FIXED_TO_FLOAT(vtx->y[i]), FIXED_TO_FLOAT(vtx->z[i]),
+    //                FIXED_TO_FLOAT(vtx->xo[i]), FIXED_TO_FLOAT(vtx->yo[i]), FIXED_TO_FLOAT(vtx->zo[i]),
+    //                vtx->x2d[i], vtx->y2d[i]);
+    //     } else {
+    //         printf("  Vertex %3d: (%.2f,%.2f,%.2f) -> (%.2f,%.2f,%.2f) -> (invisible)\n",
+    //                i + 1,
+    //                FIXED_TO_FLOAT(vtx->x[i]), FIXED_TO_FLOAT(vtx->y[i]), FIXED_TO_FLOAT(vtx->z[i]),
+    //                FIXED_TO_FLOAT(vtx->xo[i]), FIXED_TO_FLOAT(vtx->yo[i]), FIXED_TO_FLOAT(vtx->zo[i]));
+    //     }
+    // }
+    
+    if (model->faces.face_count > 0) {
+        // printf("\nFace list:\n");
+        // printf("----------------\n");
+        for (i = 0; i < model->faces.face_count; i++) {
+            // printf("  Face %3d (%d vertices, z_max=%.2f): ", i + 1, model->faces.vertex_count[i], FIXED_TO_FLOAT(model->faces.z_max[i]));
+            IndexOffset offset = model->faces.vertex_indices_ptr[i];
+            // for (j = 0; j < model->faces.vertex_count[i]; j++) {
+            //     printf("%d", model->faces.vertex_indices_buffer[offset + j]);
+            //     if (j < model->faces.vertex_count[i] - 1) printf("-");
+            // }
+            // printf("\n");
+            // printf("       Coordinates of vertices of this face:\n");
+            for (j = 0; j < model->faces.vertex_count[i]; j++) {
+                int vertex_idx = model->faces.vertex_indices_buffer[offset + j] - 1;
+                if (vertex_idx >= 0 && vertex_idx < vtx->vertex_count) {
+                    // printf("         Vertex %d: (%.2f,%.2f,%.2f) -> (%d,%d)\n",
+                    //     model->faces.vertex_indices_buffer[offset + j],
+                    //     FIXED_TO_FLOAT(vtx->x[vertex_idx]), FIXED_TO_FLOAT(vtx->y[vertex_idx]), FIXED_TO_FLOAT(vtx->z[vertex_idx]),
+                    //     vtx->x2d[vertex_idx], vtx->y2d[vertex_idx]);
+                } else {
+                    // printf("         Vertex %d: ERROR - Index out of bounds!\n", model->faces.vertex_indices_buffer[offset + j]);
+                }
+            }
+            // printf("\n");
+        }
+        drawPolygons(model, model->faces.vertex_count, model->faces.face_count, vtx->vertex_count);
+    }
+}
+
+#if GS3D_THREADS
+// ============================================================================
+//                           HOST THREAD POOL
+// ============================================================================
+
+/**
+ * HOST THREAD POOL
+ * ================
+ * 
+ * Large models on the host spend their frame in three loops: the vertex
+ * kernel, the per-face depth pass and the radix sort. Each is split into
+ * chunks of consecutive items (poolChunks) that run on pool_threads
+ * threads: the calling thread plus workers created on first use and kept
+ * asleep on a condition variable between stages. A stage posts its task,
+ * every thread takes the next chunk under pool_lock until none is left,
+ * and poolRun returns when the last one is done.
+ * 
+ * DETERMINISM:
+ *   Chunks write disjoint items and keep their counters apart (summed by
+ *   the caller in chunk order), so the output does not depend on the
+ *   thread count or on which thread ran which chunk:
+ *   - vertex kernel: one vertex per item, behind counts per chunk
+ *   - depth pass: chunks are multiples of 8 faces (whole display flag
+ *     bytes); octree lists go through sort_scratch (see depthListTask)
+ *   - radix sort: per-chunk histograms merged bucket by bucket, chunks
+ *     in order, then a parallel scatter: the same stable order as the
+ *     single-thread sort
+ *   runThreadScaling ('Q') checks this byte for byte.
+ * 
+ * NOTES:
+ *   - Stages under POOL_MIN_ITEMS items, and pool_threads = 1, call the
+ *     single-thread code directly
+ *   - Workers are never joined: they sleep until the process exits
+ */
+static int pool_threads = 1;             // Threads per stage ('F'), 1 = calling thread only
+static int pool_cpus = 1;                // Online CPUs
+static pthread_t pool_workers[POOL_MAX_THREADS - 1];
+static int pool_started = 0;             // Workers created so far
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;  // A stage was posted
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;  // Its last chunk is done
+static void (*pool_task)(void* arg, int chunk);
+static void* pool_arg;
+static int pool_chunks = 0;              // Chunks of the posted stage
+static int pool_next = 0;                // ... next one to hand out
+static int pool_left = 0;                // ... not finished yet
+static int pool_helpers = 0;             // Workers taking part (the others sleep on)
+static long pool_stage = 0;              // Posted stages, wakes the workers
+
+void poolInit(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pool_cpus = (cpus < 1) ? 1 : (cpus > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)cpus);
+    pool_threads = pool_cpus;
+}
+
+int poolChunks(long items, int* chunk_items) {
+    int chunks = pool_threads * POOL_CHUNKS_PER_THREAD;
+    long size;
+    
+    if (chunks > POOL_MAX_CHUNKS) chunks = POOL_MAX_CHUNKS;
+    size = (items + chunks - 1) / chunks;
+    size = (size + 7) & ~7L;  // Whole display flag bytes
+    *chunk_items = (int)size;
+    return (int)((items + size - 1) / size);
+}
+
+// Takes chunks of the posted stage until none is left (pool_lock held)
+static void poolDrain(void) {
+    while (pool_next < pool_chunks) {
+        int chunk = pool_next++;
+        pthread_mutex_unlock(&pool_lock);
+        pool_task(pool_arg, chunk);
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_left == 0) pthread_cond_signal(&pool_idle);
+    }
+}
+
+static void* poolWorker(void* param) {
+    int id = (int)(long)param;
+    long seen = 0;
+    
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_stage == seen) pthread_cond_wait(&pool_wake, &pool_lock);
+        seen = pool_stage;
+        if (id < pool_helpers) poolDrain();
+    }
+    return NULL;
+}
+
+void poolRun(void (*task)(void* arg, int chunk), void* arg, int chunks) {
+    int i;
+    
+    if (pool_threads <= 1 || chunks <= 1) {
+        for (i = 0; i < chunks; i++) task(arg, i);
+        return;
+    }
+    pthread_mutex_lock(&pool_lock);
+    while (pool_started < pool_threads - 1) {
+        if (pthread_create(&pool_workers[pool_started], NULL, poolWorker, (void*)(long)pool_started) != 0) {
+            pool_threads = pool_started + 1;  // Run with the workers we have
+            break;
+        }
+        pool_started++;
+    }
+    pool_task = task;
+    pool_arg = arg;
+    pool_chunks = chunks;
+    pool_next = 0;
+    pool_left = chunks;
+    pool_helpers = pool_threads - 1;
+    pool_stage++;
+    pthread_cond_broadcast(&pool_wake);
+    poolDrain();
+    while (pool_left > 0) pthread_cond_wait(&pool_idle, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Wall clock in seconds (clock() would add up the CPU time of every thread)
+static double poolSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Stage outputs of the current frame packed into 'out' (NULL: size only)
+static long scalingSnapshot(Model3D* model, int listed, char* out) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    size_t nv = (size_t)vtx->vertex_count, nf = (size_t)faces->face_count;
+    int counters[6];
+    long size = 0;
+    
+    counters[0] = listed;
+    counters[1] = frame_culled_winding;
+    counters[2] = frame_culled_subpixel;
+    counters[3] = frame_clusters_accepted;
+    counters[4] = frame_clusters_rejected;
+    counters[5] = frame_clusters_partial;
+#define SNAPSHOT(ptr, bytes) do { if (out != NULL) memcpy(out + size, (ptr), (bytes)); size += (long)(bytes); } while (0)
+    SNAPSHOT(vtx->xo, nv * sizeof(Fixed32));
+    SNAPSHOT(vtx->yo, nv * sizeof(Fixed32));
+    SNAPSHOT(vtx->zo, nv * sizeof(Fixed32));
+    SNAPSHOT(vtx->x2d, nv * sizeof(int));
+    SNAPSHOT(vtx->y2d, nv * sizeof(int));
+    SNAPSHOT(faces->display_flag, FACE_FLAG_BYTES(nf));
+    SNAPSHOT(faces->sorted_face_indices, (size_t)listed * sizeof(int));
+    SNAPSHOT(counters, sizeof(counters));
+#undef SNAPSHOT
+    return size;
+}
+
+/**
+ * THREAD SCALING REPORT ('Q' key, host builds)
+ * ============================================
+ * 
+ * Runs the transform, depth and sort stages of the current view
+ * POOL_SCALING_REPS times for each thread count from 1 to N (the online
+ * CPUs, or the 'F' setting if higher) and prints the best wall time of
+ * each stage and the speedup over one thread. Every run is compared byte
+ * for byte with the first single-thread run (vertex arrays, display
+ * flags, face order, culling counters); z_max is left out as faces culled
+ * by whole clusters keep a stale one.
+ * 
+ * RETURNS:
+ *   1 if every run matched, 0 on a difference, -1 if no memory
+ */
+int runThreadScaling(Model3D* model, ObserverParams* params) {
+    int saved_threads = pool_threads;
+    int max_threads = (pool_cpus > pool_threads) ? pool_cpus : pool_threads;
+    long bytes = scalingSnapshot(model, model->faces.face_count, NULL);
+    char *ref = (char*)malloc((size_t)bytes);
+    char *run = (char*)malloc((size_t)bytes);
+    long ref_bytes = 0;
+    double base = 0.0;
+    int threads, rep, ok = 1;
+#if ENABLE_STATS
+    FrameStats saved_stats = stats_current;  // Not part of any frame
+#endif
+    
+    if (ref == NULL || run == NULL) {
+        free(ref);
+        free(run);
+        printf("Thread scaling: not enough memory\n");
+        return -1;
+    }
+    printf("Thread scaling: %ld vertices, %d faces, %d CPUs, best of %d runs (ms)\n",
+           (long)model->vertices.vertex_count, model->faces.face_count, pool_cpus, POOL_SCALING_REPS);
+    if (model->vertices.vertex_count < POOL_MIN_ITEMS && model->faces.face_count < POOL_MIN_ITEMS) {
+        printf("(under %ld vertices and faces: every stage stays on one thread)\n", POOL_MIN_ITEMS);
+    }
+    printf("Threads  Transform    Depth     Sort    Total  Speedup  Output\n");
+    for (threads = 1; threads <= max_threads; threads++) {
+        double best[3] = {0.0, 0.0, 0.0};
+        int same = 1;
+        pool_threads = threads;
+        for (rep = 0; rep < POOL_SCALING_REPS; rep++) {
+            double t0, t1, t2, t3;
+            int listed;
+            t0 = poolSeconds();
+            transformVertices(model, params);
+            t1 = poolSeconds();
+            listed = calculateViewDepths(model, params);
+            t2 = poolSeconds();
+            sortFacesByDepth(model, listed);
+            t3 = poolSeconds();
+            model->faces.draw_count = listed;
+            if (rep == 0 || t1 - t0 < best[0]) best[0] = t1 - t0;
+            if (rep == 0 || t2 - t1 < best[1]) best[1] = t2 - t1;
+            if (rep == 0 || t3 - t2 < best[2]) best[2] = t3 - t2;
+            if (threads == 1 && rep == 0) {
+                ref_bytes = scalingSnapshot(model, listed, ref);
+            } else {
+                bytes = scalingSnapshot(model, listed, run);
+                if (bytes != ref_bytes || memcmp(ref, run, (size_t)bytes) != 0) same = 0;
+            }
+        }
+        if (threads == 1) base = best[0] + best[1] + best[2];
+        printf("%7d %10.2f %8.2f %8.2f %8.2f %7.2fx  %s\n", threads,
+               best[0] * 1000.0, best[1] * 1000.0, best[2] * 1000.0,
+               (best[0] + best[1] + best[2]) * 1000.0,
+               base / (best[0] + best[1] + best[2] + 1e-9),
+               threads == 1 ? (same ? "reference" : "NOT REPEATABLE") : (same ? "same" : "DIFFERENT"));
+        if (!same) ok = 0;
+    }
+    printf("Determinism check %s\n", ok ? "passed" : "FAILED");
+    pool_threads = saved_threads;
+#if ENABLE_STATS
+    stats_current = saved_stats;
+#endif
+    free(ref);
+    free(run);
+    return ok;
+}
+#endif
+
+// ============================================================================
+//                           VERTEX TRANSFORM
+// ============================================================================
+
+/**
+ * ANGLE NORMALIZATION
+ * ===================
+ * 
+ * Whole degrees in 0..359, safe to index deg_to_rad_table and usable as a
+ * view cache key (arrow keys can take angles below 0 or above 360).
+ */
+int normalizeDegrees(Fixed32 angle) {
+    int deg = FIXED_TO_INT(angle) % 360;
+    return (deg < 0) ? deg + 360 : deg;
+}
+
+/**
+ * ULTRA-FAST FUNCTION: Combined Transformation + Projection
+ * ==========================================================
+ * 
+ * Trigonometry is computed once per frame, then one of the kernels runs
+ * over the SoA vertex arrays (transform_kernel):
+ *   KERNEL_SCALAR64 : reference loop, FIXED_MUL_64 for every product
+ *   KERNEL_SPLIT32  : each operand split once into 16-bit halves, products
+ *                     with FIXED_MUL_SPLIT (32-bit only). Bit-exact with
+ *                     the reference, verified by transformKernelSelfCheck
+ *   KERNEL_SSE41    : host x86 only, the reference arithmetic on 4 vertices
+ *                     at a time (pmuldq products, scalar division per
+ *                     lane). Picked when cpuid reports SSE4.1, also checked
+ *                     by transformKernelSelfCheck and runTransformKernelTest
+ */
+typedef struct {
+    Fixed32 cos_h, sin_h, cos_v, sin_v, cos_w, sin_w;
+    Fixed32 cos_h_cos_v, sin_h_cos_v, cos_h_sin_v, sin_h_sin_v;
+    Fixed32 distance;
+} ViewTrig;
+
+static void computeViewTrig(ObserverParams* params, ViewTrig* t) {
+    // Direct table access - ultra-fast! (no function calls)
+    Fixed32 rad_h = deg_to_rad_table[normalizeDegrees(params->angle_h)];
+    Fixed32 rad_v = deg_to_rad_table[normalizeDegrees(params->angle_v)];
+    Fixed32 rad_w = deg_to_rad_table[normalizeDegrees(params->angle_w)];
+    
+    // Pre-calculate ALL trigonometric values in Fixed32 (ultra-fast)
+    t->cos_h = cos_fixed(rad_h);
+    t->sin_h = sin_fixed(rad_h);
+    t->cos_v = cos_fixed(rad_v);
+    t->sin_v = sin_fixed(rad_v);
+    t->cos_w = cos_fixed(rad_w);
+    t->sin_w = sin_fixed(rad_w);
+    
+    // Pre-calculate all trigonometric products in Fixed32 - using 64-bit multiply
+    t->cos_h_cos_v = FIXED_MUL_64(t->cos_h, t->cos_v);
+    t->sin_h_cos_v = FIXED_MUL_64(t->sin_h, t->cos_v);
+    t->cos_h_sin_v = FIXED_MUL_64(t->cos_h, t->sin_v);
+    t->sin_h_sin_v = FIXED_MUL_64(t->sin_h, t->sin_v);
+    t->distance = params->distance;
+}
+
+// Kernels transform the vertices [first, end) and return how many are
+// behind the observer (STAT_VERTS_BEHIND, added by the caller)
+static long transformVertices_scalar64(VertexArrays3D* vtx, const ViewTrig* t, int first, int end) {
+    int i;
+    long behind = 0;
+    Fixed32 x, y, z, zo, xo, yo;
+    Fixed32 inv_zo, x2d_temp, y2d_temp;
+    const Fixed32 cos_h = t->cos_h, sin_h = t->sin_h, cos_v = t->cos_v, sin_v = t->sin_v;
+    const Fixed32 cos_w = t->cos_w, sin_w = t->sin_w;
+    const Fixed32 cos_h_cos_v = t->cos_h_cos_v;
+    const Fixed32 sin_h_cos_v = t->sin_h_cos_v;
+    const Fixed32 cos_h_sin_v = t->cos_h_sin_v;
+    const Fixed32 sin_h_sin_v = t->sin_h_sin_v;
+    const Fixed32 scale = FLOAT_TO_FIXED(100.0);
+    const Fixed32 centre_x_f = FLOAT_TO_FIXED((float)CENTRE_X);
+    const Fixed32 centre_y_f = FLOAT_TO_FIXED((float)CENTRE_Y);
+    const Fixed32 distance = t->distance;
+    
+    // 100% Fixed32 loop - ZERO conversions, maximum speed!
+    for (i = first; i < end; i++) {
+        x = vtx->x[i];
+        y = vtx->y[i];
+        z = vtx->z[i];
+        // 3D transformation in pure Fixed32 (64-bit multiply)
+        Fixed32 term1 = FIXED_MUL_64(x, cos_h_cos_v);
+        Fixed32 term2 = FIXED_MUL_64(y, sin_h_cos_v);
+        Fixed32 term3 = FIXED_MUL_64(z, sin_v);
+        zo = FIXED_ADD(FIXED_SUB(FIXED_SUB(FIXED_NEG(term1), term2), term3), distance);
+        if (zo > 0) {
+            xo = FIXED_ADD(FIXED_NEG(FIXED_MUL_64(x, sin_h)), FIXED_MUL_64(y, cos_h));
+            yo = FIXED_ADD(FIXED_SUB(FIXED_NEG(FIXED_MUL_64(x, cos_h_sin_v)), FIXED_MUL_64(y, sin_h_sin_v)), FIXED_MUL_64(z, cos_v));
+            vtx->zo[i] = zo;
+            vtx->xo[i] = xo;
+            vtx->yo[i] = yo;
+            inv_zo = FIXED_DIV_64(scale, zo);
+            x2d_temp = FIXED_ADD(FIXED_MUL_64(xo, inv_zo), centre_x_f);
+            y2d_temp = FIXED_SUB(centre_y_f, FIXED_MUL_64(yo, inv_zo));
+            vtx->x2d[i] = FIXED_TO_INT(FIXED_ADD(FIXED_SUB(FIXED_MUL_64(cos_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(sin_w, FIXED_SUB(centre_y_f, y2d_temp))), centre_x_f));
+            vtx->y2d[i] = FIXED_TO_INT(FIXED_SUB(centre_y_f, FIXED_ADD(FIXED_MUL_64(sin_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(cos_w, FIXED_SUB(centre_y_f, y2d_temp)))));
+        } else {
+            vtx->zo[i] = zo;
+            vtx->xo[i] = 0;
+            vtx->yo[i] = 0;
+            vtx->x2d[i] = -1;
+            vtx->y2d[i] = -1;
+            behind++;
+        }
+    }
+    return behind;
+}
+
+static long transformVertices_split32(VertexArrays3D* vtx, const ViewTrig* t, int first, int end) {
+    int i;
+    long behind = 0;
+    const Fixed32 scale = FLOAT_TO_FIXED(100.0);
+    const Fixed32 centre_x_f = FLOAT_TO_FIXED((float)CENTRE_X);
+    const Fixed32 centre_y_f = FLOAT_TO_FIXED((float)CENTRE_Y);
+    const Fixed32 distance = t->distance;
+    
+    // Per-frame constants split once
+    const long chcv_h = FIXED_HI(t->cos_h_cos_v), shcv_h = FIXED_HI(t->sin_h_cos_v), sv_h = FIXED_HI(t->sin_v);
+    const unsigned long chcv_l = FIXED_LO(t->cos_h_cos_v), shcv_l = FIXED_LO(t->sin_h_cos_v), sv_l = FIXED_LO(t->sin_v);
+    const long sh_h = FIXED_HI(t->sin_h), ch_h = FIXED_HI(t->cos_h), cv_h = FIXED_HI(t->cos_v);
+    const unsigned long sh_l = FIXED_LO(t->sin_h), ch_l = FIXED_LO(t->cos_h), cv_l = FIXED_LO(t->cos_v);
+    const long chsv_h = FIXED_HI(t->cos_h_sin_v), shsv_h = FIXED_HI(t->sin_h_sin_v);
+    const unsigned long chsv_l = FIXED_LO(t->cos_h_sin_v), shsv_l = FIXED_LO(t->sin_h_sin_v);
+    const long cw_h = FIXED_HI(t->cos_w), sw_h = FIXED_HI(t->sin_w);
+    const unsigned long cw_l = FIXED_LO(t->cos_w), sw_l = FIXED_LO(t->sin_w);
+    
+    for (i = first; i < end; i++) {
+        // Vertex split once, reused by every product below
+        const long xh = FIXED_HI(vtx->x[i]), yh = FIXED_HI(vtx->y[i]), zh = FIXED_HI(vtx->z[i]);
+        const unsigned long xl = FIXED_LO(vtx->x[i]), yl = FIXED_LO(vtx->y[i]), zl = FIXED_LO(vtx->z[i]);
+        Fixed32 zo = -FIXED_MUL_SPLIT(xh, xl, chcv_h, chcv_l)
+                     - FIXED_MUL_SPLIT(yh, yl, shcv_h, shcv_l)
+                     - FIXED_MUL_SPLIT(zh, zl, sv_h, sv_l) + distance;
+        vtx->zo[i] = zo;
+        if (zo > 0) {
+            Fixed32 xo = -FIXED_MUL_SPLIT(xh, xl, sh_h, sh_l) + FIXED_MUL_SPLIT(yh, yl, ch_h, ch_l);
+            Fixed32 yo = -FIXED_MUL_SPLIT(xh, xl, chsv_h, chsv_l) - FIXED_MUL_SPLIT(yh, yl, shsv_h, shsv_l)
+                         + FIXED_MUL_SPLIT(zh, zl, cv_h, cv_l);
+            Fixed32 inv_zo = FIXED_DIV_64(scale, zo);  // One division per vertex, kept exact
+            long iz_h = FIXED_HI(inv_zo);
+            unsigned long iz_l = FIXED_LO(inv_zo);
+            // Offsets from the screen centre before the screen rotation
+            Fixed32 dx = FIXED_MUL_SPLIT(FIXED_HI(xo), FIXED_LO(xo), iz_h, iz_l);
+            Fixed32 dy = FIXED_MUL_SPLIT(FIXED_HI(yo), FIXED_LO(yo), iz_h, iz_l);
+            long dx_h = FIXED_HI(dx), dy_h = FIXED_HI(dy);
+            unsigned long dx_l = FIXED_LO(dx), dy_l = FIXED_LO(dy);
+            vtx->xo[i] = xo;
+            vtx->yo[i] = yo;
+            vtx->x2d[i] = FIXED_TO_INT(FIXED_MUL_SPLIT(cw_h, cw_l, dx_h, dx_l) - FIXED_MUL_SPLIT(sw_h, sw_l, dy_h, dy_l) + centre_x_f);
+            vtx->y2d[i] = FIXED_TO_INT(centre_y_f - (FIXED_MUL_SPLIT(sw_h, sw_l, dx_h, dx_l) + FIXED_MUL_SPLIT(cw_h, cw_l, dy_h, dy_l)));
+        } else {
+            vtx->xo[i] = 0;
+            vtx->yo[i] = 0;
+            vtx->x2d[i] = -1;
+            vtx->y2d[i] = -1;
+            behind++;
+        }
+    }
+    return behind;
+}
+
+#if GS3D_SIMD
+// FIXED_MUL_64 on 4 lanes: pmuldq multiplies the even lanes (then the odd
+// lanes shifted down) into signed 64-bit products; bits 16..47 of each
+// product are the lane result, as in the truncating scalar cast
+__attribute__((target("sse4.1")))
+static inline __m128i fixedMul4(__m128i a, __m128i b) {
+    __m128i even = _mm_srli_epi64(_mm_mul_epi32(a, b), FIXED_SHIFT);
+    __m128i odd = _mm_slli_epi64(_mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)),
+                                 32 - FIXED_SHIFT);
+    return _mm_blend_epi16(even, odd, 0xCC);
+}
+
+static int cpuHasSse41(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_1) != 0;
+}
+
+__attribute__((target("sse4.1")))
+static long transformVertices_sse41(VertexArrays3D* vtx, const ViewTrig* t, int first, int end) {
+    int i, k;
+    long behind = 0;
+    const Fixed32 scale = FLOAT_TO_FIXED(100.0);
+    const __m128i centre_x_f = _mm_set1_epi32(FLOAT_TO_FIXED((float)CENTRE_X));
+    const __m128i centre_y_f = _mm_set1_epi32(FLOAT_TO_FIXED((float)CENTRE_Y));
+    const __m128i distance = _mm_set1_epi32(t->distance);
+    const __m128i cos_h_cos_v = _mm_set1_epi32(t->cos_h_cos_v), sin_h_cos_v = _mm_set1_epi32(t->sin_h_cos_v);
+    const __m128i cos_h_sin_v = _mm_set1_epi32(t->cos_h_sin_v), sin_h_sin_v = _mm_set1_epi32(t->sin_h_sin_v);
+    const __m128i cos_h = _mm_set1_epi32(t->cos_h), sin_h = _mm_set1_epi32(t->sin_h);
+    const __m128i cos_v = _mm_set1_epi32(t->cos_v), sin_v = _mm_set1_epi32(t->sin_v);
+    const __m128i cos_w = _mm_set1_epi32(t->cos_w), sin_w = _mm_set1_epi32(t->sin_w);
+    const __m128i behind_2d = _mm_set1_epi32(-1);
+    
+    for (i = first; i + 4 <= end; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&vtx->x[i]);
+        __m128i y = _mm_loadu_si128((const __m128i*)&vtx->y[i]);
+        __m128i z = _mm_loadu_si128((const __m128i*)&vtx->z[i]);
+        __m128i zo = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(distance, fixedMul4(x, cos_h_cos_v)),
+                                                 fixedMul4(y, sin_h_cos_v)), fixedMul4(z, sin_v));
+        __m128i front = _mm_cmpgt_epi32(zo, _mm_setzero_si128());
+        __m128i xo, yo, inv_zo, dx, dy, x2d, y2d;
+        Fixed32 lane_zo[4], lane_inv[4];
+        
+        _mm_storeu_si128((__m128i*)&vtx->zo[i], zo);
+        _mm_storeu_si128((__m128i*)lane_zo, zo);
+        // No integer division in SSE: one exact FIXED_DIV_64 per lane in front
+        for (k = 0; k < 4; k++) {
+            if (lane_zo[k] > 0) {
+                lane_inv[k] = FIXED_DIV_64(scale, lane_zo[k]);
+            } else {
+                lane_inv[k] = 0;
+                behind++;
+            }
+        }
+        inv_zo = _mm_loadu_si128((const __m128i*)lane_inv);
+        xo = _mm_sub_epi32(fixedMul4(y, cos_h), fixedMul4(x, sin_h));
+        yo = _mm_sub_epi32(_mm_sub_epi32(fixedMul4(z, cos_v), fixedMul4(x, cos_h_sin_v)),
+                           fixedMul4(y, sin_h_sin_v));
+        dx = fixedMul4(xo, inv_zo);
+        dy = fixedMul4(yo, inv_zo);
+        x2d = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(fixedMul4(cos_w, dx), fixedMul4(sin_w, dy)),
+                                           centre_x_f), FIXED_SHIFT);
+        y2d = _mm_srai_epi32(_mm_sub_epi32(centre_y_f, _mm_add_epi32(fixedMul4(sin_w, dx), fixedMul4(cos_w, dy))),
+                             FIXED_SHIFT);
+        // Lanes behind the observer: xo = yo = 0, x2d = y2d = -1
+        _mm_storeu_si128((__m128i*)&vtx->xo[i], _mm_and_si128(xo, front));
+        _mm_storeu_si128((__m128i*)&vtx->yo[i], _mm_and_si128(yo, front));
+        _mm_storeu_si128((__m128i*)&vtx->x2d[i], _mm_blendv_epi8(behind_2d, x2d, front));
+        _mm_storeu_si128((__m128i*)&vtx->y2d[i], _mm_blendv_epi8(behind_2d, y2d, front));
+    }
+    if (i < end) behind += transformVertices_scalar64(vtx, t, i, end);  // Last 1..3 vertices
+    return behind;
+}
+#endif
+
+// Runs one kernel over the vertices [first, end)
+static long transformKernelRun(int kernel, VertexArrays3D* vtx, const ViewTrig* t, int first, int end) {
+#if GS3D_SIMD
+    if (kernel == KERNEL_SSE41) return transformVertices_sse41(vtx, t, first, end);
+#endif
+    if (kernel == KERNEL_SPLIT32) return transformVertices_split32(vtx, t, first, end);
+    return transformVertices_scalar64(vtx, t, first, end);
+}
+
+#if GS3D_THREADS
+// Vertex stage on the pool: one kernel call per chunk of vertices
+typedef struct {
+    VertexArrays3D* vtx;
+    ViewTrig trig;
+    int chunk_items;
+    long behind[POOL_MAX_CHUNKS];
+} TransformJob;
+
+static void transformTask(void* arg, int chunk) {
+    TransformJob* job = (TransformJob*)arg;
+    int first = chunk * job->chunk_items;
+    int end = (job->vtx->vertex_count - first > job->chunk_items) ?
+              first + job->chunk_items : job->vtx->vertex_count;
+    
+    job->behind[chunk] = transformKernelRun(transform_kernel, job->vtx, &job->trig, first, end);
+}
+#endif
+
+void transformVertices(Model3D* model, ObserverParams* params) {
+    ViewTrig trig;
+    VertexArrays3D* vtx = &model->vertices;
+    long behind = 0;
+    
+    computeViewTrig(params, &trig);
+    // Observer in object space (clusters, octree, outlines): the point where xo = yo = zo = 0
+    model->eye_x = FIXED_MUL_64(trig.distance, trig.cos_h_cos_v);
+    model->eye_y = FIXED_MUL_64(trig.distance, trig.sin_h_cos_v);
+    model->eye_z = FIXED_MUL_64(trig.distance, trig.sin_v);
+#if GS3D_THREADS
+    if (pool_threads > 1 && vtx->vertex_count >= POOL_MIN_ITEMS) {
+        static TransformJob job;
+        int chunks, c;
+        job.vtx = vtx;
+        job.trig = trig;
+        chunks = poolChunks(vtx->vertex_count, &job.chunk_items);
+        poolRun(transformTask, &job, chunks);
+        for (c = 0; c < chunks; c++) behind += job.behind[c];
+    } else
+#endif
+    behind = transformKernelRun(transform_kernel, vtx, &trig, 0, vtx->vertex_count);
+    STATS_ADD(STAT_VERTS_TRANSFORMED, vtx->vertex_count);
+    STATS_ADD(STAT_VERTS_BEHIND, behind);
+}
+
+/**
+ * TRANSFORM KERNEL SELF-CHECK
+ * ===========================
+ * 
+ * The split and SSE4.1 kernels must produce the same bits as the
+ * reference, or the view cache, traces and culling would depend on the
+ * kernel. Checked once per loaded model, on the real vertices and the
+ * current view:
+ *   1. FIXED_MUL_32 against FIXED_MUL_64 on sign and carry edge cases
+ *   2. Each kernel over the model, output arrays compared with memcmp
+ *      against a copy of the reference output
+ */
+static void transformKernelSave(VertexArrays3D* vtx, char* ref) {
+    size_t fixed_bytes = (size_t)vtx->vertex_count * sizeof(Fixed32);
+    size_t int_bytes = (size_t)vtx->vertex_count * sizeof(int);
+    memcpy(ref, vtx->xo, fixed_bytes);
+    memcpy(ref + fixed_bytes, vtx->yo, fixed_bytes);
+    memcpy(ref + 2 * fixed_bytes, vtx->zo, fixed_bytes);
+    memcpy(ref + 3 * fixed_bytes, vtx->x2d, int_bytes);
+    memcpy(ref + 3 * fixed_bytes + int_bytes, vtx->y2d, int_bytes);
+}
+
+// Runs 'kernel' and compares its output with the saved reference: 1 = same bits
+static int transformKernelMatches(int kernel, VertexArrays3D* vtx, const ViewTrig* t,
+                                  const char* ref, long ref_behind) {
+    size_t fixed_bytes = (size_t)vtx->vertex_count * sizeof(Fixed32);
+    size_t int_bytes = (size_t)vtx->vertex_count * sizeof(int);
+    long behind = transformKernelRun(kernel, vtx, t, 0, vtx->vertex_count);
+    return behind == ref_behind &&
+           memcmp(ref, vtx->xo, fixed_bytes) == 0 &&
+           memcmp(ref + fixed_bytes, vtx->yo, fixed_bytes) == 0 &&
+           memcmp(ref + 2 * fixed_bytes, vtx->zo, fixed_bytes) == 0 &&
+           memcmp(ref + 3 * fixed_bytes, vtx->x2d, int_bytes) == 0 &&
+           memcmp(ref + 3 * fixed_bytes + int_bytes, vtx->y2d, int_bytes) == 0;
+}
+
+int transformKernelSelfCheck(Model3D* model, ObserverParams* params) {
+    static const Fixed32 edge[] = {
+        0L, 1L, -1L, 0xFFFFL, -0xFFFFL, 0x8000L, -0x8000L, 0x10000L, -0x10000L,
+        0x12345L, -0x12345L, 0x7FFF0000L, 0x7FFFFFFFL, -0x7FFFFFFFL, 0x00FF00FFL
+    };
+    VertexArrays3D* vtx = &model->vertices;
+    size_t nv = (size_t)vtx->vertex_count;
+    ViewTrig trig;
+    char *ref;
+    long behind;
+    int i, j, ok = 1, simd_ok = 1;
+    
+    for (i = 0; i < (int)(sizeof(edge) / sizeof(edge[0])); i++) {
+        for (j = 0; j < (int)(sizeof(edge) / sizeof(edge[0])); j++) {
+            if (FIXED_MUL_32(edge[i], edge[j]) != FIXED_MUL_64(edge[i], edge[j])) ok = 0;
+        }
+    }
+    
+    transform_kernel_simd = 0;
+    if (ok && nv > 0) {
+        ref = (char*)malloc(nv * (3 * sizeof(Fixed32) + 2 * sizeof(int)));
+        if (ref == NULL) return -1;
+        computeViewTrig(params, &trig);
+        behind = transformVertices_scalar64(vtx, &trig, 0, vtx->vertex_count);
+        transformKernelSave(vtx, ref);
+        ok = transformKernelMatches(KERNEL_SPLIT32, vtx, &trig, ref, behind);
+#if GS3D_SIMD
+        if (cpuHasSse41()) {
+            transform_kernel_simd = transformKernelMatches(KERNEL_SSE41, vtx, &trig, ref, behind);
+            simd_ok = transform_kernel_simd;
+        }
+#endif
+        free(ref);
+    }
+    
+    transform_kernel_checked = ok;
+    transform_kernel = transform_kernel_simd ? KERNEL_SSE41 : ok ? KERNEL_SPLIT32 : KERNEL_SCALAR64;
+    return ok && simd_ok;
+}
+
+#ifdef __ORCAC__
+segment "GS3DBENCH";   // Load segment: benchmark and checks
+#endif
+
+/**
+ * TRANSFORM KERNEL TEST ('U' key, runs headless)
+ * ==============================================
+ * 
+ * The self-check above only sees the loaded model from one view. This
+ * test owns its vertices: KERNEL_TEST_VERTICES of them, the edge values
+ * of the self-check on each axis followed by pseudo-random coordinates
+ * up to +-256, so views at the short distances put some of them behind
+ * the observer. Every h, v and w angle in KERNEL_TEST_STEP degrees at
+ * four distances is transformed by the reference, then by each other
+ * kernel (KERNEL_SSE41 only if cpuid reports SSE4.1), and the outputs
+ * and behind counts are compared bit for bit. Returns the number of
+ * views where a kernel differs.
+ */
+int runTransformKernelTest(void) {
+    static const Fixed32 edge[] = {
+        0L, 1L, -1L, 0xFFFFL, -0xFFFFL, 0x8000L, -0x8000L, 0x10000L, -0x10000L,
+        0x12345L, -0x12345L, 0x7FFF0000L, 0x7FFFFFFFL, -0x7FFFFFFFL, 0x00FF00FFL
+    };
+    static const Fixed32 distances[] = { 0x10000L, 0x50000L, 0x1E0000L, 0x1F40000L };
+    VertexArrays3D vtx;
+    ObserverParams view;
+    ViewTrig trig;
+    Fixed32 *block;
+    char *ref;
+    unsigned long seed = 12345UL;
+    long views = 0, behind, behind_total = 0;
+    int n = KERNEL_TEST_VERTICES;
+    int i, h, v, w, d, edges = (int)(sizeof(edge) / sizeof(edge[0]));
+    int split_failed = 0, simd = 0, simd_failed = 0;
+    
+    block = (Fixed32*)malloc((size_t)n * (6 * sizeof(Fixed32) + 2 * sizeof(int)));
+    ref = (char*)malloc((size_t)n * (3 * sizeof(Fixed32) + 2 * sizeof(int)));
+    if (block == NULL || ref == NULL) {
+        free(block);
+        free(ref);
+        printf("Transform kernel test: not enough memory\n");
+        return -1;
+    }
+    vtx.x = block;          vtx.y = vtx.x + n;      vtx.z = vtx.y + n;
+    vtx.xo = vtx.z + n;     vtx.yo = vtx.xo + n;    vtx.zo = vtx.yo + n;
+    vtx.x2d = (int*)(vtx.zo + n);
+    vtx.y2d = vtx.x2d + n;
+    vtx.vertex_count = n;
+    for (i = 0; i < n; i++) {
+        if (i < 3 * edges) {
+            // One axis at an edge value, the other two at zero
+            vtx.x[i] = (i / edges == 0) ? edge[i % edges] : 0;
+            vtx.y[i] = (i / edges == 1) ? edge[i % edges] : 0;
+            vtx.z[i] = (i / edges == 2) ? edge[i % edges] : 0;
+        } else {
+            seed = seed * 1103515245UL + 12345UL;
+            vtx.x[i] = (Fixed32)((seed >> 8) & 0x1FFFFFFUL) - 0x1000000L;
+            seed = seed * 1103515245UL + 12345UL;
+            vtx.y[i] = (Fixed32)((seed >> 8) & 0x1FFFFFFUL) - 0x1000000L;
+            seed = seed * 1103515245UL + 12345UL;
+            vtx.z[i] = (Fixed32)((seed >> 8) & 0x1FFFFFFUL) - 0x1000000L;
+        }
+    }
+#if GS3D_SIMD
+    simd = cpuHasSse41();
+#endif
+    
+    for (d = 0; d < (int)(sizeof(distances) / sizeof(distances[0])); d++) {
+        for (h = 0; h < 360; h += KERNEL_TEST_STEP) {
+            for (v = 0; v < 360; v += KERNEL_TEST_STEP) {
+                for (w = 0; w < 360; w += KERNEL_TEST_STEP) {
+                    view.angle_h = INT_TO_FIXED(h);
+                    view.angle_v = INT_TO_FIXED(v);
+                    view.angle_w = INT_TO_FIXED(w);
+                    view.distance = distances[d];
+                    computeViewTrig(&view, &trig);
+                    behind = transformVertices_scalar64(&vtx, &trig, 0, n);
+                    behind_total += behind;
+                    transformKernelSave(&vtx, ref);
+                    if (!transformKernelMatches(KERNEL_SPLIT32, &vtx, &trig, ref, behind)) split_failed++;
+                    if (simd && !transformKernelMatches(KERNEL_SSE41, &vtx, &trig, ref, behind)) simd_failed++;
+                    views++;
+                }
+            }
+        }
+    }
+    free(block);
+    free(ref);
+    
+    printf("%ld views x %d vertices (%ld behind the observer)\n", views, n, behind_total);
+    printf("32-bit split: %s (%d views differ)\n", split_failed ? "FAILED" : "passed", split_failed);
+    if (simd) {
+        printf("SSE4.1      : %s (%d views differ)\n", simd_failed ? "FAILED" : "passed", simd_failed);
+    } else {
+        printf("SSE4.1      : not available (GS3D_SIMD = %d)\n", GS3D_SIMD);
+    }
+    printf("Transform kernel test: %s\n", (split_failed || simd_failed) ? "FAILED" : "passed");
+    return split_failed + simd_failed;
+}
+
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
+void processModelFast(Model3D* model, ObserverParams* params, const char* filename) {
+#if ENABLE_STATS
+    statsBeginFrame();
+#endif
+    
+    // Performance measurement
+    long start_transform_ticks = GetTick();
+    transformVertices(model, params);
+    long end_transform_ticks = GetTick();
+    STATS_ADD(STAT_TICKS_TRANSFORM, end_transform_ticks - start_transform_ticks);
+    STATS_ADD(STAT_LOD_LEVEL, model->lod_active);
+    STATS_ADD(STAT_TRIANGLES, model->faces.triangle_count);
+    shadeSetView(params);
+    if (outline_mode == OUTLINE_FEATURE) outlineSetView(model);
+    
+    // Set again by octreeCollect when the frame walks the octree
+    frame_octree_nodes = 0;
+    frame_octree_outside = 0;
+    frame_octree_listed = OCTREE_NOT_WALKED;
+    
+    // Convex model: culling alone, no depths and no sort
+    if (convexFastPath(model)) {
+        long start_cull_ticks = GetTick();
+        cullFacesConvex(model);
+        STATS_ADD(STAT_TICKS_DEPTH, GetTick() - start_cull_ticks);
+        convex_frames++;
+#if !PERFORMANCE_MODE
+        printf("Transform+Project: %ld ticks, convex culling: %ld ticks (no sort)\n",
+               end_transform_ticks - start_transform_ticks, GetTick() - start_cull_ticks);
+        printf("\nHit a key to continue...\n");
+        keypress();
+#endif
+        return;
+    }
+    
+    // Cached view: face order already known, skip depths and sort
+    if (view_cache_mode != VIEW_CACHE_OFF && viewCacheLookup(model, params)) {
+#if !PERFORMANCE_MODE
+        printf("Transform+Project: %ld ticks (view cache hit)\n",
+               end_transform_ticks - start_transform_ticks);
+        printf("\nHit a key to continue...\n");
+        keypress();
+#endif
+        return;
+    }
+    
+    // Face sorting after transformation
+    long start_calc_ticks = GetTick();
+    int listed = calculateViewDepths(model, params);
+    long end_calc_ticks = GetTick();
+    
+    // Z-buffer mode resolves visibility per pixel, wireframe needs none: no sort,
+    // unless the frame falls back to the painter (640 mode, buffers, no edges)
+    int sorted = !zbufferReady(model) &&
+                 !(render_mode == RENDER_WIREFRAME && model->edges.edge_count > 0);
+    long start_sort_ticks = GetTick();
+    if (sorted) sortFacesByDepth(model, listed);
+    long end_sort_ticks = GetTick();
+    model->faces.draw_count = listed;
+    STATS_ADD(STAT_TICKS_DEPTH, end_calc_ticks - start_calc_ticks);
+    STATS_ADD(STAT_TICKS_SORT, end_sort_ticks - start_sort_ticks);
+    if (sorted) STATS_ADD(STAT_FACES_SORTED, listed);
+    
+    if (view_cache_mode != VIEW_CACHE_OFF && sorted) {
+        viewCacheStore(model, params, 1);
+    }
+    
+#if !PERFORMANCE_MODE
+    printf("Transform+Project: %ld ticks (%.2f ms)\n", 
+           end_transform_ticks - start_transform_ticks, 
+           (end_transform_ticks - start_transform_ticks) * 1000.0 / 60.0);
+    printf("calculateFaceDepths: %ld ticks (%.2f ms)\n", 
+           end_calc_ticks - start_calc_ticks, 
+           (end_calc_ticks - start_calc_ticks) * 1000.0 / 60.0);
+    printf("sortFacesByDepth: %ld ticks (%.2f ms)\n", 
+           end_sort_ticks - start_sort_ticks,
+           (end_sort_ticks - start_sort_ticks) * 1000.0 / 60.0);
+    printf("Sub-pixel faces culled: %d\n", frame_culled_subpixel);
+    printf("Winding faces culled: %d\n", frame_culled_winding);
+    printf("\nHit a key to continue...\n");
+    keypress();
+#endif
+}
+
+// ============================================================================
+//                              VIEW CACHE
+// ============================================================================
+
+/**
+ * VIEW CACHE FOR THE INTERACTION GRID
+ * ===================================
+ * 
+ * Arrow keys move angle_h/angle_v by VIEW_CACHE_STEP degrees, so the views
+ * reachable from the keyboard form a small grid. For each view we keep
+ * the result of calculateFaceDepths + sortFacesByDepth, compressed to the
+ * visible faces only (culled faces are dropped from the list). A revisit
+ * then costs the vertex transform plus a copy, instead of depths + sort.
+ * 
+ * MEMORY:
+ *   At most VIEW_CACHE_SLOTS views and VIEW_CACHE_BUDGET bytes of face
+ *   orders. When full, the least recently used view is evicted.
+ * 
+ * VALIDITY:
+ *   Entries are keyed by (angle_h, angle_v, distance); angle_w only rotates
+ *   the image. Anything else that changes culling (model, thresholds,
+ *   cull_mode) calls viewCacheFlush().
+ */
+static ViewCacheEntry view_cache[VIEW_CACHE_SLOTS];
+
+static ViewCacheEntry* viewCacheFind(int h, int v, Fixed32 distance) {
+    int i;
+    for (i = 0; i < VIEW_CACHE_SLOTS; i++) {
+        ViewCacheEntry* e = &view_cache[i];
+        if (e->order != NULL && e->angle_h == h && e->angle_v == v && e->distance == distance) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void viewCacheEvict(ViewCacheEntry* e) {
+    if (e->order != NULL) {
+        view_cache_bytes -= (long)e->count * sizeof(int);
+        free(e->order);
+        e->order = NULL;
+        e->count = 0;
+    }
+}
+
+int viewCacheLookup(Model3D* model, ObserverParams* params) {
+    FaceArrays3D* faces = &model->faces;
+    int i;
+    ViewCacheEntry* e = viewCacheFind(normalizeDegrees(params->angle_h),
+                                      normalizeDegrees(params->angle_v), params->distance);
+    if (e == NULL) {
+        view_cache_misses++;
+        return 0;
+    }
+    view_cache_hits++;
+    e->last_used = ++view_cache_clock;
+    memcpy(faces->sorted_face_indices, e->order, (size_t)e->count * sizeof(int));
+    // List holds visible faces only: rebuild the bitset from it (wireframe edges read it)
+    memset(faces->display_flag, 0, FACE_FLAG_BYTES(faces->face_count));
+    for (i = 0; i < e->count; i++) {
+        FACE_SET_VISIBLE(faces->display_flag, e->order[i]);
+    }
+    faces->draw_count = e->count;
+    return 1;
+}
+
+int viewCacheStore(Model3D* model, ObserverParams* params, int allow_evict) {
+    FaceArrays3D* faces = &model->faces;
+    int h = normalizeDegrees(params->angle_h);
+    int v = normalizeDegrees(params->angle_v);
+    ViewCacheEntry* slot;
+    int i, count = 0;
+    long bytes;
+    
+    // Count visible faces in the sorted order
+    for (i = 0; i < faces->draw_count; i++) {
+        if (FACE_VISIBLE(faces->display_flag, faces->sorted_face_indices[i])) count++;
+    }
+    bytes = (long)count * sizeof(int);
+    if (bytes > VIEW_CACHE_BUDGET) return 0;
+    
+    // Replace an older entry for the same view (e.g. other distance)
+    for (i = 0; i < VIEW_CACHE_SLOTS; i++) {
+        if (view_cache[i].order != NULL && view_cache[i].angle_h == h && view_cache[i].angle_v == v) {
+            viewCacheEvict(&view_cache[i]);
+        }
+    }
+    
+    // Find a free slot within the budget, evicting LRU views if allowed
+    for (;;) {
+        ViewCacheEntry* lru = NULL;
+        slot = NULL;
+        for (i = 0; i < VIEW_CACHE_SLOTS; i++) {
+            if (view_cache[i].order == NULL) {
+                if (slot == NULL) slot = &view_cache[i];
+            } else if (lru == NULL || view_cache[i].last_used < lru->last_used) {
+                lru = &view_cache[i];
+            }
+        }
+        if (slot != NULL && view_cache_bytes + bytes <= VIEW_CACHE_BUDGET) break;
+        if (!allow_evict || lru == NULL) return 0;
+        viewCacheEvict(lru);
+    }
+    
+    slot->order = (int*)malloc(bytes > 0 ? bytes : 1);
+    if (slot->order == NULL) return 0;
+    count = 0;
+    for (i = 0; i < faces->draw_count; i++) {
+        int face_id = faces->sorted_face_indices[i];
+        if (FACE_VISIBLE(faces->display_flag, face_id)) slot->order[count++] = face_id;
+    }
+    slot->count = count;
+    slot->angle_h = h;
+    slot->angle_v = v;
+    slot->distance = params->distance;
+    slot->last_used = ++view_cache_clock;
+    view_cache_bytes += bytes;
+    return 1;
+}
+
+void viewCacheFlush(void) {
+    int i;
+    for (i = 0; i < VIEW_CACHE_SLOTS; i++) {
+        viewCacheEvict(&view_cache[i]);
+    }
+    view_cache_bytes = 0;
+}
+
+/**
+ * IDLE PRECOMPUTE
+ * ===============
+ * 
+ * Called from the key wait loop. Walks the grid around the current view
+ * ring by ring (nearest views first, up to VIEW_CACHE_RADIUS steps) and
+ * builds the first missing one. Stops once the budget is full instead of
+ * evicting views the user may come back to. Overwrites the vertex arrays
+ * (return 1 or -1): the caller must re-run processModelFast before drawing
+ * the current view.
+ */
+int viewCachePrecomputeStep(Model3D* model, ObserverParams* params) {
+    ObserverParams view = *params;
+    int ring, dh, dv, listed;
+    int saved_nodes = frame_octree_nodes, saved_listed = frame_octree_listed;
+    long saved_outside = frame_octree_outside;
+#if ENABLE_STATS
+    FrameStats saved_stats;
+#endif
+    
+    if (view_cache_bytes >= VIEW_CACHE_BUDGET) return 0;
+    if (convexFastPath(model)) return 0;  // Frames never read the cache
+    
+    for (ring = 1; ring <= VIEW_CACHE_RADIUS; ring++) {
+        for (dh = -ring; dh <= ring; dh++) {
+            for (dv = -ring; dv <= ring; dv++) {
+                if (dh != ring && dh != -ring && dv != ring && dv != -ring) continue;  // Ring border only
+                view.angle_h = params->angle_h + INT_TO_FIXED(dh * VIEW_CACHE_STEP);
+                view.angle_v = params->angle_v + INT_TO_FIXED(dv * VIEW_CACHE_STEP);
+                if (viewCacheFind(normalizeDegrees(view.angle_h), normalizeDegrees(view.angle_v),
+                                  view.distance) != NULL) continue;
+                
+#if ENABLE_STATS
+                saved_stats = stats_current;  // Background work is not part of the frame
+#endif
+                transformVertices(model, &view);
+                listed = calculateViewDepths(model, &view);  // Same octree path as live frames
+                sortFacesByDepth(model, listed);
+                model->faces.draw_count = listed;
+                frame_octree_nodes = saved_nodes;  // Info screen shows the displayed frame
+                frame_octree_outside = saved_outside;
+                frame_octree_listed = saved_listed;
+#if ENABLE_STATS
+                stats_current = saved_stats;
+#endif
+                return viewCacheStore(model, &view, 0) ? 1 : -1;
+            }
+        }
+    }
+    return 0;
+}
+
+#ifdef __ORCAC__
+segment "GS3DSTATS";   // Load segment: frame statistics and trace
+#endif
+
+#if ENABLE_STATS
+// ============================================================================
+//                           FRAME STATISTICS
+// ============================================================================
+
+/**
+ * FRAME STATISTICS RING BUFFER
+ * ============================
+ * 
+ * The last STATS_RING_FRAMES frames are kept in a fixed ring: no allocation,
+ * and recording a frame is one structure copy. Summaries sort a copy of
+ * one counter at a time (32 longs), so they cost nothing until asked for.
+ * 
+ * With ENABLE_STATS = 0 this section, the ring and every STATS_ADD vanish.
+ */
+static FrameStats stats_ring[STATS_RING_FRAMES];
+static int stats_ring_head = 0;      // Next slot to write
+static int stats_ring_filled = 0;    // Valid frames in the ring
+static long stats_frames_ended = 0;  // Frames pushed since start
+static long stats_frames_dropped = 0; // Aborted frames left out of the ring
+
+static const char* stat_names[STAT_COUNT] = {
+    "Vertices transformed",
+    "Vertices behind camera",
+    "Faces behind camera",
+    "Faces culled (winding)",
+    "Faces culled (sub-pixel)",
+    "Faces sorted",
+    "Faces drawn",
+    "Pixels filled (approx)",
+    "Ticks transform",
+    "Ticks depth+cull",
+    "Ticks sort",
+    "Ticks draw",
+    "Draw state changes",
+    "Pixels repainted",
+    "LOD level",
+    "Triangles",
+    "Clusters accepted",
+    "Clusters rejected",
+    "Clusters partial",
+    "Faces outside view (octree)",
+    "Octree nodes visited"
+};
+
+void statsBeginFrame(void) {
+    memset(&stats_current, 0, sizeof(stats_current));
+}
+
+void statsEndFrame(void) {
+    stats_ring[stats_ring_head] = stats_current;
+    stats_ring_head = (stats_ring_head + 1) % STATS_RING_FRAMES;
+    if (stats_ring_filled < STATS_RING_FRAMES) stats_ring_filled++;
+    stats_frames_ended++;
+    
+    // A redraw without reprocessing only adds draw counters
+    memset(&stats_current, 0, sizeof(stats_current));
+}
+
+void statsDropFrame(void) {
+    // Partial draw counters would pull min/avg down: the frame is not a sample
+    stats_frames_dropped++;
+    memset(&stats_current, 0, sizeof(stats_current));
+}
+
+void statsSummary(FILE* out) {
+    long sorted[STATS_RING_FRAMES];
+    int s, i, j, n = stats_ring_filled;
+    
+    fprintf(out, "Frame statistics (last %d frames, %ld aborted frames not recorded)\n",
+            n, stats_frames_dropped);
+    if (n == 0) return;
+    fprintf(out, "%-26s %8s %8s %8s\n", "Counter", "min", "avg", "p95");
+    for (s = 0; s < STAT_COUNT; s++) {
+        long total = 0;
+        // Insertion sort of one counter (n <= STATS_RING_FRAMES)
+        for (i = 0; i < n; i++) {
+            long v = stats_ring[i].value[s];
+            total += v;
+            for (j = i; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+            sorted[j] = v;
+        }
+        fprintf(out, "%-26s %8ld %8ld %8ld\n", stat_names[s],
+                sorted[0], total / n, sorted[(n * 95 + 99) / 100 - 1]);  // p95: nearest rank
+    }
+#if !STATS_FILL_AREA
+    fprintf(out, "Pixels filled: software rasterizer only (QuickDraw faces need STATS_FILL_AREA 1)\n");
+#endif
+    {
+        static const int thresholds[LOD_LEVELS - 1] = { LOD_THRESHOLDS };
+        fprintf(out, "LOD %s, projected radius %d px; level k below:", lod_mode ? "on" : "off", lod_radius_px);
+        for (s = 0; s < LOD_LEVELS - 1; s++) fprintf(out, " %d:%dpx", s + 1, thresholds[s]);
+        fprintf(out, "\n");
+    }
+}
+
+int statsDump(const char* filename) {
+    FILE* out = fopen(filename, "w");
+    int f, s;
+    
+    if (out == NULL) {
+        printf("Error: Unable to create stats file '%s'\n", filename);
+        return -1;
+    }
+    statsSummary(out);
+    fprintf(out, "\nFrames, oldest first:\n");
+    for (f = 0; f < stats_ring_filled; f++) {
+        FrameStats* fs = &stats_ring[(stats_ring_head - stats_ring_filled + f + STATS_RING_FRAMES) % STATS_RING_FRAMES];
+        for (s = 0; s < STAT_COUNT; s++) {
+            fprintf(out, "%ld%c", fs->value[s], (s == STAT_COUNT - 1) ? '\n' : ' ');
+        }
+    }
+    fclose(out);
+    return 0;
+}
+#endif
+
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
+// ============================================================================
+//                    BASIC FUNCTION IMPLEMENTATIONS
+// ============================================================================
+
+/**
+ * VERTEX READING FROM OBJ FILE
+ * ============================
+ * 
+ * This function parses an OBJ format file to extract
+ * vertices (3D points). It searches for lines starting with "v "
+ * and extracts X, Y, Z coordinates.
+ * 
+ * OBJ FORMAT FOR VERTICES:
+ *   v 1.234 5.678 9.012
+ *   v -2.5 0.0 3.14159
+ * 
+ * ALGORITHM:
+ * 1. Open file in read mode
+ * 2. Read line by line with fgets()
+ * 3. Detect "v " lines with character verification
+ * 4. Extract coordinates with sscanf()
+ * 5. Store in array with bounds checking
+ * 6. Progressive display for user feedback
+ * 
+ * ERROR HANDLING:
+ * - File opening verification
+ * - Array overflow protection
+ * - Coordinate format validation
+ */
+int readVertices(const char* filename, VertexArrays3D* vtx, int max_vertices) {
+    FILE *file;
+    char line[MAX_LINE_LENGTH];
+    int line_number = 1;
+    int vertex_count = 0;
+    
+    // Open file in read mode
+    file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("[DEBUG] readVertices: fopen failed\n");
+        printf("Error: Unable to open file '%s'\n", filename);
+        printf("Check that the file exists and you have read permissions.\n");
+        return -1;  // Return -1 on error
+    }
+    
+    printf("\nReading vertices from file...'%s':\n", filename);
+    
+    // Read file line by line
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // printf("%3d: %s", line_number, line);
+        if (line[0] == 'v' && line[1] == ' ') {
+            //printf("[DEBUG] readVertices: found vertex line %d\n", line_number);
+            if (vertex_count < max_vertices) {
+                float x, y, z;  // Temporary reading in float
+                if (sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3) {
+                    vtx->x[vertex_count] = FLOAT_TO_FIXED(x);
+                    vtx->y[vertex_count] = FLOAT_TO_FIXED(y);
+                    vtx->z[vertex_count] = FLOAT_TO_FIXED(z);
+                    vertex_count++;
+                    if (vertex_count % 10 == 0) printf("..");
+
+                } else {
+                    printf("[\nDEBUG] readVertices: sscanf failed at line %d: %s\n", line_number, line);
+                    keypress();
+                }
+            } else {
+                printf("\n[DEBUG] readVertices: vertex limit reached (%d)\n", max_vertices);
+                keypress();
+            }
+        }
+        line_number++;
+    }
+    printf("\n");
+    printf("Reading vertices finished : %d vertices read.\n", vertex_count);
+
+    // Close file
+    fclose(file);
+    
+    // printf("\n\nAnalyse terminee. %d lignes lues.\n", line_number - 1);
+    return vertex_count;  // Return the number of vertices read
+}
+
+/**
+ * OBJ PRE-SCAN: COUNT VERTICES, FACES AND INDICES
+ * ===============================================
+ * 
+ * Reads the file once, counting "v " lines, "f " lines and the vertex
+ * references on each face (capped at MAX_FACE_VERTICES per face, like
+ * readFaces_model). Much cheaper than the real parse: no number conversion,
+ * no validation. Face counts are upper bounds (degenerate faces are removed
+ * later). Faces that would overflow MAX_FACES or the IndexOffset-addressed index
+ * buffer are not counted, and readFaces_model stops at the same point.
+ */
+int scanObjCounts(const char* filename, int* vertex_count, int* face_count, long* index_count) {
+    FILE *file;
+    char line[MAX_LINE_LENGTH];
+    int nv = 0;
+    int nf = 0;
+    int index_full = 0;
+    long indices = 0;
+    
+    file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Error: Unable to open file '%s'\n", filename);
+        printf("Check that the file exists and you have read permissions.\n");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            if (nv < MAX_VERTICES) nv++;
+        } else if (line[0] == 'f' && line[1] == ' ' && nf < MAX_FACES && !index_full) {
+            char *ptr = line + 2;
+            int n = 0;
+            while (*ptr != '\0' && *ptr != '\n' && n < MAX_FACE_VERTICES) {
+                while (*ptr == ' ' || *ptr == '\t') ptr++;
+                if (*ptr == '\0' || *ptr == '\n' || *ptr == '\r') break;
+                n++;
+                while (*ptr != '\0' && *ptr != ' ' && *ptr != '\t' && *ptr != '\n') ptr++;
+            }
+            if (indices > MAX_TOTAL_INDICES - n) {
+                index_full = 1;  // Index buffer full: stop counting faces
+                continue;
+            }
+            indices += n;
+            nf++;
+        }
+    }
+    fclose(file);
+    
+    *vertex_count = nv;
+    *face_count = nf;
+    *index_count = indices;
+    return 0;
+}
+
+/**
+ * OBJ MATERIALS
+ * =============
+ * 
+ * readFaces_model tags each face with the index of its usemtl name (0 = no
+ * material yet). Once the faces are read, materialResolveColors turns the
+ * indices into palette colors: the Kd of the material in the mtllib file,
+ * matched to the nearest entry of the standard 320 palette, or else the
+ * next color of MATERIAL_COLORS. Black (background) and FRAME_COLOR are
+ * never chosen, so faces stay visible and framed. Names beyond
+ * MAX_MATERIALS fall back to material 0. 'g' lines only name groups and
+ * do not change the color. A relative mtllib name is looked up next to
+ * the OBJ file, not in the current directory.
+ */
+static char material_names[MAX_MATERIALS][MATERIAL_NAME_LEN];
+static Byte material_color[MAX_MATERIALS];
+static int material_count = 0;     // Entries used, including material 0
+static char material_lib[MAX_LINE_LENGTH];  // Path of the mtllib file
+
+static const Word palette320[16] = {
+    0x000, 0x777, 0x841, 0x72C, 0x00F, 0x080, 0xF70, 0xD00,
+    0xFA9, 0xFF0, 0x0E0, 0x4DF, 0xDAF, 0x78F, 0xCCC, 0xFFF
+};
+
+// 'name' relative to the directory of 'path' (GS/OS ':' or '/' separators)
+static void objSiblingPath(const char* path, const char* name, char* out, int out_len) {
+    int dir_len = 0, i;
+    if (name[0] != '/' && name[0] != ':') {
+        for (i = 0; path[i] != '\0'; i++) {
+            if (path[i] == '/' || path[i] == ':') dir_len = i + 1;
+        }
+    }
+    if (dir_len + (int)strlen(name) >= out_len) dir_len = 0;  // Too long: name alone
+    memcpy(out, path, (size_t)dir_len);
+    strncpy(out + dir_len, name, (size_t)(out_len - dir_len - 1));
+    out[out_len - 1] = '\0';
+}
+
+// Copies the argument of an OBJ/MTL keyword line, trimmed
+static void objLineArgument(const char* line, int keyword_len, char* out) {
+    const char *p = line + keyword_len;
+    int n = 0;
+    while (*p == ' ' || *p == '\t') p++;
+    while (*p != '\0' && *p != '\n' && *p != '\r' && n < MATERIAL_NAME_LEN - 1) {
+        out[n++] = *p++;
+    }
+    while (n > 0 && (out[n - 1] == ' ' || out[n - 1] == '\t')) n--;
+    out[n] = '\0';
+}
+
+static int materialIndex(const char* name) {
+    int i;
+    for (i = 1; i < material_count; i++) {
+        if (strcmp(material_names[i], name) == 0) return i;
+    }
+    if (material_count >= MAX_MATERIALS) return 0;
+    strcpy(material_names[material_count], name);
+    return material_count++;
+}
+
+static Byte nearestPaletteColor(float r, float g, float b) {
+    long best_d = 0x7FFFFFFFL;
+    Byte best = DEFAULT_FILL_COLOR;
+    int c;
+    for (c = 1; c < 16; c++) {
+        long dr, dg, db, d;
+        if (c == FRAME_COLOR) continue;
+        dr = (long)(r * 15.0 + 0.5) - ((palette320[c] >> 8) & 0xF);
+        dg = (long)(g * 15.0 + 0.5) - ((palette320[c] >> 4) & 0xF);
+        db = (long)(b * 15.0 + 0.5) - (palette320[c] & 0xF);
+        d = dr * dr + dg * dg + db * db;
+        if (d < best_d) { best_d = d; best = (Byte)c; }
+    }
+    return best;
+}
+
+static void materialResolveColors(void) {
+    static const Byte fallback[] = { MATERIAL_COLORS };
+    char line[MAX_LINE_LENGTH];
+    char name[MATERIAL_NAME_LEN];
+    Byte found[MAX_MATERIALS];
+    int current = -1;
+    int i, next = 1;
+    FILE *mtl;
+    
+    memset(found, 0, sizeof(found));
+    material_color[0] = DEFAULT_FILL_COLOR;
+    if (material_lib[0] != '\0' && (mtl = fopen(material_lib, "r")) != NULL) {
+        while (fgets(line, sizeof(line), mtl) != NULL) {
+            if (strncmp(line, "newmtl", 6) == 0) {
+                objLineArgument(line, 6, name);
+                current = -1;
+                for (i = 1; i < material_count; i++) {
+                    if (strcmp(material_names[i], name) == 0) current = i;
+                }
+            } else if (current > 0 && line[0] == 'K' && line[1] == 'd') {
+                float r = 0, g = 0, b = 0;
+                if (sscanf(line + 2, "%f %f %f", &r, &g, &b) == 3) {
+                    material_color[current] = nearestPaletteColor(r, g, b);
+                    found[current] = 1;
+                }
+            }
+        }
+        fclose(mtl);
+    }
+    for (i = 1; i < material_count; i++) {
+        if (!found[i]) {
+            material_color[i] = fallback[(next++ - 1) % (int)sizeof(fallback)];
+        }
+    }
+}
+
+// Function to read faces into parallel arrays in FaceArrays3D structure
+int readFaces_model(const char* filename, Model3D* model) {
+    FILE *file;
+    char line[MAX_LINE_LENGTH];
+    int line_number = 1;
+    int face_count = 0;
+    int max_faces;
+    int i;
+    
+    // Validate model structure (arrays carved by loadModel3D)
+    if (model == NULL || model->faces.vertex_count == NULL) {
+        printf("Error: Invalid model structure for readFaces_model\n");
+        return -1;
+    }
+    max_faces = model->faces.face_capacity;
+    model->faces.total_indices = 0;
+    model->faces.degenerate_removed = 0;
+    
+    // Open file in read mode
+    file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Error: Unable to open file '%s' to read faces\n", filename);
         return -1;
     }
     
     printf("\nReading faces from file '%s' :\n", filename);
     
-    int buffer_pos = 0;  // Current position in the packed buffer
+    IndexOffset buffer_pos = 0;  // Current position in the packed buffer
+    int current_material = 0;    // usemtl in effect (0 = none)
+    material_count = 1;
+    material_lib[0] = '\0';
+    
+    // Read file line by line
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Material groups: remember the library, tag the following faces
+        if (strncmp(line, "usemtl", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+            char name[MATERIAL_NAME_LEN];
+            objLineArgument(line, 6, name);
+            current_material = materialIndex(name);
+        } else if (strncmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+            char lib[MATERIAL_NAME_LEN];
+            objLineArgument(line, 6, lib);
+            objSiblingPath(filename, lib, material_lib, (int)sizeof(material_lib));
+        }
+        // Check if line starts with "f " (face)
+        else if (line[0] == 'f' && line[1] == ' ') {
+            if (face_count < max_faces) {
+                // Initialize face data
+                model->faces.vertex_count[face_count] = 0;
+                model->faces.vertex_indices_ptr[face_count] = buffer_pos;  // Store offset to this face's indices
+                
+                // Parse vertices from this face
+                char *ptr = line + 2;  // Start after "f "
+                int temp_indices[MAX_FACE_VERTICES];
+                int temp_vertex_count = 0;
+                int invalid_index_found = 0;
+                
+                // Parse character by character
+                while (*ptr != '\0' && *ptr != '\n' && temp_vertex_count < MAX_FACE_VERTICES) {
+                    // Skip spaces and tabs
+                    while (*ptr == ' ' || *ptr == '\t') ptr++;
+                    
+                    if (*ptr == '\0' || *ptr == '\n') break;
+                    
+                    // Read the number
+                    int vertex_index = 0;
+                    while (*ptr >= '0' && *ptr <= '9') {
+                        vertex_index = vertex_index * 10 + (*ptr - '0');
+                        ptr++;
+                    }
+                    
+                    // Skip texture/normal data (after /)
+                    while (*ptr != '\0' && *ptr != ' ' && *ptr != '\t' && *ptr != '\n') {
+                        ptr++;
+                    }
+                    
+                    // Validate vertex index
+                    if (vertex_index >= 1) {
+                        if (vertex_index > readVertices_last_count) {
+                            // Index out of bounds
+                            invalid_index_found = 1;
+                        }
+                        temp_indices[temp_vertex_count] = vertex_index;
+                        temp_vertex_count++;
+                    }
+                }
+                
+                // Check for errors
+                if (invalid_index_found) {
+                    printf("\nERROR: Face at line %d references vertex index > %d vertices\n", 
+                           line_number, readVertices_last_count);
+                    fclose(file);
+                    return -1;
+                }
+                
+                // Remove repeated consecutive indices (including last == first):
+                // such vertices add nothing to the outline but cost a point per frame.
+                // faceLevelRemap applies the same rule to the derived LOD levels.
+                int unique_count = 0;
+                for (i = 0; i < temp_vertex_count; i++) {
+                    if (unique_count == 0 || temp_indices[unique_count - 1] != temp_indices[i]) {
+                        temp_indices[unique_count++] = temp_indices[i];
+                    }
+                }
+                while (unique_count > 1 && temp_indices[unique_count - 1] == temp_indices[0]) {
+                    unique_count--;
+                }
+                
+                if (unique_count < 3) {
+                    // Point, line or fully collapsed polygon: never drawable, drop it once here
+                    model->faces.degenerate_removed++;
+                } else if ((long)buffer_pos + unique_count > model->faces.index_capacity) {
+                    printf("     -> WARNING: Index buffer full (%ld)\n", model->faces.index_capacity);
+                    break;  // Stop reading faces: nothing more fits
+                } else {
+                    temp_vertex_count = unique_count;
+                    // Store valid indices into the packed buffer
+                    for (i = 0; i < temp_vertex_count; i++) {
+                        model->faces.vertex_indices_buffer[buffer_pos++] = (VertexIndex)temp_indices[i];
+                    }
+                    model->faces.vertex_count[face_count] = (Byte)temp_vertex_count;
+                    model->faces.color[face_count] = (Byte)current_material;
+                    model->faces.total_indices += temp_vertex_count;
+                    
+                    face_count++;
+                    if (face_count % 10 == 0) {printf(".");}
+                }
+            } else {
+                printf("     -> WARNING: Face limit reached (%d)\n", max_faces);
+                break;  // Stop reading faces: nothing more fits
+            }
+        }
+        
+        line_number++;
+    }
+    
+    // Close file
+    fclose(file);
+    
+    model->faces.face_count = face_count;
+    
+    // Material indices -> palette colors
+    materialResolveColors();
+    for (i = 0; i < face_count; i++) {
+        model->faces.color[i] = material_color[model->faces.color[i]];
+    }
+    model->faces.material_count = material_count - 1;
+    
+    // Initialize sorted_face_indices with identity mapping (will be sorted later)
+    for (i = 0; i < face_count; i++) {
+        model->faces.sorted_face_indices[i] = i;
+    }
+    
+    printf("\nReading faces finished : %d faces read.\n", face_count);
+    if (model->faces.material_count > 0) {
+        printf("Materials : %d\n", model->faces.material_count);
+    }
+    if (model->faces.degenerate_removed > 0) {
+        printf("Degenerate faces removed : %d\n", model->faces.degenerate_removed);
+    }
+    return face_count;
+}
+void transformToObserver(VertexArrays3D* vtx, Fixed32 angle_h, Fixed32 angle_v, Fixed32 distance) {
+    int i;
+    Fixed32 rad_h, rad_v;
+    Fixed32 cos_h, sin_h, cos_v, sin_v;
+    Fixed32 x, y, z;
+    rad_h = FIXED_MUL_64(angle_h, FIXED_PI_180);
+    rad_v = FIXED_MUL_64(angle_v, FIXED_PI_180);
+    cos_h = cos_fixed(rad_h);
+    sin_h = sin_fixed(rad_h);
+    cos_v = cos_fixed(rad_v);
+    sin_v = sin_fixed(rad_v);
+    Fixed32 cos_h_cos_v = FIXED_MUL_64(cos_h, cos_v);
+    Fixed32 sin_h_cos_v = FIXED_MUL_64(sin_h, cos_v);
+    Fixed32 cos_h_sin_v = FIXED_MUL_64(cos_h, sin_v);
+    Fixed32 sin_h_sin_v = FIXED_MUL_64(sin_h, sin_v);
+#if !PERFORMANCE_MODE
+    printf("\nTransformation to observer system (Fixed Point):\n");
+    printf("Horizontal angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_h));
+    printf("Vertical angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_v));
+    printf("Distance: %.3f\n", FIXED_TO_FLOAT(distance));
+    printf("==========================================\n");
+#endif
+    for (i = 0; i < vtx->vertex_count; i++) {
+        x = vtx->x[i];
+        y = vtx->y[i];
+        z = vtx->z[i];
+        vtx->xo[i] = FIXED_ADD(
+            FIXED_MUL_64(x, cos_h_cos_v),
+            FIXED_MUL_64(y, sin_h_cos_v)
+        );
+        vtx->yo[i] = FIXED_ADD(
+            FIXED_SUB(
+                FIXED_MUL_64(-x, cos_h_sin_v),
+                FIXED_MUL_64(y, sin_h_sin_v)
+            ),
+            FIXED_MUL_64(z, cos_v)
+        );
+        vtx->zo[i] = FIXED_ADD(
+            FIXED_ADD(
+                FIXED_MUL_64(-x, sin_h),
+                FIXED_MUL_64(-y, cos_h)
+            ),
+            distance
+        );
+    }
+}
+
+// Function to project 3D coordinates onto 2D screen - FIXED POINT VERSION
+void projectTo2D(VertexArrays3D* vtx, Fixed32 angle_w) {
+    int i;
+    Fixed32 rad_w;
+    Fixed32 cos_w, sin_w;
+    Fixed32 x2d_temp, y2d_temp;
+    rad_w = FIXED_MUL_64(angle_w, FIXED_PI_180);
+    cos_w = cos_fixed(rad_w);
+    sin_w = sin_fixed(rad_w);
+    const Fixed32 scale = INT_TO_FIXED(100);
+    const Fixed32 centre_x_f = INT_TO_FIXED(CENTRE_X);
+    const Fixed32 centre_y_f = INT_TO_FIXED(CENTRE_Y);
+#if !PERFORMANCE_MODE
+    printf("\nProjection on 2D screen (Fixed Point):\n");
+    printf("Rotation angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_w));
+    printf("Screen center: (%d, %d)\n", CENTRE_X, CENTRE_Y);
+    printf("===========================\n");
+#endif
+    for (i = 0; i < vtx->vertex_count; i++) {
+        if (vtx->zo[i] > 0) {
+            Fixed32 xo = vtx->xo[i];
+            Fixed32 yo = vtx->yo[i];
+            Fixed32 inv_zo = FIXED_DIV_64(scale, vtx->zo[i]);
+            x2d_temp = FIXED_ADD(FIXED_MUL_64(xo, inv_zo), centre_x_f);
+            y2d_temp = FIXED_SUB(centre_y_f, FIXED_MUL_64(yo, inv_zo));
+            vtx->x2d[i] = FIXED_TO_INT(FIXED_ADD(FIXED_SUB(FIXED_MUL_64(cos_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(sin_w, FIXED_SUB(centre_y_f, y2d_temp))), centre_x_f));
+            vtx->y2d[i] = FIXED_TO_INT(FIXED_SUB(centre_y_f, FIXED_ADD(FIXED_MUL_64(sin_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(cos_w, FIXED_SUB(centre_y_f, y2d_temp)))));
+        } else {
+            vtx->x2d[i] = -1;
+            vtx->y2d[i] = -1;
+        }
+    }
+}
+
+/**
+ * CALCULATING MINIMUM FACE DEPTHS AND VISIBILITY FLAGS
+ * =====================================================
+ * 
+ * This function calculates for each face:
+ * 1. The minimum depth (z_min) of all its vertices in the observer coordinate system
+ * 2. The display visibility flag based on vertex positions relative to camera
+ * 
+ * The z_min value is used for face sorting during rendering (painter's algorithm).
+ * We use minimum (closest point) for correct occlusion in the painter's algorithm.
+ * The display_flag is used to cull faces that have vertices behind the camera.
+ * 
+ * PARAMETERS:
+ *   vertices   : Array of vertices with coordinates in observer system
+ *   faces      : Array of faces to process  
+ *   face_count : Number of faces
+ * 
+ * ALGORITHM:
+ *   For each face:
+ *   - Initialize z_min with very large value (9999.0)
+ *   - Initialize display_flag as true (displayable)
+ *   - For each vertex of the face:
+ *     * Check if vertex is behind camera (zo <= 0)
+ *     * If ANY vertex is behind camera, set display_flag = false
+ *     * Update z_min with minimum zo value found (closest vertex)
+ *   - Store both z_min and display_flag in the face structure
+ * 
+ * CULLING LOGIC:
+ *   - If ANY vertex has zo <= 0, the entire face is marked as non-displayable
+ *   - This prevents rendering artifacts from perspective projection errors
+ *   - Improves performance by eliminating faces early in the pipeline
+ *   - Sub-pixel culling: twice the signed area of the projected polygon
+ *     (shoelace formula on x2d/y2d, relative to the first vertex) is computed;
+ *     if |2 x area| < subpixel_area_min the face covers less than about one
+ *     pixel (or is an edge-on sliver) and is not drawn. Counted in
+ *     frame_culled_subpixel.
+ *   - Winding culling (model->cull_mode != CULL_NONE): the sign of the 2D
+ *     cross product of the first three projected vertices gives the face
+ *     orientation on screen. Faces with the rejected winding are flagged
+ *     before their depth is computed. Needs no precomputed normals, so it
+ *     works on any model loaded straight from OBJ. Counted in
+ *     frame_culled_winding.
+ *   - Face clusters (buildFaceClusters): one normal cone test per cluster
+ *     first. A cluster wholly of the culled winding is skipped without
+ *     touching its faces; one wholly of the kept winding skips the
+ *     per-face winding test. Counted in frame_clusters_*.
+ * 
+ * NOTES:
+ *   - Must be called AFTER transformToObserver() or processModelFast()
+ *   - Uses zo coordinates (observer system depth)
+ *   - Lower z_min value means face is closer to camera (should draw first in painter's algorithm)
+ *   - display_flag bit set means visible, clear means hidden (culled)
+ */
+static int faceWindingCulled(VertexArrays3D* vtx, VertexIndex* idx, int cull_mode) {
+    int v0 = idx[0] - 1, v1 = idx[1] - 1, v2 = idx[2] - 1;
+    long dx1, dy1, dx2, dy2;
+    int clockwise;  // Screen Y points down: cross > 0 is clockwise
+    
+    if (vtx->zo[v0] <= 0 || vtx->zo[v1] <= 0 || vtx->zo[v2] <= 0) return 0;
+    dx1 = (long)vtx->x2d[v1] - vtx->x2d[v0];
+    dy1 = (long)vtx->y2d[v1] - vtx->y2d[v0];
+    dx2 = (long)vtx->x2d[v2] - vtx->x2d[v0];
+    dy2 = (long)vtx->y2d[v2] - vtx->y2d[v0];
+    if (dx1 <= AREA_COORD_LIMIT && dx1 >= -AREA_COORD_LIMIT &&
+        dy1 <= AREA_COORD_LIMIT && dy1 >= -AREA_COORD_LIMIT &&
+        dx2 <= AREA_COORD_LIMIT && dx2 >= -AREA_COORD_LIMIT &&
+        dy2 <= AREA_COORD_LIMIT && dy2 >= -AREA_COORD_LIMIT) {
+        long cross = dx1 * dy2 - dx2 * dy1;
+        clockwise = (cross > 0) ? 1 : ((cross < 0) ? -1 : 0);
+    } else {
+        Fixed64 cross = (Fixed64)dx1 * dy2 - (Fixed64)dx2 * dy1;
+        clockwise = (cross > 0) ? 1 : ((cross < 0) ? -1 : 0);
+    }
+    return (cull_mode == CULL_BACK && clockwise > 0) || (cull_mode == CULL_FRONT && clockwise < 0);
+}
+
+// Normal cone test (see FACE CLUSTERS): 1 = every face turned away from the
+// observer, -1 = every face turned toward it, 0 = mixed or unknown
+static int clusterFacing(Model3D* model, FaceCluster* cl) {
+    long dx, dy, dz, dot, lhs;
+    Fixed64 d2, k2;
+    
+    if (cl->spread < 0) return 0;
+    // Observer -> centre, in 1/256 units so the squares fit 64 bits
+    dx = (cl->cx - model->eye_x) >> 8;
+    dy = (cl->cy - model->eye_y) >> 8;
+    dz = (cl->cz - model->eye_z) >> 8;
+    dot = FIXED_MUL_64(cl->ax, dx) + FIXED_MUL_64(cl->ay, dy) + FIXED_MUL_64(cl->az, dz);
+    lhs = (dot < 0 ? -dot : dot) - (cl->radius >> 8);
+    if (lhs <= 0) return 0;
+    d2 = (Fixed64)dx * dx + (Fixed64)dy * dy + (Fixed64)dz * dz;
+    k2 = ((Fixed64)cl->spread * cl->spread) >> FIXED_SHIFT;
+    if ((Fixed64)lhs * lhs <= ((k2 * d2) >> FIXED_SHIFT)) return 0;
+    return dot > 0 ? 1 : -1;
+}
+
+// Sub-pixel / sliver test of a face whose vertices are all projected:
+// 1 if |2 x area| < subpixel_area_min (the caller counts it)
+static int faceSubpixelCulled(VertexArrays3D* vtx, VertexIndex* idx, int n) {
+    int j;
+    int x0 = vtx->x2d[idx[0] - 1];
+    int y0 = vtx->y2d[idx[0] - 1];
+    long area2 = 0;
+    long dx_prev = (long)vtx->x2d[idx[1] - 1] - x0;  // Widen first: 16-bit int
+    long dy_prev = (long)vtx->y2d[idx[1] - 1] - y0;
+    
+    if (dx_prev > AREA_COORD_LIMIT || dx_prev < -AREA_COORD_LIMIT ||
+        dy_prev > AREA_COORD_LIMIT || dy_prev < -AREA_COORD_LIMIT) return 0;
+    for (j = 2; j < n; j++) {
+        long dx = (long)vtx->x2d[idx[j] - 1] - x0;
+        long dy = (long)vtx->y2d[idx[j] - 1] - y0;
+        if (dx > AREA_COORD_LIMIT || dx < -AREA_COORD_LIMIT ||
+            dy > AREA_COORD_LIMIT || dy < -AREA_COORD_LIMIT) {
+            return 0;  // Face spans a large part of the screen: keep it
+        }
+        area2 += dx_prev * dy - dx * dy_prev;
+        dx_prev = dx;
+        dy_prev = dy;
+    }
+    return (area2 < subpixel_area_min && area2 > -subpixel_area_min);
+}
+
+// Winding, behind-camera and sub-pixel tests plus z_max for one face
+// (cull_mode CULL_NONE skips the winding test). Returns FACE_SHOWN or the
+// FACE_CULLED_* reason: the caller sets the display bit and counts, so
+// faces of different chunks share no state (HOST THREAD POOL)
+static int faceDepth(VertexArrays3D* vtx, FaceArrays3D* fa, int i, int cull_mode) {
+    int j;
+    Fixed32 z_min = FLOAT_TO_FIXED(9999.0);  // Initialize to very large value
+    int display_flag = 1;
+    
+    // Access indices from the packed buffer using the offset
+    IndexOffset offset = fa->vertex_indices_ptr[i];
+    
+    // Winding test first: a rejected face needs no depth at all
+    if (cull_mode != CULL_NONE &&
+        faceWindingCulled(vtx, &fa->vertex_indices_buffer[offset], cull_mode)) {
+        fa->z_max[i] = z_min;
+        return FACE_CULLED_WINDING;
+    }
+    
+    for (j = 0; j < fa->vertex_count[i]; j++) {
+        int vertex_idx = fa->vertex_indices_buffer[offset + j] - 1;
+        if (vertex_idx >= 0) {
+            if (vtx->zo[vertex_idx] <= 0) display_flag = 0;
+            if (vtx->zo[vertex_idx] < z_min) z_min = vtx->zo[vertex_idx];  // Find minimum (closest)
+        }
+    }
+    fa->z_max[i] = z_min;  // Store minimum depth for sorting
+    if (!display_flag) return FACE_CULLED_BEHIND;
+    
+    // Sub-pixel / sliver test (only meaningful when all vertices are projected)
+    if (subpixel_area_min > 0 &&
+        faceSubpixelCulled(vtx, &fa->vertex_indices_buffer[offset], fa->vertex_count[i])) {
+        return FACE_CULLED_SUBPIXEL;
+    }
+    return FACE_SHOWN;
+}
+
+// Counters of a depth pass, or of one chunk of it
+typedef struct {
+    long faces[FACE_RESULTS];        // Per faceDepth result (whole rejected clusters in FACE_CULLED_WINDING)
+    int clusters_accepted, clusters_rejected, clusters_partial;
+} DepthCounts;
+
+// Depth pass over the faces [first, end), cluster by cluster (clusters NULL:
+// one run). A cluster reaching into the range from before 'first' is tested
+// again but counted by the range holding its first face.
+static void depthFaceRange(Model3D* model, FaceCluster* clusters, int cluster_count,
+                           int first, int end, DepthCounts* dc) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* fa = &model->faces;
+    int cull_mode = model->cull_mode;
+    int c, i, lo, hi;
+    
+    if (clusters == NULL) {
+        for (i = first; i < end; i++) {
+            int r = faceDepth(vtx, fa, i, cull_mode);
+            if (r == FACE_SHOWN) FACE_SET_VISIBLE(fa->display_flag, i);
+            else dc->faces[r]++;
+        }
+        return;
+    }
+    
+    // Last cluster starting at or before 'first' (clusters are in face order)
+    lo = 0;
+    hi = cluster_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (clusters[mid].first <= first) lo = mid;
+        else hi = mid - 1;
+    }
+    for (c = lo; c < cluster_count && clusters[c].first < end; c++) {
+        int test_winding = (cull_mode != CULL_NONE);
+        int from = (clusters[c].first > first) ? clusters[c].first : first;
+        int to = clusters[c].first + clusters[c].count;
+        int counted = (clusters[c].first >= first);
+        if (to > end) to = end;
+        if (from >= to) continue;
+        if (test_winding) {
+            int facing = clusterFacing(model, &clusters[c]);
+            if (facing == 0) {
+                if (counted) dc->clusters_partial++;
+            } else if ((facing > 0) == (cull_mode == CULL_BACK)) {
+                // The whole run has the culled winding: bits stay clear, z_max unused
+                dc->faces[FACE_CULLED_WINDING] += to - from;
+                if (counted) dc->clusters_rejected++;
+                continue;
+            } else {
+                test_winding = 0;  // The whole run has the kept winding
+                if (counted) dc->clusters_accepted++;
+            }
+        }
+        for (i = from; i < to; i++) {
+            int r = faceDepth(vtx, fa, i, test_winding ? cull_mode : CULL_NONE);
+            if (r == FACE_SHOWN) FACE_SET_VISIBLE(fa->display_flag, i);
+            else dc->faces[r]++;
+        }
+    }
+}
+
+// Last frame counters and frame statistics from a depth pass
+static void depthPublish(DepthCounts* dc) {
+    frame_culled_winding = (int)dc->faces[FACE_CULLED_WINDING];
+    frame_culled_subpixel = (int)dc->faces[FACE_CULLED_SUBPIXEL];
+    frame_clusters_accepted = dc->clusters_accepted;
+    frame_clusters_rejected = dc->clusters_rejected;
+    frame_clusters_partial = dc->clusters_partial;
+    STATS_ADD(STAT_FACES_BEHIND, dc->faces[FACE_CULLED_BEHIND]);
+    STATS_ADD(STAT_FACES_WINDING, frame_culled_winding);
+    STATS_ADD(STAT_FACES_SUBPIXEL, frame_culled_subpixel);
+    STATS_ADD(STAT_CLUSTERS_ACCEPTED, frame_clusters_accepted);
+    STATS_ADD(STAT_CLUSTERS_REJECTED, frame_clusters_rejected);
+    STATS_ADD(STAT_CLUSTERS_PARTIAL, frame_clusters_partial);
+}
+
+#if GS3D_THREADS
+// Depth pass on the pool: faces (calculateFaceDepths) or octree list
+// positions (calculateFaceDepthsList) in chunks, counters kept per chunk
+typedef struct {
+    Model3D* model;
+    FaceCluster* clusters;
+    int cluster_count;
+    int count, chunk_items;
+    DepthCounts counts[POOL_MAX_CHUNKS];
+} DepthJob;
+
+static void depthTask(void* arg, int chunk) {
+    DepthJob* job = (DepthJob*)arg;
+    int first = chunk * job->chunk_items;
+    int end = (job->count - first > job->chunk_items) ? first + job->chunk_items : job->count;
+    
+    memset(&job->counts[chunk], 0, sizeof(DepthCounts));
+    depthFaceRange(job->model, job->clusters, job->cluster_count, first, end, &job->counts[chunk]);
+}
+
+static void depthRunPool(DepthJob* job, void (*task)(void* arg, int chunk), DepthCounts* dc) {
+    int chunks = poolChunks(job->count, &job->chunk_items);
+    int c, r;
+    
+    poolRun(task, job, chunks);
+    for (c = 0; c < chunks; c++) {
+        for (r = 0; r < FACE_RESULTS; r++) dc->faces[r] += job->counts[c].faces[r];
+        dc->clusters_accepted += job->counts[c].clusters_accepted;
+        dc->clusters_rejected += job->counts[c].clusters_rejected;
+        dc->clusters_partial += job->counts[c].clusters_partial;
+    }
+}
+#endif
+
+void calculateFaceDepths(Model3D* model, Face3D* faces, int face_count) {
+    FaceArrays3D* face_arrays = &model->faces;
+    FaceCluster* clusters = face_arrays->clusters;
+    DepthCounts dc;
+    
+    memset(&dc, 0, sizeof(dc));
+    
+    // All faces hidden; visible ones get their bit set below
+    memset(face_arrays->display_flag, 0, FACE_FLAG_BYTES(face_count));
+    
+    // Without clusters (small model, derived level) the faces form one run
+    if (face_count != face_arrays->face_count) clusters = NULL;
+    
+#if GS3D_THREADS
+    if (pool_threads > 1 && face_count >= POOL_MIN_ITEMS) {
+        static DepthJob job;
+        job.model = model;
+        job.clusters = clusters;
+        job.cluster_count = face_arrays->cluster_count;
+        job.count = face_count;
+        depthRunPool(&job, depthTask, &dc);
+    } else
+#endif
+    depthFaceRange(model, clusters, face_arrays->cluster_count, 0, face_count, &dc);
+    depthPublish(&dc);
+}
+
+#ifdef __ORCAC__
+segment "GS3DLOD";     // Load segment: levels of detail, clusters, octree
+#endif
+
+/**
+ * OCTREE TRAVERSAL (VIEW FRUSTUM)
+ * ===============================
+ * 
+ * Walks the octree of the loaded faces (buildOctree) and lists the faces
+ * of the nodes that may reach the screen in sorted_face_indices, nearest
+ * nodes first. Each node is tested as the bounding sphere of its cube
+ * against the view pyramid |xo|, |yo| <= OCTREE_VIEW_SLOPE * zo (the
+ * screen half-diagonal, so any angle_w is covered) and the plane zo = 0:
+ *   - wholly outside one plane: subtree skipped, its faces stay hidden
+ *   - wholly inside every plane: subtree listed without further tests
+ * Children are visited in octant order XOR the octant of the observer,
+ * which is front to back for the 8 cubes of a split.
+ * 
+ * RETURN:
+ *   Faces listed, or -1 when the whole model is in view (or there is no
+ *   octree): the caller then runs calculateFaceDepths on every face,
+ *   with its cluster culling
+ */
+static int octreeClassify(const ViewTrig* t, OctreeNode* n) {
+    Fixed32 zo = FIXED_SUB(t->distance, FIXED_MUL_64(n->cx, t->cos_h_cos_v) +
+                           FIXED_MUL_64(n->cy, t->sin_h_cos_v) + FIXED_MUL_64(n->cz, t->sin_v));
+    Fixed32 xo = FIXED_SUB(FIXED_MUL_64(n->cy, t->cos_h), FIXED_MUL_64(n->cx, t->sin_h));
+    Fixed32 yo = FIXED_MUL_64(n->cz, t->cos_v) - FIXED_MUL_64(n->cx, t->cos_h_sin_v) -
+                 FIXED_MUL_64(n->cy, t->sin_h_sin_v);
+    Fixed32 r = FIXED_MUL_64(n->half, FLOAT_TO_FIXED(OCTREE_SQRT3)) + 2;
+    // Side planes in eighths: zo * OCTREE_VIEW_SLOPE leaves the Fixed32 range
+    // past zo = 17300 (+ 2 covers the truncation of the shifts)
+    Fixed32 margin = FIXED_MUL_64(r >> 3, FLOAT_TO_FIXED(OCTREE_PLANE_NORM)) + 2;
+    Fixed32 edge = FIXED_MUL_64(zo >> 3, FLOAT_TO_FIXED(OCTREE_VIEW_SLOPE));
+    
+    xo >>= 3;
+    yo >>= 3;
+    if (zo + r <= 0) return -1;  // Behind the observer
+    if (xo - edge > margin || -xo - edge > margin || yo - edge > margin || -yo - edge > margin) {
+        return -1;
+    }
+    return (zo - r > 0 && xo - edge < -margin && -xo - edge < -margin &&
+            yo - edge < -margin && -yo - edge < -margin) ? 1 : 0;
+}
+
+int octreeCollect(Model3D* model, ObserverParams* params) {
+    FaceArrays3D* faces = &model->faces;
+    OctreeNode* nodes = faces->octree;
+    int stack[8 * OCTREE_MAX_DEPTH + 1];
+    Byte inside[8 * OCTREE_MAX_DEPTH + 1];
+    int sp = 1, count = 0, k;
+    ViewTrig t;
+    
+    frame_octree_nodes = 0;
+    frame_octree_outside = 0;
+    frame_octree_listed = -1;
+    if (nodes == NULL) return -1;
+    computeViewTrig(params, &t);
+    stack[0] = 0;
+    inside[0] = 0;
+    while (sp > 0) {
+        OctreeNode* n = &nodes[stack[--sp]];
+        int in = inside[sp];
+        if (n->total == 0) continue;
+        frame_octree_nodes++;
+        if (!in) {
+            int c = octreeClassify(&t, n);
+            if (c < 0) {
+                frame_octree_outside += n->total;
+                continue;
+            }
+            if (c > 0 && n == nodes) {  // Nothing to skip: keep the clusters
+                STATS_ADD(STAT_OCTREE_NODES, 1);
+                return -1;
+            }
+            in = (c > 0);
+        }
+        if (n->count > 0) {
+            memcpy(&faces->sorted_face_indices[count], &faces->octree_faces[n->first],
+                   (size_t)n->count * sizeof(int));
+            count += n->count;
+        }
+        if (n->child >= 0) {
+            int eye = (model->eye_x >= n->cx ? 1 : 0) | (model->eye_y >= n->cy ? 2 : 0) |
+                      (model->eye_z >= n->cz ? 4 : 0);
+            for (k = 7; k >= 0; k--) {  // Popped nearest first
+                stack[sp] = n->child + (k ^ eye);
+                inside[sp] = (Byte)in;
+                sp++;
+            }
+        }
+    }
+    STATS_ADD(STAT_FACES_OUTSIDE, frame_octree_outside);
+    STATS_ADD(STAT_OCTREE_NODES, frame_octree_nodes);
+    frame_octree_listed = count;
+    return count;
+}
+
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
+// Depth pass of a view: the faces of the octree nodes in view when part of
+// the model is off screen (listed nearest first), else every face with its
+// cluster culling. Returns the faces listed in sorted_face_indices, to sort
+int calculateViewDepths(Model3D* model, ObserverParams* params) {
+    int i, listed = octreeCollect(model, params);
+    if (listed >= 0) {
+        calculateFaceDepthsList(model, listed);
+    } else {
+        listed = model->faces.face_count;
+        calculateFaceDepths(model, NULL, listed);
+        
+        // CRITICAL: Reset sorted_face_indices before each sort to prevent corruption
+        for (i = 0; i < listed; i++) {
+            model->faces.sorted_face_indices[i] = i;
+        }
+    }
+    return listed;
+}
+
+// calculateFaceDepths over the faces listed by octreeCollect only
+// (sorted_face_indices[0..count)); the others stay hidden
+#if GS3D_THREADS
+// Listed faces are scattered over the display flag bytes: chunks leave
+// each result in sort_scratch (free until the sort) and the bits are set
+// afterwards on the calling thread
+static void depthListTask(void* arg, int chunk) {
+    DepthJob* job = (DepthJob*)arg;
+    FaceArrays3D* faces = &job->model->faces;
+    DepthCounts* dc = &job->counts[chunk];
+    int first = chunk * job->chunk_items;
+    int end = (job->count - first > job->chunk_items) ? first + job->chunk_items : job->count;
+    int i;
+    
+    memset(dc, 0, sizeof(DepthCounts));
+    for (i = first; i < end; i++) {
+        int r = faceDepth(&job->model->vertices, faces, faces->sorted_face_indices[i], job->model->cull_mode);
+        faces->sort_scratch[i] = r;
+        if (r != FACE_SHOWN) dc->faces[r]++;
+    }
+}
+#endif
+
+void calculateFaceDepthsList(Model3D* model, int count) {
+    FaceArrays3D* faces = &model->faces;
+    DepthCounts dc;
+    int i;
+    
+    memset(&dc, 0, sizeof(dc));
+    memset(faces->display_flag, 0, FACE_FLAG_BYTES(faces->face_count));
+#if GS3D_THREADS
+    if (pool_threads > 1 && count >= POOL_MIN_ITEMS) {
+        static DepthJob job;
+        job.model = model;
+        job.count = count;
+        depthRunPool(&job, depthListTask, &dc);
+        for (i = 0; i < count; i++) {
+            if (faces->sort_scratch[i] == FACE_SHOWN) FACE_SET_VISIBLE(faces->display_flag, faces->sorted_face_indices[i]);
+        }
+    } else
+#endif
+    for (i = 0; i < count; i++) {
+        int r = faceDepth(&model->vertices, faces, faces->sorted_face_indices[i], model->cull_mode);
+        if (r == FACE_SHOWN) FACE_SET_VISIBLE(faces->display_flag, faces->sorted_face_indices[i]);
+        else dc.faces[r]++;
+    }
+    depthPublish(&dc);
+}
+
+/**
+ * CULLING-ONLY FRAMES (CONVEX MODELS)
+ * ===================================
+ * 
+ * For a convex mesh (detectConvex) under winding culling the surviving
+ * faces never overlap, so their order does not matter: the winding,
+ * behind-camera and sub-pixel tests run, visible faces go straight into
+ * sorted_face_indices in index order. z_max is still the nearest vertex
+ * depth (the behind-camera loop reads zo anyway), for the frame trace.
+ * The view cache is bypassed (a culling pass costs less than a lookup).
+ * Applies to the loaded faces only: the coarse and LOD levels are not
+ * checked and keep the depth sort.
+ */
+int convexFastPath(Model3D* model) {
+    return model->faces.convex == CONVEX_YES && model->cull_mode != CULL_NONE;
+}
+
+void cullFacesConvex(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int i, j, count = 0;
+    
+    frame_culled_subpixel = 0;
+    frame_culled_winding = 0;
+    memset(faces->display_flag, 0, FACE_FLAG_BYTES(faces->face_count));
+    for (i = 0; i < faces->face_count; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        int n = faces->vertex_count[i];
+        Fixed32 z_min = FLOAT_TO_FIXED(9999.0);  // faceDepth's value for a culled face
+        if (faceWindingCulled(vtx, idx, model->cull_mode)) {
+            faces->z_max[i] = z_min;
+            frame_culled_winding++;
+            continue;
+        }
+        for (j = 0; j < n; j++) {
+            if (vtx->zo[idx[j] - 1] < z_min) z_min = vtx->zo[idx[j] - 1];
+        }
+        faces->z_max[i] = z_min;
+        if (z_min <= 0) {
+            STATS_ADD(STAT_FACES_BEHIND, 1);
+            continue;
+        }
+        if (subpixel_area_min > 0 && faceSubpixelCulled(vtx, idx, n)) {
+            frame_culled_subpixel++;
+            continue;
+        }
+        FACE_SET_VISIBLE(faces->display_flag, i);
+        faces->sorted_face_indices[count++] = i;
+    }
+    faces->draw_count = count;
+    STATS_ADD(STAT_FACES_WINDING, frame_culled_winding);
+    STATS_ADD(STAT_FACES_SUBPIXEL, frame_culled_subpixel);
+}
+
+/**
+ * FACE SORTING BY DEPTH (OPTIMIZED VERSION)
+ * ==========================================
+ * 
+ * This function sorts faces in descending order of z_max depth
+ * to implement the painter's algorithm. The farthest faces
+ * (highest z_max) are placed first in the array to be
+ * drawn first, and the nearest ones last.
+ * 
+ * PARAMETERS:
+ *   faces      : Array of faces to sort
+ *   face_count : Number of faces
+ * 
+ * ALGORITHMS:
+ *   - Insertion sort for small collections (< 10 faces) - O(n²) but fast
+ *   - Radix sort (DEPTH_SORT_RADIX) for large collections - O(n), stable
+ *   - Quick sort (quicksort) otherwise - O(n log n) on average
+ *   - Already sorted array detection to avoid unnecessary sorting - O(n)
+ * 
+ * OPTIMIZATIONS:
+ *   - Adaptive threshold based on size
+ *   - Pre-sort verification for already ordered arrays
+ *   - Median-of-three pivoting for stable quicksort
+ * 
+ * NOTES:
+ *   - Must be called AFTER calculateFaceDepths()
+ *   - Sort order: descending z_max (farthest to nearest)
+ */
+void sortFacesByDepth(Model3D* model, int face_count) {
+    // Sort faces by z_max in descending order (farthest to nearest)
+    // Optimized: insertion sort for small arrays, quicksort for large
+    
+    if (face_count <= 1) {
+        return;
+    }
+    
+    FaceArrays3D* faces = &model->faces;
+    
+    // For small arrays (<=16), use insertion sort (faster due to low overhead)
+    if (face_count <= 16) {
+        sortFacesByDepth_insertion(faces, face_count);
+    } else {
+#if DEPTH_SORT_RADIX
+        sortFacesByDepth_radix(faces, face_count);
+#else
+        // For larger arrays, use quicksort
+        sortFacesByDepth_quicksort(faces, 0, face_count - 1);
+#endif
+    }
+}
+
+/**
+ * RADIX SORT BY DEPTH
+ * ===================
+ * 
+ * Least-significant-byte-first radix sort of sorted_face_indices on z_max.
+ * 
+ * KEY:
+ *   key = z_max ^ 0x7FFFFFFF. Flipping the sign bit makes the signed
+ *   Fixed32 order an unsigned one; inverting the other bits too turns
+ *   ascending key order into descending depth (farthest first).
+ * 
+ * ALGORITHM:
+ *   1. One pass over the keys builds the four byte histograms at once
+ *   2. Per byte (low to high): prefix sums, then a stable scatter between
+ *      sorted_face_indices and sort_scratch
+ *   3. A byte equal in every key (typically the high byte: all depths in
+ *      a few units) puts every face in one bucket - that pass is skipped
+ * 
+ * NOTES:
+ *   - Stable: equal depths keep their previous order, so the result is
+ *     deterministic, unlike quicksort whose tie order depends on pivots
+ *   - Histograms are static (2 KB) to keep them off the 65816 stack
+ *   - Host thread pool: each pass histograms the chunks of the current
+ *     order in parallel; bucket by bucket, chunk k starts after the same
+ *     bucket of chunks 0..k-1, so the parallel scatter keeps the order of
+ *     the single-thread one (sortFacesByDepth_radixPool)
+ */
+static int radix_hist[4][256];
+
+#if GS3D_THREADS
+static int radix_chunk_hist[POOL_MAX_CHUNKS][256];  // Counts, then write positions
+
+typedef struct {
+    FaceArrays3D* faces;
+    int *src, *dst;
+    int count, chunk_items, shift;
+} RadixJob;
+
+static void radixHistTask(void* arg, int chunk) {
+    RadixJob* job = (RadixJob*)arg;
+    int* count = radix_chunk_hist[chunk];
+    int first = chunk * job->chunk_items;
+    int end = (job->count - first > job->chunk_items) ? first + job->chunk_items : job->count;
+    int i;
+    
+    memset(count, 0, 256 * sizeof(int));
+    for (i = first; i < end; i++) {
+        unsigned long key = (unsigned long)job->faces->z_max[job->src[i]] ^ 0x7FFFFFFFUL;
+        count[(Byte)(key >> job->shift)]++;
+    }
+}
+
+static void radixScatterTask(void* arg, int chunk) {
+    RadixJob* job = (RadixJob*)arg;
+    int* pos = radix_chunk_hist[chunk];
+    int first = chunk * job->chunk_items;
+    int end = (job->count - first > job->chunk_items) ? first + job->chunk_items : job->count;
+    int i;
     
-    // Read file line by line
-    while (fgets(line, sizeof(line), file) != NULL) {
-        // Check if line starts with "f " (face)
-        if (line[0] == 'f' && line[1] == ' ') {
-            if (face_count < MAX_FACES) {
-                // Initialize face data
-                model->faces.vertex_count[face_count] = 0;
-                model->faces.display_flag[face_count] = 1;  // Displayable by default
-                model->faces.vertex_indices_ptr[face_count] = buffer_pos;  // Store offset to this face's indices
-                
-                // Parse vertices from this face
-                char *ptr = line + 2;  // Start after "f "
-                int temp_indices[MAX_FACE_VERTICES];
-                int temp_vertex_count = 0;
-                int invalid_index_found = 0;
-                
-                // Parse character by character
-                while (*ptr != '\0' && *ptr != '\n' && temp_vertex_count < MAX_FACE_VERTICES) {
-                    // Skip spaces and tabs
-                    while (*ptr == ' ' || *ptr == '\t') ptr++;
-                    
-                    if (*ptr == '\0' || *ptr == '\n') break;
-                    
-                    // Read the number
-                    int vertex_index = 0;
-                    while (*ptr >= '0' && *ptr <= '9') {
-                        vertex_index = vertex_index * 10 + (*ptr - '0');
-                        ptr++;
-                    }
-                    
-                    // Skip texture/normal data (after /)
-                    while (*ptr != '\0' && *ptr != ' ' && *ptr != '\t' && *ptr != '\n') {
-                        ptr++;
-                    }
-                    
-                    // Validate vertex index
-                    if (vertex_index >= 1) {
-                        if (vertex_index > readVertices_last_count) {
-                            // Index out of bounds
-                            invalid_index_found = 1;
-                        }
-                        temp_indices[temp_vertex_count] = vertex_index;
-                        temp_vertex_count++;
-                    }
-                }
-                
-                // Check for errors
-                if (invalid_index_found) {
-                    printf("\nERROR: Face at line %d references vertex index > %d vertices\n", 
-                           line_number, readVertices_last_count);
-                    fclose(file);
-                    return -1;
-                } else {
-                    // Store valid indices into the packed buffer
-                    for (i = 0; i < temp_vertex_count; i++) {
-                        model->faces.vertex_indices_buffer[buffer_pos++] = temp_indices[i];
-                    }
-                    model->faces.vertex_count[face_count] = temp_vertex_count;
-                    model->faces.total_indices += temp_vertex_count;
-                    
-                    // Skip faces with zero vertices
-                    if (model->faces.vertex_count[face_count] > 0) {
-                        face_count++;
-                        if (face_count % 10 == 0) {printf(".");}
-                    } else {
-                        printf("     -> WARNING: Face without valid vertices ignored\n");
-                    }
-                }
-            } else {
-                printf("     -> WARNING: Face limit reached (%d)\n", MAX_FACES);
+    for (i = first; i < end; i++) {
+        int face_id = job->src[i];
+        unsigned long key = (unsigned long)job->faces->z_max[face_id] ^ 0x7FFFFFFFUL;
+        job->dst[pos[(Byte)(key >> job->shift)]++] = face_id;
+    }
+}
+
+static void sortFacesByDepth_radixPool(FaceArrays3D* faces, int face_count) {
+    RadixJob job;
+    int chunks, pass, b, k;
+    
+    job.faces = faces;
+    job.src = faces->sorted_face_indices;
+    job.dst = faces->sort_scratch;
+    job.count = face_count;
+    chunks = poolChunks(face_count, &job.chunk_items);
+    
+    for (pass = 0; pass < 4; pass++) {
+        int sum = 0;
+        job.shift = pass * 8;
+        poolRun(radixHistTask, &job, chunks);
+        
+        // Same byte in every key: order unchanged
+        for (b = 0; b < 256; b++) {
+            int total = 0;
+            for (k = 0; k < chunks; k++) total += radix_chunk_hist[k][b];
+            if (total == face_count) break;
+        }
+        if (b < 256) continue;
+        
+        // Chunk histograms -> write positions: bucket by bucket, chunks in order
+        for (b = 0; b < 256; b++) {
+            for (k = 0; k < chunks; k++) {
+                int c = radix_chunk_hist[k][b];
+                radix_chunk_hist[k][b] = sum;
+                sum += c;
             }
         }
+        poolRun(radixScatterTask, &job, chunks);
+        
+        {
+            int *tmp = job.src;
+            job.src = job.dst;
+            job.dst = tmp;
+        }
+    }
+    if (job.src != faces->sorted_face_indices) {
+        memcpy(faces->sorted_face_indices, job.src, (size_t)face_count * sizeof(int));
+    }
+}
+#endif
+
+void sortFacesByDepth_radix(FaceArrays3D* faces, int face_count) {
+    int *src = faces->sorted_face_indices;
+    int *dst = faces->sort_scratch;
+    int i, pass;
+    
+#if GS3D_THREADS
+    if (pool_threads > 1 && face_count >= POOL_MIN_ITEMS) {
+        sortFacesByDepth_radixPool(faces, face_count);
+        return;
+    }
+#endif
+    memset(radix_hist, 0, sizeof(radix_hist));
+    for (i = 0; i < face_count; i++) {
+        unsigned long key = (unsigned long)faces->z_max[src[i]] ^ 0x7FFFFFFFUL;
+        radix_hist[0][(Byte)key]++;
+        radix_hist[1][(Byte)(key >> 8)]++;
+        radix_hist[2][(Byte)(key >> 16)]++;
+        radix_hist[3][(Byte)(key >> 24)]++;
+    }
+    
+    for (pass = 0; pass < 4; pass++) {
+        int *count = radix_hist[pass];
+        int shift = pass * 8;
+        int sum = 0;
+        
+        if (count[(Byte)(((unsigned long)faces->z_max[src[0]] ^ 0x7FFFFFFFUL) >> shift)] == face_count) {
+            continue;  // Same byte in every key: order unchanged
+        }
+        
+        // Histogram -> starting position of each bucket
+        for (i = 0; i < 256; i++) {
+            int c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        
+        for (i = 0; i < face_count; i++) {
+            int face_id = src[i];
+            unsigned long key = (unsigned long)faces->z_max[face_id] ^ 0x7FFFFFFFUL;
+            dst[count[(Byte)(key >> shift)]++] = face_id;
+        }
+        
+        // Swap buffers: dst now holds the order
+        {
+            int *tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+    }
+    
+    // Odd number of scatter passes: result is in sort_scratch
+    if (src != faces->sorted_face_indices) {
+        memcpy(faces->sorted_face_indices, src, (size_t)face_count * sizeof(int));
+    }
+}
+
+// Helper macro to swap face indices in the sorted_face_indices array
+// (We swap indices, not the faces themselves, to keep the buffer intact)
+#define SWAP_FACE(faces, i, j) \
+    do { \
+        int temp_idx = faces->sorted_face_indices[i]; \
+        faces->sorted_face_indices[i] = faces->sorted_face_indices[j]; \
+        faces->sorted_face_indices[j] = temp_idx; \
+    } while (0)
+
+/**
+ * Insertion sort for small arrays (optimized for sorted_face_indices)
+ * Now we sort indices by comparing their depth values (z_max)
+ */
+void sortFacesByDepth_insertion(FaceArrays3D* faces, int face_count) {
+    int i, j;
+    
+    for (i = 1; i < face_count; i++) {
+        int face_i = faces->sorted_face_indices[i];
+        int face_prev = faces->sorted_face_indices[i - 1];
+        
+        // If already in order (descending), skip
+        if (faces->z_max[face_i] <= faces->z_max[face_prev]) {
+            continue;
+        }
+        
+        // Find insertion position
+        j = i - 1;
+        while (j >= 0) {
+            int face_j = faces->sorted_face_indices[j];
+            if (faces->z_max[face_j] >= faces->z_max[face_i]) break;
+            // Shift index right
+            SWAP_FACE(faces, j + 1, j);
+            j--;
+        }
+        
+        // Insert at position j+1
+        faces->sorted_face_indices[j + 1] = face_i;
+    }
+}
+
+/**
+ * Quicksort for large arrays
+ */
+void sortFacesByDepth_quicksort(FaceArrays3D* faces, int low, int high) {
+    if (low < high) {
+        // For small partitions, use insertion sort
+        if (high - low <= 16) {
+            sortFacesByDepth_insertion_range(faces, low, high);
+            return;
+        }
+        
+        // Partition and recursively sort
+        int pivot_index = sortFacesByDepth_partition(faces, low, high);
+        sortFacesByDepth_quicksort(faces, low, pivot_index - 1);
+        sortFacesByDepth_quicksort(faces, pivot_index + 1, high);
+    }
+}
+
+/**
+ * Insertion sort for a range (used by quicksort)
+ */
+void sortFacesByDepth_insertion_range(FaceArrays3D* faces, int low, int high) {
+    int i, j;
+    
+    for (i = low + 1; i <= high; i++) {
+        int face_i = faces->sorted_face_indices[i];
+        int face_prev = faces->sorted_face_indices[i - 1];
+        
+        if (faces->z_max[face_i] <= faces->z_max[face_prev]) {
+            continue;
+        }
+        
+        j = i - 1;
+        while (j >= low) {
+            int face_j = faces->sorted_face_indices[j];
+            if (faces->z_max[face_j] >= faces->z_max[face_i]) break;
+            // Shift index right
+            SWAP_FACE(faces, j + 1, j);
+            j--;
+        }
+        
+        // Insert at position j+1
+        faces->sorted_face_indices[j + 1] = face_i;
+    }
+}
+
+/**
+ * Partition function for quicksort (median-of-three pivot)
+ */
+int sortFacesByDepth_partition(FaceArrays3D* faces, int low, int high) {
+    // Median-of-three for better pivot selection
+    int mid = low + (high - low) / 2;
+    
+    int face_low = faces->sorted_face_indices[low];
+    int face_mid = faces->sorted_face_indices[mid];
+    int face_high = faces->sorted_face_indices[high];
+    
+    if (faces->z_max[face_low] < faces->z_max[face_mid]) {
+        SWAP_FACE(faces, low, mid);
+    }
+    if (faces->z_max[faces->sorted_face_indices[low]] < faces->z_max[face_high]) {
+        SWAP_FACE(faces, low, high);
+    }
+    if (faces->z_max[faces->sorted_face_indices[mid]] < faces->z_max[faces->sorted_face_indices[high]]) {
+        SWAP_FACE(faces, mid, high);
+    }
+    
+    // Use median (now at low) as pivot
+    Fixed32 pivot = faces->z_max[faces->sorted_face_indices[low]];
+    SWAP_FACE(faces, low, high);  // Move pivot to end
+    
+    int i = low - 1;
+    for (int j = low; j < high; j++) {
+        if (faces->z_max[faces->sorted_face_indices[j]] >= pivot) {  // Descending order
+            i++;
+            SWAP_FACE(faces, i, j);
+        }
+    }
+    
+    SWAP_FACE(faces, i + 1, high);  // Move pivot to final position
+    return i + 1;
+}
+
+// ============================================================================
+//                              DRAW STATE
+// ============================================================================
+
+/**
+ * PEN AND FILL COLOR BATCHING
+ * ===========================
+ * 
+ * Fills pass their pattern to FillPoly directly (one solid pattern per
+ * palette color, captured once), so the pen only carries the frame color
+ * and changes when that color does. usePenColor skips redundant
+ * SetSolidPenPat calls and counts the ones made as draw state changes
+ * (draw_state_changes, STAT_STATE_CHANGES). A fill color switch changes
+ * no QuickDraw state, so it is not counted.
+ */
+static Pattern fill_patterns[16];
+static int fill_patterns_ready = 0;
+static int pen_current = -1;        // Solid pen color in QuickDraw, -1 = unknown
+static int draw_state_changes = 0;  // Last frame
+
+// Start of a frame: startgraph reset the pen
+static void drawStateReset(void) {
+    int c;
+    if (!fill_patterns_ready) {
+        for (c = 0; c < 16; c++) {
+            SetSolidPenPat(c);
+            GetPenPat(fill_patterns[c]);
+        }
+        fill_patterns_ready = 1;
+    }
+    pen_current = -1;
+    draw_state_changes = 0;
+}
+
+static void usePenColor(int color) {
+    if (color != pen_current) {
+        SetSolidPenPat(color);
+        pen_current = color;
+        draw_state_changes++;
+        STATS_ADD(STAT_STATE_CHANGES, 1);
+    }
+}
+
+/**
+ * INTERRUPTIBLE DRAWING
+ * =====================
+ * 
+ * The drawing loops call renderPoll every RENDER_POLL_FACES faces. A key
+ * waiting in KBD_DATA (left there for the main loop to read) abandons the
+ * frame: frame_aborted is set, the loop breaks out through its normal
+ * cleanup (handle unlocked, clip restored) and the partial off-screen
+ * frame is never shown or reused. Navigation keys then coalesce in main.
+ * render_poll_hook replaces the keyboard, so abort points can be driven
+ * and counted (render_polls, render_aborts) without a keyboard.
+ */
+static int renderPoll(void) {
+    int pending;
+    if (!render_interruptible) return 0;
+    render_polls++;
+    pending = (render_poll_hook != NULL) ? render_poll_hook() : (KBD_DATA & 0x80);
+    if (pending) {
+        frame_aborted = 1;
+        render_aborts++;
+        return 1;
+    }
+    return 0;
+}
+
+#define RENDER_POLL_DUE(n)  ((((n) + 1) & (RENDER_POLL_FACES - 1)) == 0)
+
+void renderSetPollHook(int (*hook)(void)) {
+    render_poll_hook = hook;  // NULL: back to KBD_DATA
+}
+
+static Byte* useFillColor(int color) {
+    return fill_patterns[color];  // Passed to FillPoly: the pen is untouched
+}
+
+// ============================================================================
+//                              FLAT SHADING
+// ============================================================================
+
+/**
+ * LAMBERT FLAT SHADING WITH ORDERED DITHERING
+ * ===========================================
+ * 
+ * Each face gets one intensity, |N.L| plus an ambient floor, from a normal
+ * computed once at load and a light fixed on screen. The 16 colors of
+ * palette 0 become a grey ramp (entry 0 stays the black background), and
+ * the SHADE_DITHER - 1 steps between two entries are 4x4 Bayer patterns
+ * built once. A shaded face is a single FillPoly with its pattern: faces
+ * stay distinct without the FramePoly pass, which is skipped.
+ * 
+ * COST PER FRAME:
+ *   The light is rotated into object space once (shadeSetView), so a face
+ *   costs three 16x16 products, not a normal rotation.
+ * 
+ * |N.L| lights both sides: some OBJ files mix windings (see CULL_NONE).
+ */
+static Pattern shade_patterns[SHADE_COUNT];
+static int shade_patterns_ready = 0;
+
+static const Byte shade_bayer[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+void computeFaceNormals(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    int i, j;
+    
+    for (i = 0; i < faces->face_count; i++) {
+        VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]];
+        int n = faces->vertex_count[i];
+        int o = idx[0] - 1;
+        float nx = 0.0, ny = 0.0, nz = 0.0, len;
         
-        line_number++;
+        // Newell: robust for non-planar quads and hexagons. Relative to the
+        // first vertex (the sum is translation invariant) so thin faces far
+        // from the origin keep their float precision
+        for (j = 0; j < n; j++) {
+            int a = idx[j] - 1;
+            int b = idx[(j + 1 == n) ? 0 : j + 1] - 1;
+            float ya, za, xa, yb, zb, xb;
+            if (a < 0 || a >= vtx->vertex_count || b < 0 || b >= vtx->vertex_count) continue;
+            xa = FIXED_TO_FLOAT(vtx->x[a] - vtx->x[o]); ya = FIXED_TO_FLOAT(vtx->y[a] - vtx->y[o]); za = FIXED_TO_FLOAT(vtx->z[a] - vtx->z[o]);
+            xb = FIXED_TO_FLOAT(vtx->x[b] - vtx->x[o]); yb = FIXED_TO_FLOAT(vtx->y[b] - vtx->y[o]); zb = FIXED_TO_FLOAT(vtx->z[b] - vtx->z[o]);
+            nx += (ya - yb) * (za + zb);
+            ny += (za - zb) * (xa + xb);
+            nz += (xa - xb) * (ya + yb);
+        }
+        len = sqrt(nx * nx + ny * ny + nz * nz);
+        if (len > 0.0) {
+            faces->normal_x[i] = (signed char)(nx * SHADE_NORMAL_ONE / len);
+            faces->normal_y[i] = (signed char)(ny * SHADE_NORMAL_ONE / len);
+            faces->normal_z[i] = (signed char)(nz * SHADE_NORMAL_ONE / len);
+        } else {
+            // Degenerate area: ambient only
+            faces->normal_x[i] = faces->normal_y[i] = faces->normal_z[i] = 0;
+        }
     }
+}
+
+void shadeSetView(ObserverParams* params) {
+    ViewTrig t;
+    Fixed32 lx, ly, lz;
     
-    // Close file
-    fclose(file);
+    computeViewTrig(params, &t);
+    // Undo the screen rotation so the light stays fixed on screen
+    lx = FIXED_MUL_64(t.cos_w, SHADE_LIGHT_X) + FIXED_MUL_64(t.sin_w, SHADE_LIGHT_Y);
+    ly = FIXED_MUL_64(t.cos_w, SHADE_LIGHT_Y) - FIXED_MUL_64(t.sin_w, SHADE_LIGHT_X);
+    lz = SHADE_LIGHT_Z;
+    // Transpose of the view rotation (rows xo, yo, zo of transformVertices)
+    shade_light_x = (-FIXED_MUL_64(lx, t.sin_h) - FIXED_MUL_64(ly, t.cos_h_sin_v)
+                     - FIXED_MUL_64(lz, t.cos_h_cos_v)) >> 8;
+    shade_light_y = (FIXED_MUL_64(lx, t.cos_h) - FIXED_MUL_64(ly, t.sin_h_sin_v)
+                     - FIXED_MUL_64(lz, t.sin_h_cos_v)) >> 8;
+    shade_light_z = (FIXED_MUL_64(ly, t.cos_v) - FIXED_MUL_64(lz, t.sin_v)) >> 8;
+}
+
+// Shade index (0 = darkest) of one face for the current view
+static int faceShade(FaceArrays3D* faces, int face_id) {
+    long d = faces->normal_x[face_id] * shade_light_x
+           + faces->normal_y[face_id] * shade_light_y
+           + faces->normal_z[face_id] * shade_light_z;
+    int shade;
     
-    model->faces.face_count = face_count;
+    if (d < 0) d = -d;
+    shade = SHADE_AMBIENT + (int)(d * (SHADE_COUNT - 1 - SHADE_AMBIENT) / (SHADE_NORMAL_ONE * 256L));
+    return (shade >= SHADE_COUNT) ? SHADE_COUNT - 1 : shade;
+}
+
+static void shadeBuildPatterns(void) {
+    int s, x, y;
     
-    // Initialize sorted_face_indices with identity mapping (will be sorted later)
-    for (i = 0; i < face_count; i++) {
-        model->faces.sorted_face_indices[i] = i;
+    for (s = 0; s < SHADE_COUNT; s++) {
+        int base = 1 + s / SHADE_DITHER;
+        int step = (s % SHADE_DITHER) * 16 / SHADE_DITHER;
+        for (y = 0; y < 8; y++) {
+            for (x = 0; x < 8; x += 2) {
+                // 320 mode: 4 bytes per pattern row, left pixel in the high nibble
+                int left = (shade_bayer[y & 3][x & 3] < step) ? base + 1 : base;
+                int right = (shade_bayer[y & 3][(x + 1) & 3] < step) ? base + 1 : base;
+                shade_patterns[s][y * 4 + x / 2] = (Byte)((left << 4) | right);
+            }
+        }
     }
+    shade_patterns_ready = 1;
+}
+
+void shadeSetPalette(void) {
+    int k;
     
-    printf("\nReading faces finished : %d faces read.\n", face_count);
-    return face_count;
+    if (!shade_patterns_ready) {
+        shadeBuildPatterns();
+    }
+    for (k = 1; k <= SHADE_LEVELS; k++) {
+        SetColorEntry(0, k, (Word)((k << 8) | (k << 4) | k));  // $0RGB grey
+    }
 }
-void transformToObserver(VertexArrays3D* vtx, Fixed32 angle_h, Fixed32 angle_v, Fixed32 distance) {
+
+// ============================================================================
+//                            FEATURE OUTLINES
+// ============================================================================
+
+/**
+ * SILHOUETTE AND CREASE OUTLINES
+ * ==============================
+ * 
+ * FramePoly strokes every edge of every face. OUTLINE_FEATURE keeps only:
+ *   - silhouette edges : one adjacent face toward the observer, one away
+ *   - crease edges     : normals more than CREASE_ANGLE apart (flagged at load)
+ *   - boundary edges   : a single adjacent face
+ * Smooth meshes (cone.obj, m.obj) lose most of their line work.
+ * 
+ * HIDDEN LINES:
+ *   Each face draws its feature edges right after its own fill, so faces
+ *   painted later hide them like any other pixel. A shared edge waits for
+ *   the second of its two faces (edges.stamp), which puts it on top of both
+ *   fills. outlineBeginPass starts a new painter pass (or tile) and stamps
+ *   the faces it will paint (edges.face_stamp): an edge only waits for a
+ *   neighbour in that list, so a neighbour skipped this pass (behind the
+ *   observer, outside the octree list, not in this tile) leaves the edge
+ *   to the face that is drawn. A neighbour skipped by the dirty rectangle
+ *   needs no stamp check: the edge lies in its bounds, so it is clipped.
+ * 
+ * Facing uses the load-time normals against the observer position in
+ * object space (model->eye_*, set by transformVertices): only the relative
+ * facing of two faces matters, so the winding convention does not, as
+ * long as the mesh is consistent.
+ */
+void outlineSetView(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    EdgeArrays3D* edges = &model->edges;
+    Fixed32 cam_x = model->eye_x, cam_y = model->eye_y, cam_z = model->eye_z;
     int i;
-    Fixed32 rad_h, rad_v;
-    Fixed32 cos_h, sin_h, cos_v, sin_v;
-    Fixed32 x, y, z;
-    rad_h = FIXED_MUL_64(angle_h, FIXED_PI_180);
-    rad_v = FIXED_MUL_64(angle_v, FIXED_PI_180);
-    cos_h = cos_fixed(rad_h);
-    sin_h = sin_fixed(rad_h);
-    cos_v = cos_fixed(rad_v);
-    sin_v = sin_fixed(rad_v);
-    Fixed32 cos_h_cos_v = FIXED_MUL_64(cos_h, cos_v);
-    Fixed32 sin_h_cos_v = FIXED_MUL_64(sin_h, cos_v);
-    Fixed32 cos_h_sin_v = FIXED_MUL_64(cos_h, sin_v);
-    Fixed32 sin_h_sin_v = FIXED_MUL_64(sin_h, sin_v);
-#if !PERFORMANCE_MODE
-    printf("\nTransformation to observer system (Fixed Point):\n");
-    printf("Horizontal angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_h));
-    printf("Vertical angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_v));
-    printf("Distance: %.3f\n", FIXED_TO_FLOAT(distance));
-    printf("==========================================\n");
-#endif
-    for (i = 0; i < vtx->vertex_count; i++) {
-        x = vtx->x[i];
-        y = vtx->y[i];
-        z = vtx->z[i];
-        vtx->xo[i] = FIXED_ADD(
-            FIXED_MUL_64(x, cos_h_cos_v),
-            FIXED_MUL_64(y, sin_h_cos_v)
-        );
-        vtx->yo[i] = FIXED_ADD(
-            FIXED_SUB(
-                FIXED_MUL_64(-x, cos_h_sin_v),
-                FIXED_MUL_64(y, sin_h_sin_v)
-            ),
-            FIXED_MUL_64(z, cos_v)
-        );
-        vtx->zo[i] = FIXED_ADD(
-            FIXED_ADD(
-                FIXED_MUL_64(-x, sin_h),
-                FIXED_MUL_64(-y, cos_h)
-            ),
-            distance
-        );
+    
+    if (edges->block == NULL) return;
+    memset(edges->front, 0, FACE_FLAG_BYTES(faces->face_count));
+    for (i = 0; i < faces->face_count; i++) {
+        int v = faces->vertex_indices_buffer[faces->vertex_indices_ptr[i]] - 1;
+        long d = faces->normal_x[i] * ((cam_x - vtx->x[v]) >> 8)
+               + faces->normal_y[i] * ((cam_y - vtx->y[v]) >> 8)
+               + faces->normal_z[i] * ((cam_z - vtx->z[v]) >> 8);
+        if (d > 0) FACE_SET_VISIBLE(edges->front, i);
     }
 }
 
-// Function to project 3D coordinates onto 2D screen - FIXED POINT VERSION
-void projectTo2D(VertexArrays3D* vtx, Fixed32 angle_w) {
-    int i;
-    Fixed32 rad_w;
-    Fixed32 cos_w, sin_w;
-    Fixed32 x2d_temp, y2d_temp;
-    rad_w = FIXED_MUL_64(angle_w, FIXED_PI_180);
-    cos_w = cos_fixed(rad_w);
-    sin_w = sin_fixed(rad_w);
-    const Fixed32 scale = INT_TO_FIXED(100);
-    const Fixed32 centre_x_f = INT_TO_FIXED(CENTRE_X);
-    const Fixed32 centre_y_f = INT_TO_FIXED(CENTRE_Y);
-#if !PERFORMANCE_MODE
-    printf("\nProjection on 2D screen (Fixed Point):\n");
-    printf("Rotation angle: %.1f degrees\n", FIXED_TO_FLOAT(angle_w));
-    printf("Screen center: (%d, %d)\n", CENTRE_X, CENTRE_Y);
-    printf("===========================\n");
-#endif
-    for (i = 0; i < vtx->vertex_count; i++) {
-        if (vtx->zo[i] > 0) {
-            Fixed32 xo = vtx->xo[i];
-            Fixed32 yo = vtx->yo[i];
-            Fixed32 inv_zo = FIXED_DIV_64(scale, vtx->zo[i]);
-            x2d_temp = FIXED_ADD(FIXED_MUL_64(xo, inv_zo), centre_x_f);
-            y2d_temp = FIXED_SUB(centre_y_f, FIXED_MUL_64(yo, inv_zo));
-            vtx->x2d[i] = FIXED_TO_INT(FIXED_ADD(FIXED_SUB(FIXED_MUL_64(cos_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(sin_w, FIXED_SUB(centre_y_f, y2d_temp))), centre_x_f));
-            vtx->y2d[i] = FIXED_TO_INT(FIXED_SUB(centre_y_f, FIXED_ADD(FIXED_MUL_64(sin_w, FIXED_SUB(x2d_temp, centre_x_f)), FIXED_MUL_64(cos_w, FIXED_SUB(centre_y_f, y2d_temp)))));
-        } else {
-            vtx->x2d[i] = -1;
-            vtx->y2d[i] = -1;
+void outlineBeginPass(Model3D* model, const int* list, long count) {
+    FaceArrays3D* faces = &model->faces;
+    long i;
+    
+    if (model->edges.block == NULL) return;
+    if (++outline_stamp == 0) {
+        memset(model->edges.stamp, 0, (size_t)model->edges.edge_count * sizeof(Word));
+        memset(model->edges.face_stamp, 0, (size_t)faces->face_count * sizeof(Word));
+        outline_stamp = 1;
+    }
+    // Same tests as the painter loops: these faces are filled this pass
+    for (i = 0; i < count; i++) {
+        int face_id = list[i];
+        if (FACE_VISIBLE(faces->display_flag, face_id) && faces->vertex_count[face_id] >= 3) {
+            model->edges.face_stamp[face_id] = outline_stamp;
+        }
+    }
+}
+
+void drawFeatureEdges(Model3D* model, int face_id) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    EdgeArrays3D* edges = &model->edges;
+    IndexOffset offset = faces->vertex_indices_ptr[face_id];
+    VertexIndex *idx = &faces->vertex_indices_buffer[offset];
+    int j, n = faces->vertex_count[face_id];
+    int pen_set = 0;
+    
+    for (j = 0; j < n; j++) {
+        int e = edges->face_edge[offset + j];
+        int other = (edges->face0[e] == face_id) ? edges->face1[e] : edges->face0[e];
+        int a, b;
+        if (!(edges->flags[e] & (EDGE_CREASE | EDGE_BOUNDARY)) &&
+            !FACE_VISIBLE(edges->front, face_id) == !FACE_VISIBLE(edges->front, other)) continue;
+        // Shared edge: drawn with the second of its faces painted this pass
+        if (other >= 0 && edges->face_stamp[other] == outline_stamp && edges->stamp[e] != outline_stamp) {
+            edges->stamp[e] = outline_stamp;
+            continue;
         }
+        a = idx[j] - 1;
+        b = idx[(j + 1 == n) ? 0 : j + 1] - 1;
+        if (vtx->zo[a] <= 0 || vtx->zo[b] <= 0) continue;
+        if (!pen_set) {
+            usePenColor(shade_mode ? 0 : FRAME_COLOR);
+            pen_set = 1;
+        }
+        MoveTo(mode / 320 * vtx->x2d[a], vtx->y2d[a]);
+        LineTo(mode / 320 * vtx->x2d[b], vtx->y2d[b]);
+        outline_edges_drawn++;
     }
 }
 
 /**
- * CALCULATING MINIMUM FACE DEPTHS AND VISIBILITY FLAGS
- * =====================================================
- * 
- * This function calculates for each face:
- * 1. The minimum depth (z_min) of all its vertices in the observer coordinate system
- * 2. The display visibility flag based on vertex positions relative to camera
+ * FACE POLYGON HELPERS
+ * ====================
  * 
- * The z_min value is used for face sorting during rendering (painter's algorithm).
- * We use minimum (closest point) for correct occlusion in the painter's algorithm.
- * The display_flag is used to cull faces that have vertices behind the camera.
+ * buildFacePoly : fills a QuickDraw polygon (points and bounding box) with
+ *                 the projected vertices of one face
+ * paintFacePoly : fills it with the face color and frames it with
+ *                 FRAME_COLOR, or with the dithered shade of the face
+ *                 (shade_mode); with
+ *                 OUTLINE_FEATURE the frame becomes the feature edges
+ * faceScreenBounds : bounding box of the face in xs/ys (x2d/y2d or frame
+ *                    buffer pixels), pen included
+ * polyPixelArea : shoelace area of the polygon as drawn (STATS_FILL_AREA)
+ */
+static void buildFacePoly(Model3D* model, int face_id, DynamicPolygon* poly) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    IndexOffset offset = faces->vertex_indices_ptr[face_id];
+    int min_x, max_x, min_y, max_y;
+    int j;
+    
+    // Calculate polySize for this specific face
+    poly->polySize = 2 + 8 + (faces->vertex_count[face_id] * 4);
+    min_x = max_x = min_y = max_y = -1;
+    for (j = 0; j < faces->vertex_count[face_id]; j++) {
+        int vertex_idx = faces->vertex_indices_buffer[offset + j] - 1;
+        // Only draw valid vertices
+        if (vertex_idx >= 0 && vertex_idx < vtx->vertex_count) {
+            poly->polyPoints[j].h = mode / 320 * vtx->x2d[vertex_idx];
+            poly->polyPoints[j].v = vtx->y2d[vertex_idx];
+            if (min_x == -1 || vtx->x2d[vertex_idx] < min_x) min_x = vtx->x2d[vertex_idx];
+            if (max_x == -1 || vtx->x2d[vertex_idx] > max_x) max_x = vtx->x2d[vertex_idx];
+            if (min_y == -1 || vtx->y2d[vertex_idx] < min_y) min_y = vtx->y2d[vertex_idx];
+            if (max_y == -1 || vtx->y2d[vertex_idx] > max_y) max_y = vtx->y2d[vertex_idx];
+        }
+    }
+    poly->polyBBox.h1 = min_x;
+    poly->polyBBox.v1 = min_y;
+    poly->polyBBox.h2 = max_x;
+    poly->polyBBox.v2 = max_y;
+}
+
+#if ENABLE_STATS && STATS_FILL_AREA
+static long polyPixelArea(DynamicPolygon* poly, int n) {
+    long area2 = 0;
+    int j;
+    for (j = 0; j < n; j++) {
+        int k = (j + 1 == n) ? 0 : j + 1;
+        area2 += (long)poly->polyPoints[j].h * poly->polyPoints[k].v -
+                 (long)poly->polyPoints[k].h * poly->polyPoints[j].v;
+    }
+    return (area2 < 0 ? -area2 : area2) / 2;
+}
+#endif
+
+static void paintFacePoly(Model3D* model, int face_id, Handle polyHandle) {
+    int frame = 1;
+    if (shade_mode) {
+        FillPoly(polyHandle, shade_patterns[faceShade(&model->faces, face_id)]);
+        frame = SHADE_FRAME;
+    } else {
+        FillPoly(polyHandle, useFillColor(model->faces.color[face_id]));
+    }
+    if (outline_mode == OUTLINE_FEATURE && model->edges.block != NULL) {
+        drawFeatureEdges(model, face_id);
+    } else if (frame) {
+        usePenColor(shade_mode ? 0 : FRAME_COLOR);
+        FramePoly(polyHandle);
+    }
+}
+
+static void faceScreenBounds(Model3D* model, const int* xs, const int* ys, int face_id,
+                             int* x0, int* y0, int* x1, int* y1) {
+    FaceArrays3D* faces = &model->faces;
+    VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[face_id]];
+    int j, n = faces->vertex_count[face_id];
+    
+    *x0 = *x1 = xs[idx[0] - 1];
+    *y0 = *y1 = ys[idx[0] - 1];
+    for (j = 1; j < n; j++) {
+        int x = xs[idx[j] - 1];
+        int y = ys[idx[j] - 1];
+        if (x < *x0) *x0 = x;
+        if (x > *x1) *x1 = x;
+        if (y < *y0) *y0 = y;
+        if (y > *y1) *y1 = y;
+    }
+    (*x1)++;  // FramePoly pen hangs one pixel right and below the outline
+    (*y1)++;
+}
+
+#ifdef __ORCAC__
+segment "GS3DRAST";    // Load segment: tiled, z-buffer and S-buffer rasterizers
+#endif
+
+/**
+ * TILE-BINNED RASTERIZATION
+ * =========================
  * 
- * PARAMETERS:
- *   vertices   : Array of vertices with coordinates in observer system
- *   faces      : Array of faces to process  
- *   face_count : Number of faces
+ * The sorted face list is bucketed into TILES_X x TILES_Y screen tiles by
+ * bounding box, keeping the depth order inside each bucket. Each tile is
+ * then drawn on its own with ClipRect set to the tile. Tiles do not
+ * overlap and each sees its faces in painter's order, so the image is
+ * pixel-identical to RENDER_PAINTER.
  * 
  * ALGORITHM:
- *   For each face:
- *   - Initialize z_min with very large value (9999.0)
- *   - Initialize display_flag as true (displayable)
- *   - For each vertex of the face:
- *     * Check if vertex is behind camera (zo <= 0)
- *     * If ANY vertex is behind camera, set display_flag = false
- *     * Update z_min with minimum zo value found (closest vertex)
- *   - Store both z_min and display_flag in the face structure
+ *   1. Count faces per tile (bounding box overlap), prefix sums
+ *   2. Second pass scatters face numbers into one shared bin array
+ *   3. Per tile: ClipRect, then build + paint its faces in order
  * 
- * CULLING LOGIC:
- *   - If ANY vertex has zo <= 0, the entire face is marked as non-displayable
- *   - This prevents rendering artifacts from perspective projection errors
- *   - Improves performance by eliminating faces early in the pipeline
+ * With GS3D_THREADS, step 3 instead hands the tiles to the pool
+ * (rasterTiles): each tile is filled into the software frame buffer,
+ * clipped to its rectangle, then the frame is presented. Tiles write
+ * disjoint pixels, so no locking is needed and the image equals the
+ * software painter's (checked by the render benchmark). Used in 320 mode
+ * with the plain FRAME_COLOR outlines and no shading, the cases rasterFace
+ * draws like paintFacePoly; otherwise the QuickDraw tiles run. The pool
+ * path does not poll the keyboard.
  * 
  * NOTES:
- *   - Must be called AFTER transformToObserver() or processModelFast()
- *   - Uses zo coordinates (observer system depth)
- *   - Lower z_min value means face is closer to camera (should draw first in painter's algorithm)
- *   - display_flag = 1 means visible, 0 means hidden (behind camera)
+ *   - Faces entirely off screen land in no tile and are not drawn at all
+ *   - tile_load_* report how uneven the bins are (largest vs average)
+ *   - Faces spanning several tiles are drawn once per tile (clipped), so
+ *     STAT_FACES_DRAWN counts tile draws in this mode; STAT_PIXELS_FILLED
+ *     (STATS_FILL_AREA) counts each face once, in its first drawn tile
+ *   - Bin positions are long: a face can land in every tile, so the
+ *     references outgrow 16 bits; past TILE_BINS_MAX the painter draws
  */
-void calculateFaceDepths(Model3D* model, Face3D* faces, int face_count) {
-    int i, j;
+static long tile_start[TILE_COUNT + 1];
+static int *tile_bins = NULL;
+static long tile_bins_capacity = 0;
+
+// Bins the first face_count sorted faces by their bounds in xs/ys over a
+// width x height target cut in TILES_X x TILES_Y tiles. Fills tile_start
+// and tile_bins; returns the number of references, -1 if they do not fit.
+static long tileBinFaces(Model3D* model, int face_count, const int* xs, const int* ys,
+                         int width, int height) {
+    FaceArrays3D* faces = &model->faces;
+    long tile_fill[TILE_COUNT];
+    long i, total = 0;
+    int t, pass, tx, ty, x0, y0, x1, y1;
+    int tile_w = width / TILES_X, tile_h = height / TILES_Y;
+    
+    memset(tile_fill, 0, sizeof(tile_fill));
+    // Pass 0 counts faces per tile, pass 1 scatters them (depth order kept)
+    for (pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (t = 0; t < TILE_COUNT; t++) {
+                tile_start[t] = total;
+                total += tile_fill[t];
+                tile_fill[t] = tile_start[t];  // Becomes the write cursor
+            }
+            tile_start[TILE_COUNT] = total;
+            if (total > TILE_BINS_MAX) return -1;
+            if (total > tile_bins_capacity) {
+                int *bins = (int*)realloc(tile_bins, (size_t)total * sizeof(int));
+                if (bins == NULL) {
+                    printf("Error: Unable to allocate tile bins\n");
+                    return -1;
+                }
+                tile_bins = bins;
+                tile_bins_capacity = total;
+            }
+        }
+        for (i = 0; i < face_count; i++) {
+            int face_id = faces->sorted_face_indices[i];
+            if (!FACE_VISIBLE(faces->display_flag, face_id) || faces->vertex_count[face_id] < 3) continue;
+            faceScreenBounds(model, xs, ys, face_id, &x0, &y0, &x1, &y1);
+            if (x1 < 0 || y1 < 0 || x0 >= width || y0 >= height) continue;
+            x0 = (x0 < 0) ? 0 : x0 / tile_w;
+            y0 = (y0 < 0) ? 0 : y0 / tile_h;
+            x1 = (x1 >= width) ? TILES_X - 1 : x1 / tile_w;
+            y1 = (y1 >= height) ? TILES_Y - 1 : y1 / tile_h;
+            if (x1 >= TILES_X) x1 = TILES_X - 1;  // Sizes not divisible by the tile count
+            if (y1 >= TILES_Y) y1 = TILES_Y - 1;
+            for (ty = y0; ty <= y1; ty++) {
+                for (tx = x0; tx <= x1; tx++) {
+                    if (pass == 0) tile_fill[ty * TILES_X + tx]++;
+                    else tile_bins[tile_fill[ty * TILES_X + tx]++] = face_id;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+int drawPolygonsTiled(Model3D* model, int face_count, Handle polyHandle) {
     VertexArrays3D* vtx = &model->vertices;
-    FaceArrays3D* face_arrays = &model->faces;
+    long i, total;
+    int t, tx, ty;
+    
+    total = tileBinFaces(model, face_count, vtx->x2d, vtx->y2d, 320, 200);
+    if (total < 0) return -1;
+    tile_load_max = 0;
+    tile_load_used = 0;
+    for (t = 0; t < TILE_COUNT; t++) {
+        long load = tile_start[t + 1] - tile_start[t];
+        if (load > tile_load_max) tile_load_max = load;
+        if (load > 0) tile_load_used++;
+    }
+    tile_load_total = total;
+    tile_load_raster = 0;
+    
+#if GS3D_THREADS && mode == 320
+    // Pool: tiles filled in parallel into the software frame buffer
+    if (drawTilesRaster(model) == 0) {
+        tile_load_raster = 1;
+        STATS_ADD(STAT_FACES_DRAWN, total);
+        return 0;
+    }
+#endif
+    
+    // Rasterize tile by tile
+    for (t = 0; t < TILE_COUNT; t++) {
+        if (tile_start[t] == tile_start[t + 1]) continue;
+        tx = t % TILES_X;
+        ty = t / TILES_X;
+        if (!dirtyClip(tx * TILE_W, ty * TILE_H, (tx + 1) * TILE_W, (ty + 1) * TILE_H)) {
+            continue;  // Tile outside the dirty rectangle
+        }
+        if (outline_mode == OUTLINE_FEATURE) {
+            outlineBeginPass(model, tile_bins + tile_start[t], tile_start[t + 1] - tile_start[t]);
+        }
+        for (i = tile_start[t]; i < tile_start[t + 1]; i++) {
+            buildFacePoly(model, tile_bins[i], (DynamicPolygon *)*polyHandle);
+            paintFacePoly(model, tile_bins[i], polyHandle);
+#if ENABLE_STATS && STATS_FILL_AREA
+            {
+                // Whole area once: in the first tile meeting bounds and dirty rectangle
+                int x0, y0, x1, y1;
+                faceScreenBounds(model, vtx->x2d, vtx->y2d, tile_bins[i], &x0, &y0, &x1, &y1);
+                if (x0 < dirty_x0) x0 = dirty_x0;
+                if (y0 < dirty_y0) y0 = dirty_y0;
+                if (x0 / TILE_W == tx && y0 / TILE_H == ty) {
+                    STATS_ADD(STAT_PIXELS_FILLED, polyPixelArea((DynamicPolygon *)*polyHandle,
+                                                                model->faces.vertex_count[tile_bins[i]]));
+                }
+            }
+#endif
+            if (RENDER_POLL_DUE(i) && renderPoll()) break;
+        }
+        if (frame_aborted) break;
+    }
+    STATS_ADD(STAT_FACES_DRAWN, total);
+    
+    dirtyClip(0, 0, 320, 200);
+    return 0;
+}
+
+// ============================================================================
+//                          SOFTWARE RASTERIZER
+// ============================================================================
+
+/**
+ * SOFTWARE SCANLINE RASTERIZER
+ * ============================
+ * 
+ * Used by the z-buffer render mode and the render benchmark. Faces are
+ * fan-triangulated and filled span by span into a FrameBuffer (one color
+ * index byte per pixel, optional 16-bit depth), then copied to the
+ * Super Hi-Res screen by fbPresent.
+ * 
+ * DEPTH KEY:
+ *   key = (znear / zo) / 2, 0..32767, larger = closer. 1/z is linear in
+ *   screen space, so interpolating it across a span is exact (z itself
+ *   is not). znear is the closest visible vertex of the frame, so the
+ *   whole 15-bit range covers the model and not the empty space in front.
+ *   Cleared depth is 0 (infinitely far).
+ * 
+ * PER TRIANGLE:
+ *   - Vertices sorted by y, edges walked in 16.16 with 32-bit increments
+ *   - Depth plane gradients dkey/dx, dkey/dy in 16.16 (one 64-bit divide)
+ *   - Spans cover pixels x with left <= x < right, rows y0 <= y < y2
+ *   - Vertices beyond +/- AREA_COORD_LIMIT are skipped (32-bit safety)
+ * 
+ * OUTLINES:
+ *   The color 7 frame of painter mode is drawn as depth-interpolated lines
+ *   accepted within ZBUF_EDGE_BIAS of the stored depth, so edges of hidden
+ *   faces stay hidden. They store their depth too: like the QuickDraw pen,
+ *   the frame covers a pixel beyond the fill on the right and bottom.
+ */
+static FrameBuffer frame_buffer;
+static int *raster_x = NULL;         // Vertex x in frame buffer pixels
+static int *raster_y = NULL;         // Vertex y in frame buffer pixels
+static Word *raster_key = NULL;      // Vertex depth key (see DEPTH KEY)
+static long raster_capacity = 0;
+static long overdraw_rasterized = 0;      // Last S-buffer frame: pixels a painter would write
+static long overdraw_covered = 0;         // Last S-buffer frame: pixels covered (each written once)
+static int wire_edges_drawn = 0;           // Last wireframe frame: unique edges drawn
+
+int fbReserve(FrameBuffer* fb, int width, int height, int with_depth) {
+    long pixels = (long)width * height;
+    
+    if (pixels > fb->capacity) {
+        fbRelease(fb);  // Depth and span lists are sized from the old capacity too
+        fb->color = (Byte*)malloc((size_t)pixels);
+        if (fb->color == NULL) {
+            fb->capacity = 0;
+            return -1;
+        }
+        fb->capacity = pixels;
+    }
+    if (with_depth && fb->depth == NULL) {
+        fb->depth = (Word*)malloc((size_t)fb->capacity * sizeof(Word));
+        if (fb->depth == NULL) return -1;
+    }
+    fb->width = width;
+    fb->height = height;
+    fb->clip_x0 = 0;
+    fb->clip_y0 = 0;
+    fb->clip_x1 = width;
+    fb->clip_y1 = height;
+    return 0;
+}
+
+void fbRelease(FrameBuffer* fb) {
+    if (fb->color != NULL) free(fb->color);
+    if (fb->depth != NULL) free(fb->depth);
+    if (fb->span_start != NULL) free(fb->span_start);
+    if (fb->span_end != NULL) free(fb->span_end);
+    if (fb->span_count != NULL) free(fb->span_count);
+    memset(fb, 0, sizeof(FrameBuffer));
+}
+
+void fbClear(FrameBuffer* fb, Byte color, int clear_depth) {
+    long pixels = (long)fb->width * fb->height;
+    memset(fb->color, color, (size_t)pixels);
+    if (clear_depth && fb->depth != NULL) {
+        memset(fb->depth, 0, (size_t)pixels * sizeof(Word));  // 0 = farthest
+    }
+}
+
+/**
+ * Copies a 320x200 frame buffer to the Super Hi-Res screen (320 mode:
+ * two 4-bit pixels per byte, left pixel in the high nibble).
+ */
+void fbPresent(FrameBuffer* fb) {
+    Byte *screen = drawing_offscreen ? offscreen_pixels : (Byte *)SHR_SCREEN;
+    int x, y;
     
-    for (i = 0; i < face_count; i++) {
-        Fixed32 z_min = FLOAT_TO_FIXED(9999.0);  // Initialize to very large value
-        int display_flag = 1;
-        
-        // Access indices from the packed buffer using the offset
-        int offset = face_arrays->vertex_indices_ptr[i];
-        for (j = 0; j < face_arrays->vertex_count[i]; j++) {
-            int vertex_idx = face_arrays->vertex_indices_buffer[offset + j] - 1;
-            if (vertex_idx >= 0) {
-                if (vtx->zo[vertex_idx] <= 0) display_flag = 0;
-                if (vtx->zo[vertex_idx] < z_min) z_min = vtx->zo[vertex_idx];  // Find minimum (closest)
-            }
+    if (fb->width != 320 || fb->height != 200) return;
+    // Outside the dirty rectangle both sides are background
+    for (y = dirty_y0; y < dirty_y1; y++) {
+        Byte *src = fb->color + (long)y * 320 + (dirty_x0 & ~1);
+        Byte *dst = screen + (long)y * 160;
+        for (x = dirty_x0 / 2; x < (dirty_x1 + 1) / 2; x++) {
+            dst[x] = (Byte)((src[0] << 4) | (src[1] & 0x0F));
+            src += 2;
         }
-        face_arrays->z_max[i] = z_min;  // Store minimum depth for sorting
-        face_arrays->display_flag[i] = display_flag;
     }
 }
 
 /**
- * FACE SORTING BY DEPTH (OPTIMIZED VERSION)
- * ==========================================
- * 
- * This function sorts faces in descending order of z_max depth
- * to implement the painter's algorithm. The farthest faces
- * (highest z_max) are placed first in the array to be
- * drawn first, and the nearest ones last.
- * 
- * PARAMETERS:
- *   faces      : Array of faces to sort
- *   face_count : Number of faces
+ * OFF-SCREEN FRAME
+ * ================
  * 
- * ALGORITHMS:
- *   - Insertion sort for small collections (< 10 faces) - O(n²) but fast
- *   - Quick sort (quicksort) for large collections - O(n log n) on average
- *   - Already sorted array detection to avoid unnecessary sorting - O(n)
+ * A frame is drawn into a QuickDraw port whose pixel image is a private
+ * buffer in the SHR layout, then copied to the screen in one pass: the
+ * user never sees a half-painted frame. The buffer outlives endgraph, so
+ * a redraw without geometry change (Space, H, C, unknown keys) is just
+ * startgraph + offscreenBlit. offscreen_valid is cleared whenever the
+ * picture changes (bigloop, shading toggle). An aborted frame (renderPoll)
+ * is neither shown nor used as the base of the next dirty rectangle.
  * 
- * OPTIMIZATIONS:
- *   - Adaptive threshold based on size
- *   - Pre-sort verification for already ordered arrays
- *   - Median-of-three pivoting for stable quicksort
+ * offscreenBegin returns -1 if the buffer cannot be allocated; drawing
+ * then goes to the screen as before.
  * 
- * NOTES:
- *   - Must be called AFTER calculateFaceDepths()
- *   - Sort order: descending z_max (farthest to nearest)
+ * DIRTY RECTANGLE:
+ *   Outside the bounds of the last frame the buffer is background, and
+ *   the new frame lies inside its own bounds. Only the union of the two
+ *   (dirty_x0..dirty_y1) is cleared, clipped and redrawn; drawPolygons
+ *   skips faces whose bounding box misses it, and fbPresent copies only
+ *   that region. A small move of a small model repaints a small area.
  */
-void sortFacesByDepth(Model3D* model, int face_count) {
-    // Sort faces by z_max in descending order (farthest to nearest)
-    // Optimized: insertion sort for small arrays, quicksort for large
+static GrafPort offscreen_port;
+static GrafPortPtr onscreen_port = NULL;
+
+// Bounds of the vertices in front of the observer, pen and rounding included
+static void frameScreenBounds(Model3D* model, int* x0, int* y0, int* x1, int* y1) {
+    VertexArrays3D* vtx = &model->vertices;
+    int i;
     
-    if (face_count <= 1) {
-        return;
+    *x0 = 320; *y0 = 200; *x1 = 0; *y1 = 0;
+    for (i = 0; i < vtx->vertex_count; i++) {
+        if (vtx->zo[i] <= 0) continue;
+        if (vtx->x2d[i] < *x0) *x0 = vtx->x2d[i];
+        if (vtx->y2d[i] < *y0) *y0 = vtx->y2d[i];
+        if (vtx->x2d[i] + 2 > *x1) *x1 = vtx->x2d[i] + 2;
+        if (vtx->y2d[i] + 2 > *y1) *y1 = vtx->y2d[i] + 2;
     }
+    if (*x0 < 0) *x0 = 0;
+    if (*y0 < 0) *y0 = 0;
+    if (*x0 & 1) (*x0)--;               // Whole bytes of the pixel image
+    if (*x1 > 320) *x1 = 320;
+    if (*y1 > 200) *y1 = 200;
+    if (*x1 < *x0) *x1 = *x0;
+    if (*y1 < *y0) *y1 = *y0;
+}
+
+// Clips QuickDraw to a logical rectangle intersected with the dirty one
+int dirtyClip(int x0, int y0, int x1, int y1) {
+    Rect r;
+    if (x0 < dirty_x0) x0 = dirty_x0;
+    if (y0 < dirty_y0) y0 = dirty_y0;
+    if (x1 > dirty_x1) x1 = dirty_x1;
+    if (y1 > dirty_y1) y1 = dirty_y1;
+    if (x0 >= x1 || y0 >= y1) return 0;
+    SetRect(&r, mode / 320 * x0, y0, mode / 320 * x1, y1);
+    ClipRect(&r);
+    return 1;
+}
+
+int offscreenBegin(Model3D* model) {
+    LocInfo loc;
+    int x0, y0, x1, y1, y;
     
-    FaceArrays3D* faces = &model->faces;
-    
-    // For small arrays (<=16), use insertion sort (faster due to low overhead)
-    if (face_count <= 16) {
-        sortFacesByDepth_insertion(faces, face_count);
+    if (offscreen_pixels == NULL) {
+        // QuickDraw pixel image: fixed, locked, page aligned, within one bank
+        offscreen_handle = NewHandle((long)SHR_PIXEL_BYTES, userid(),
+                                     attrLocked | attrFixed | attrNoCross | attrPage, 0L);
+        if (offscreen_handle == NULL) return -1;
+        offscreen_pixels = (Byte*)*offscreen_handle;
+        offscreen_have_frame = 0;
+    }
+    frameScreenBounds(model, &x0, &y0, &x1, &y1);
+    if (offscreen_have_frame) {
+        dirty_x0 = (x0 < prev_x0) ? x0 : prev_x0;
+        dirty_y0 = (y0 < prev_y0) ? y0 : prev_y0;
+        dirty_x1 = (x1 > prev_x1) ? x1 : prev_x1;
+        dirty_y1 = (y1 > prev_y1) ? y1 : prev_y1;
     } else {
-        // For larger arrays, use quicksort
-        sortFacesByDepth_quicksort(faces, 0, face_count - 1);
+        dirty_x0 = 0; dirty_y0 = 0; dirty_x1 = 320; dirty_y1 = 200;
+    }
+    prev_x0 = x0; prev_y0 = y0; prev_x1 = x1; prev_y1 = y1;
+    offscreen_have_frame = 0;  // Until offscreenEnd: a partial frame is no base
+    
+    // What startgraph does to the screen, on the dirty rows and bytes only
+    for (y = dirty_y0; y < dirty_y1; y++) {
+        memset(offscreen_pixels + (long)y * 160 + dirty_x0 / 2, 0, (size_t)((dirty_x1 - dirty_x0 + 1) / 2));
     }
+    dirty_pixels = (long)(dirty_x1 - dirty_x0) * (dirty_y1 - dirty_y0);
+    STATS_ADD(STAT_PIXELS_REPAINTED, dirty_pixels);
+    
+    onscreen_port = GetPort();
+    OpenPort(&offscreen_port);
+    loc.portSCB = (mode == 640) ? 0x80 : 0x00;
+    loc.ptrToPixImage = (Pointer)offscreen_pixels;
+    loc.width = 160;
+    SetRect(&loc.boundsRect, 0, 0, mode, 200);
+    SetPortLoc(&loc);
+    SetPort(&offscreen_port);
+    dirtyClip(0, 0, 320, 200);
+    drawing_offscreen = 1;
+    return 0;
 }
 
-// Helper macro to swap face indices in the sorted_face_indices array
-// (We swap indices, not the faces themselves, to keep the buffer intact)
-#define SWAP_FACE(faces, i, j) \
-    do { \
-        int temp_idx = faces->sorted_face_indices[i]; \
-        faces->sorted_face_indices[i] = faces->sorted_face_indices[j]; \
-        faces->sorted_face_indices[j] = temp_idx; \
-    } while (0)
+void offscreenEnd(void) {
+    SetPort(onscreen_port);
+    ClosePort(&offscreen_port);
+    drawing_offscreen = 0;
+    offscreen_have_frame = !frame_aborted;
+    dirty_x0 = 0; dirty_y0 = 0; dirty_x1 = 320; dirty_y1 = 200;
+}
+
+void offscreenBlit(void) {
+    memcpy((Byte *)SHR_SCREEN, offscreen_pixels, (size_t)SHR_PIXEL_BYTES);
+}
+
+int rasterReserve(long vertex_count) {
+    if (vertex_count > raster_capacity) {
+        if (raster_x != NULL) free(raster_x);
+        if (raster_y != NULL) free(raster_y);
+        if (raster_key != NULL) free(raster_key);
+        raster_x = (int*)malloc((size_t)vertex_count * sizeof(int));
+        raster_y = (int*)malloc((size_t)vertex_count * sizeof(int));
+        raster_key = (Word*)malloc((size_t)vertex_count * sizeof(Word));
+        if (raster_x == NULL || raster_y == NULL || raster_key == NULL) {
+            raster_capacity = 0;
+            return -1;
+        }
+        raster_capacity = vertex_count;
+    }
+    return 0;
+}
 
 /**
- * Insertion sort for small arrays (optimized for sorted_face_indices)
- * Now we sort indices by comparing their depth values (z_max)
+ * Projects the current frame into frame buffer coordinates (scaled from
+ * the 320x200 x2d/y2d) and computes the depth key of every vertex.
  */
-void sortFacesByDepth_insertion(FaceArrays3D* faces, int face_count) {
-    int i, j;
+int rasterPrepareVertices(Model3D* model, FrameBuffer* fb) {
+    VertexArrays3D* vtx = &model->vertices;
+    Fixed32 znear = 0;
+    int i;
     
-    for (i = 1; i < face_count; i++) {
-        int face_i = faces->sorted_face_indices[i];
-        int face_prev = faces->sorted_face_indices[i - 1];
-        
-        // If already in order (descending), skip
-        if (faces->z_max[face_i] <= faces->z_max[face_prev]) {
-            continue;
+    if (rasterReserve(vtx->vertex_count) < 0) return -1;
+    
+    for (i = 0; i < vtx->vertex_count; i++) {
+        if (vtx->zo[i] > 0 && (znear == 0 || vtx->zo[i] < znear)) znear = vtx->zo[i];
+    }
+    
+    for (i = 0; i < vtx->vertex_count; i++) {
+        if (fb->width == 320) {
+            raster_x[i] = vtx->x2d[i];
+            raster_y[i] = vtx->y2d[i];
+        } else {
+            raster_x[i] = (int)((long)vtx->x2d[i] * fb->width / 320);
+            raster_y[i] = (int)((long)vtx->y2d[i] * fb->height / 200);
         }
-        
-        // Find insertion position
-        j = i - 1;
-        while (j >= 0) {
-            int face_j = faces->sorted_face_indices[j];
-            if (faces->z_max[face_j] >= faces->z_max[face_i]) break;
-            // Shift index right
-            SWAP_FACE(faces, j + 1, j);
-            j--;
+        if (vtx->zo[i] > 0) {
+            Fixed32 ratio = FIXED_DIV_64(znear, vtx->zo[i]);  // 0 < ratio <= 1.0
+            raster_key[i] = (Word)((ratio >= FIXED_ONE) ? 32767 : (ratio >> 1));
+        } else {
+            raster_key[i] = 0;
         }
-        
-        // Insert at position j+1
-        faces->sorted_face_indices[j + 1] = face_i;
     }
+    return 0;
 }
 
 /**
- * Quicksort for large arrays
+ * S-BUFFER (SPAN COVERAGE)
+ * ========================
+ * 
+ * Faces arrive front to back. Each row keeps its covered pixels as sorted,
+ * disjoint [start, end) intervals. A new span is clipped against them: only
+ * the gaps are written, then the span and every interval it touches are
+ * merged into one. A pixel is therefore written once, by the closest face.
  */
-void sortFacesByDepth_quicksort(FaceArrays3D* faces, int low, int high) {
-    if (low < high) {
-        // For small partitions, use insertion sort
-        if (high - low <= 16) {
-            sortFacesByDepth_insertion_range(faces, low, high);
-            return;
+int sbufReserve(FrameBuffer* fb) {
+    int row_capacity = fb->width / 2 + 1;
+    
+    if (fb->span_count != NULL && fb->span_row_capacity >= row_capacity) return 0;
+    if (fb->span_start != NULL) free(fb->span_start);
+    if (fb->span_end != NULL) free(fb->span_end);
+    if (fb->span_count != NULL) free(fb->span_count);
+    fb->span_start = (Word*)malloc((size_t)fb->capacity / fb->width * row_capacity * sizeof(Word));
+    fb->span_end = (Word*)malloc((size_t)fb->capacity / fb->width * row_capacity * sizeof(Word));
+    fb->span_count = (int*)malloc((size_t)fb->capacity / fb->width * sizeof(int));
+    if (fb->span_start == NULL || fb->span_end == NULL || fb->span_count == NULL) {
+        if (fb->span_start != NULL) free(fb->span_start);
+        if (fb->span_end != NULL) free(fb->span_end);
+        if (fb->span_count != NULL) free(fb->span_count);
+        fb->span_start = fb->span_end = NULL;
+        fb->span_count = NULL;
+        fb->span_row_capacity = 0;
+        return -1;
+    }
+    fb->span_row_capacity = row_capacity;
+    return 0;
+}
+
+static void sbufClear(FrameBuffer* fb) {
+    memset(fb->span_count, 0, (size_t)fb->height * sizeof(int));
+    fb->pixels_covered = 0;
+}
+
+static void sbufInsert(FrameBuffer* fb, int y, int left, int right, Byte color) {
+    long row = (long)y * fb->span_row_capacity;
+    Word *start = fb->span_start + row;
+    Word *end = fb->span_end + row;
+    int n = fb->span_count[y];
+    int i = 0, j, cur = left, merged_left = left, merged_right = right;
+    int written = 0;
+    Byte *pix = fb->color + (long)y * fb->width;
+    
+    fb->pixels_rasterized += right - left;
+    while (i < n && end[i] < left) i++;          // Entirely left of the span
+    
+    // Intervals overlapping or touching [left, right): write the gaps
+    for (j = i; j < n && start[j] <= right; j++) {
+        if (start[j] > cur) {
+            memset(pix + cur, color, (size_t)(start[j] - cur));
+            written += start[j] - cur;
         }
-        
-        // Partition and recursively sort
-        int pivot_index = sortFacesByDepth_partition(faces, low, high);
-        sortFacesByDepth_quicksort(faces, low, pivot_index - 1);
-        sortFacesByDepth_quicksort(faces, pivot_index + 1, high);
+        if (end[j] > cur) cur = end[j];
+        if (start[j] < merged_left) merged_left = start[j];
+        if (end[j] > merged_right) merged_right = end[j];
     }
+    if (cur < right) {
+        memset(pix + cur, color, (size_t)(right - cur));
+        written += right - cur;
+    }
+    fb->pixels_written += written;
+    fb->pixels_covered += written;
+    
+    // Replace intervals i..j-1 by the merged one
+    if (j - i != 1) {
+        memmove(start + i + 1, start + j, (size_t)(n - j) * sizeof(Word));
+        memmove(end + i + 1, end + j, (size_t)(n - j) * sizeof(Word));
+        fb->span_count[y] = n - (j - i) + 1;
+    }
+    start[i] = (Word)merged_left;
+    end[i] = (Word)merged_right;
 }
 
-/**
- * Insertion sort for a range (used by quicksort)
- */
-void sortFacesByDepth_insertion_range(FaceArrays3D* faces, int low, int high) {
-    int i, j;
+static void rasterTriangle(FrameBuffer* fb, int a, int b, int c, Byte color, int raster_op) {
+    int xa = raster_x[a], ya = raster_y[a], za = raster_key[a];
+    int xb = raster_x[b], yb = raster_y[b], zb = raster_key[b];
+    int xc = raster_x[c], yc = raster_y[c], zc = raster_key[c];
+    int t, y, y_start, y_end;
+    long area2;
+    Fixed32 dzdx, dzdy, x_long, dx_long, x_short, dx_short;
     
-    for (i = low + 1; i <= high; i++) {
-        int face_i = faces->sorted_face_indices[i];
-        int face_prev = faces->sorted_face_indices[i - 1];
+    if (xa > AREA_COORD_LIMIT || xa < -AREA_COORD_LIMIT || ya > AREA_COORD_LIMIT || ya < -AREA_COORD_LIMIT ||
+        xb > AREA_COORD_LIMIT || xb < -AREA_COORD_LIMIT || yb > AREA_COORD_LIMIT || yb < -AREA_COORD_LIMIT ||
+        xc > AREA_COORD_LIMIT || xc < -AREA_COORD_LIMIT || yc > AREA_COORD_LIMIT || yc < -AREA_COORD_LIMIT) {
+        return;
+    }
+    
+    // Sort by y: a top, c bottom
+    if (yb < ya) { t = xa; xa = xb; xb = t; t = ya; ya = yb; yb = t; t = za; za = zb; zb = t; }
+    if (yc < ya) { t = xa; xa = xc; xc = t; t = ya; ya = yc; yc = t; t = za; za = zc; zc = t; }
+    if (yc < yb) { t = xb; xb = xc; xc = t; t = yb; yb = yc; yc = t; t = zb; zb = zc; zc = t; }
+    if (ya == yc) return;
+    
+    area2 = (long)(xb - xa) * (yc - ya) - (long)(xc - xa) * (yb - ya);
+    if (area2 == 0) return;
+    dzdx = (Fixed32)((((Fixed64)((long)(zb - za) * (yc - ya) - (long)(zc - za) * (yb - ya))) << FIXED_SHIFT) / area2);
+    dzdy = (Fixed32)((((Fixed64)((long)(zc - za) * (xb - xa) - (long)(zb - za) * (xc - xa))) << FIXED_SHIFT) / area2);
+    
+    // Rows are positioned from ya, not stepped from the clip edge: a clipped
+    // triangle produces the same spans as the whole one
+    y_start = (ya < fb->clip_y0) ? fb->clip_y0 : ya;
+    y_end = (yc > fb->clip_y1) ? fb->clip_y1 : yc;  // Exclusive
+    if (y_start >= y_end) return;
+    
+    // Long edge a->c, positioned on the first row
+    dx_long = (Fixed32)(((long)(xc - xa) << FIXED_SHIFT) / (yc - ya));
+    x_long = (Fixed32)(((Fixed64)xa << FIXED_SHIFT) + (Fixed64)dx_long * (y_start - ya));
+    x_short = 0;
+    dx_short = 0;
+    
+    for (y = y_start; y < y_end; y++) {
+        Fixed32 left, right, z;
+        int x, x_left, x_right;
+        long row = (long)y * fb->width;
         
-        if (faces->z_max[face_i] <= faces->z_max[face_prev]) {
-            continue;
+        // Short edge: a->b above yb, b->c below (re-seeded on the switch)
+        if (y == y_start || y == yb) {
+            if (y < yb) {
+                dx_short = (Fixed32)(((long)(xb - xa) << FIXED_SHIFT) / (yb - ya));
+                x_short = (Fixed32)(((Fixed64)xa << FIXED_SHIFT) + (Fixed64)dx_short * (y - ya));
+            } else {
+                dx_short = (Fixed32)(((long)(xc - xb) << FIXED_SHIFT) / (yc - yb));
+                x_short = (Fixed32)(((Fixed64)xb << FIXED_SHIFT) + (Fixed64)dx_short * (y - yb));
+            }
         }
         
-        j = i - 1;
-        while (j >= low) {
-            int face_j = faces->sorted_face_indices[j];
-            if (faces->z_max[face_j] >= faces->z_max[face_i]) break;
-            // Shift index right
-            SWAP_FACE(faces, j + 1, j);
-            j--;
+        if (x_long < x_short) { left = x_long; right = x_short; }
+        else { left = x_short; right = x_long; }
+        x_left = (int)((left + FIXED_MASK) >> FIXED_SHIFT);       // ceil
+        x_right = (int)((right + FIXED_MASK) >> FIXED_SHIFT);     // ceil, exclusive
+        if (x_left < fb->clip_x0) x_left = fb->clip_x0;
+        if (x_right > fb->clip_x1) x_right = fb->clip_x1;
+        
+        if (x_left < x_right && raster_op == RASTER_SBUFFER) {
+            sbufInsert(fb, y, x_left, x_right, color);
+        } else if (x_left < x_right) {
+            Byte *pix = fb->color + row + x_left;
+            fb->pixels_rasterized += x_right - x_left;
+            if (raster_op == RASTER_ZTEST) {
+                Word *depth = fb->depth + row + x_left;
+                // Depth at the first pixel from the plane equation (once per span)
+                z = (Fixed32)(((Fixed64)za << FIXED_SHIFT) + (Fixed64)dzdx * (x_left - xa)
+                              + (Fixed64)dzdy * (y - ya));
+                for (x = x_left; x < x_right; x++) {
+                    Word key = (Word)((z < 0) ? 0 : (z >> FIXED_SHIFT));
+                    if (key > *depth) {
+                        *depth = key;
+                        *pix = color;
+                        fb->pixels_written++;
+                    }
+                    depth++;
+                    pix++;
+                    z += dzdx;
+                }
+            } else {
+                memset(pix, color, (size_t)(x_right - x_left));
+                fb->pixels_written += x_right - x_left;
+            }
         }
         
-        // Insert at position j+1
-        faces->sorted_face_indices[j + 1] = face_i;
+        x_long += dx_long;
+        x_short += dx_short;
+    }
+}
+
+static void rasterLine(FrameBuffer* fb, int a, int b, Byte color, int raster_op) {
+    int x = raster_x[a], y = raster_y[a];
+    int x1 = raster_x[b], y1 = raster_y[b];
+    int dx = (x1 > x) ? x1 - x : x - x1;
+    int dy = (y1 > y) ? y1 - y : y - y1;
+    int sx = (x1 > x) ? 1 : -1;
+    int sy = (y1 > y) ? 1 : -1;
+    int steps = (dx > dy) ? dx : dy;
+    int err = dx - dy;
+    Fixed32 z = (Fixed32)raster_key[a] << FIXED_SHIFT;
+    Fixed32 dz = (steps > 0) ? (((Fixed32)raster_key[b] - raster_key[a]) << FIXED_SHIFT) / steps : 0;
+    int i;
+    
+    if (steps > AREA_COORD_LIMIT) return;
+    for (i = 0; i <= steps; i++) {
+        if (x >= fb->clip_x0 && x < fb->clip_x1 && y >= fb->clip_y0 && y < fb->clip_y1) {
+            long p = (long)y * fb->width + x;
+            if (raster_op == RASTER_PAINT) {
+                fb->color[p] = color;
+            } else if (raster_op == RASTER_SBUFFER) {
+                sbufInsert(fb, y, x, x + 1, color);
+            } else {
+                Word key = (Word)(z >> FIXED_SHIFT);
+                if ((long)key + ZBUF_EDGE_BIAS >= fb->depth[p]) {
+                    fb->color[p] = color;
+                    if (key > fb->depth[p]) fb->depth[p] = key;  // Frame pixels outside the fill belong to the face
+                }
+            }
+        }
+        if (2 * err > -dy) { err -= dy; x += sx; }
+        if (2 * err < dx) { err += dx; y += sy; }
+        z += dz;
     }
 }
 
 /**
- * Partition function for quicksort (median-of-three pivot)
+ * Fills one face (fan triangulation) with its color and frames it with
+ * FRAME_COLOR, like paintFacePoly. Front to back (RASTER_SBUFFER) the frame
+ * goes first, since it lies on top of its own fill.
  */
-int sortFacesByDepth_partition(FaceArrays3D* faces, int low, int high) {
-    // Median-of-three for better pivot selection
-    int mid = low + (high - low) / 2;
+void rasterFace(FrameBuffer* fb, Model3D* model, int face_id, int raster_op) {
+    FaceArrays3D* faces = &model->faces;
+    VertexIndex *idx = &faces->vertex_indices_buffer[faces->vertex_indices_ptr[face_id]];
+    int j, n = faces->vertex_count[face_id];
     
-    int face_low = faces->sorted_face_indices[low];
-    int face_mid = faces->sorted_face_indices[mid];
-    int face_high = faces->sorted_face_indices[high];
+    if (raster_op == RASTER_SBUFFER) {
+        for (j = 0; j < n; j++) {
+            rasterLine(fb, idx[j] - 1, idx[(j + 1 == n) ? 0 : j + 1] - 1, FRAME_COLOR, raster_op);
+        }
+    }
+    for (j = 1; j + 1 < n; j++) {
+        rasterTriangle(fb, idx[0] - 1, idx[j] - 1, idx[j + 1] - 1, faces->color[face_id], raster_op);
+    }
+    if (raster_op != RASTER_SBUFFER) {
+        for (j = 0; j < n; j++) {
+            rasterLine(fb, idx[j] - 1, idx[(j + 1 == n) ? 0 : j + 1] - 1, FRAME_COLOR, raster_op);
+        }
+    }
+}
+
+/**
+ * Paints the tiles binned by tileBinFaces over this buffer's size, one
+ * tile per pool chunk: a tile task draws through its own copy of fb,
+ * clipped to the tile, with its own counters. Tiles never share a pixel
+ * and keep their faces in painter's order, so the frame equals one
+ * RASTER_PAINT pass over the sorted list. Returns the pixels written.
+ */
+typedef struct {
+    FrameBuffer* fb;
+    Model3D* model;
+    long written[TILE_COUNT];
+} TileJob;
+
+static void tileTask(void* arg, int tile) {
+    TileJob* job = (TileJob*)arg;
+    FrameBuffer view = *job->fb;
+    int tile_w = view.width / TILES_X, tile_h = view.height / TILES_Y;
+    int tx = tile % TILES_X, ty = tile / TILES_X;
+    long i;
     
-    if (faces->z_max[face_low] < faces->z_max[face_mid]) {
-        SWAP_FACE(faces, low, mid);
+    // Same tile edges as tileBinFaces: the last row and column take the remainder
+    view.clip_x0 = tx * tile_w;
+    view.clip_y0 = ty * tile_h;
+    view.clip_x1 = (tx == TILES_X - 1) ? view.width : view.clip_x0 + tile_w;
+    view.clip_y1 = (ty == TILES_Y - 1) ? view.height : view.clip_y0 + tile_h;
+    view.pixels_written = 0;
+    for (i = tile_start[tile]; i < tile_start[tile + 1]; i++) {
+        rasterFace(&view, job->model, tile_bins[i], RASTER_PAINT);
     }
-    if (faces->z_max[faces->sorted_face_indices[low]] < faces->z_max[face_high]) {
-        SWAP_FACE(faces, low, high);
+    job->written[tile] = view.pixels_written;
+}
+
+long rasterTiles(FrameBuffer* fb, Model3D* model) {
+    static TileJob job;
+    long written = 0;
+    int t;
+    
+    job.fb = fb;
+    job.model = model;
+#if GS3D_THREADS
+    poolRun(tileTask, &job, TILE_COUNT);
+#else
+    for (t = 0; t < TILE_COUNT; t++) tileTask(&job, t);
+#endif
+    for (t = 0; t < TILE_COUNT; t++) written += job.written[t];
+    return written;
+}
+
+// Only where rasterFace draws what paintFacePoly would: no shading, plain
+// FRAME_COLOR outlines, 320 mode (fbPresent)
+int drawTilesRaster(Model3D* model) {
+#if mode == 320
+    if (shade_mode || outline_mode == OUTLINE_FEATURE) return -1;
+    if (fbReserve(&frame_buffer, 320, 200, 0) < 0 || rasterPrepareVertices(model, &frame_buffer) < 0) {
+        return -1;
     }
-    if (faces->z_max[faces->sorted_face_indices[mid]] < faces->z_max[faces->sorted_face_indices[high]]) {
-        SWAP_FACE(faces, mid, high);
+    fbClear(&frame_buffer, 0, 0);
+    STATS_ADD(STAT_PIXELS_FILLED, rasterTiles(&frame_buffer, model));
+    fbPresent(&frame_buffer);
+    return 0;
+#else
+    (void)model;
+    return -1;
+#endif
+}
+
+/**
+ * Decides before the sort whether the z-buffer will draw this frame: the
+ * mode is selected, the screen is 320 mode (fbPresent) and the buffers are
+ * reserved. When it returns 0 drawPolygons falls back to the QuickDraw
+ * painter, so the frame must be sorted.
+ */
+int zbufferReady(Model3D* model) {
+#if mode == 320
+    if (render_mode != RENDER_ZBUFFER) return 0;
+    if (fbReserve(&frame_buffer, 320, 200, 1) < 0) return 0;
+    return rasterReserve(model->vertices.vertex_count) == 0;
+#else
+    (void)model;
+    return 0;
+#endif
+}
+
+/**
+ * Z-BUFFER RENDER MODE
+ * ====================
+ * 
+ * Visible faces in any order (the sort is skipped in this mode), depth
+ * tested per pixel, then presented. Interpenetrating faces resolve per
+ * pixel instead of per face.
+ */
+int drawPolygonsZBuffer(Model3D* model, int face_count) {
+    FaceArrays3D* faces = &model->faces;
+    int i;
+    
+    if (fbReserve(&frame_buffer, 320, 200, 1) < 0 || rasterPrepareVertices(model, &frame_buffer) < 0) {
+        return -1;
+    }
+    fbClear(&frame_buffer, 0, 1);
+    frame_buffer.pixels_written = 0;
+    for (i = 0; i < face_count; i++) {
+        int face_id = faces->sorted_face_indices[i];
+        if (!FACE_VISIBLE(faces->display_flag, face_id) || faces->vertex_count[face_id] < 3) continue;
+        rasterFace(&frame_buffer, model, face_id, RASTER_ZTEST);
+        STATS_ADD(STAT_FACES_DRAWN, 1);
+        if (RENDER_POLL_DUE(i) && renderPoll()) return 0;
+    }
+    STATS_ADD(STAT_PIXELS_FILLED, frame_buffer.pixels_written);
+    fbPresent(&frame_buffer);
+    return 0;
+}
+
+/**
+ * S-BUFFER RENDER MODE
+ * ====================
+ * 
+ * The painter's sorted list walked backwards (nearest first) through the
+ * span coverage lists. Stops as soon as every pixel is covered. The ratio
+ * of span pixels produced (what painter mode would write) to the pixels
+ * the faces cover, not to the whole frame, is the overdraw factor
+ * S-buffer saved this frame: background pixels are not drawn by either.
+ */
+int drawPolygonsSBuffer(Model3D* model, int face_count) {
+    FaceArrays3D* faces = &model->faces;
+    long screen_pixels = 320L * 200L;
+    int i;
+    
+    if (fbReserve(&frame_buffer, 320, 200, 0) < 0 || sbufReserve(&frame_buffer) < 0 ||
+        rasterPrepareVertices(model, &frame_buffer) < 0) {
+        return -1;
+    }
+    fbClear(&frame_buffer, 0, 0);
+    sbufClear(&frame_buffer);
+    frame_buffer.pixels_rasterized = 0;
+    frame_buffer.pixels_written = 0;
+    for (i = face_count - 1; i >= 0 && frame_buffer.pixels_covered < screen_pixels; i--) {
+        int face_id = faces->sorted_face_indices[i];
+        if (!FACE_VISIBLE(faces->display_flag, face_id) || faces->vertex_count[face_id] < 3) continue;
+        rasterFace(&frame_buffer, model, face_id, RASTER_SBUFFER);
+        STATS_ADD(STAT_FACES_DRAWN, 1);
+        if (RENDER_POLL_DUE(i) && renderPoll()) return 0;
+    }
+    overdraw_rasterized = frame_buffer.pixels_rasterized;
+    overdraw_covered = frame_buffer.pixels_covered;
+    STATS_ADD(STAT_PIXELS_FILLED, frame_buffer.pixels_written);
+    fbPresent(&frame_buffer);
+    return 0;
+}
+
+/**
+ * WIREFRAME RENDER MODE
+ * =====================
+ * 
+ * FramePoly on every face strokes each shared edge twice. Here the unique
+ * edge list is walked once: an edge is drawn when at least one adjacent
+ * face survived culling and both ends are in front of the observer. In
+ * 320 mode lines go through rasterLine into the frame buffer (one present
+ * per frame); otherwise, or if the buffer cannot be allocated, QuickDraw
+ * MoveTo/LineTo.
+ */
+void drawPolygonsWireframe(Model3D* model) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    EdgeArrays3D* edges = &model->edges;
+    int use_fb = 0;
+    int e;
+    
+#if mode == 320
+    if (fbReserve(&frame_buffer, 320, 200, 0) == 0 && rasterPrepareVertices(model, &frame_buffer) == 0) {
+        fbClear(&frame_buffer, 0, 0);
+        use_fb = 1;
+    }
+#endif
+    if (!use_fb) usePenColor(FRAME_COLOR);
+    
+    wire_edges_drawn = 0;
+    for (e = 0; e < edges->edge_count; e++) {
+        int a = edges->v0[e] - 1;
+        int b = edges->v1[e] - 1;
+        int f1 = edges->face1[e];
+        if (!FACE_VISIBLE(faces->display_flag, edges->face0[e]) &&
+            (f1 < 0 || !FACE_VISIBLE(faces->display_flag, f1))) continue;
+        if (vtx->zo[a] <= 0 || vtx->zo[b] <= 0) continue;
+        if (use_fb) {
+            rasterLine(&frame_buffer, a, b, FRAME_COLOR, RASTER_PAINT);
+        } else {
+            MoveTo(mode / 320 * vtx->x2d[a], vtx->y2d[a]);
+            LineTo(mode / 320 * vtx->x2d[b], vtx->y2d[b]);
+        }
+        wire_edges_drawn++;
+        if (RENDER_POLL_DUE(wire_edges_drawn) && renderPoll()) return;
+    }
+    if (use_fb) fbPresent(&frame_buffer);
+}
+
+#ifdef __ORCAC__
+segment "GS3DBENCH";   // Load segment: benchmark and checks
+#endif
+
+/**
+ * RENDER BENCHMARK: PAINT VERSUS Z-BUFFER VERSUS S-BUFFER
+ * =======================================================
+ * 
+ * For every model of BENCH_MODELS and every resolution of bench_sizes,
+ * renders BENCH_FRAMES views (angle_h stepped by 360 / BENCH_FRAMES) with
+ * the software rasterizer in both modes:
+ *   paint   : calculateFaceDepths + sortFacesByDepth + fill back to front
+ *   zbuffer : calculateFaceDepths (culling only) + depth-tested fill
+ *   sbuffer : calculateFaceDepths + sortFacesByDepth + front-to-back spans
+ * The transform is shared and not timed. Results go to the screen and to
+ * BENCH_FILE. Models missing from the disk are skipped.
+ * 
+ * Front to back through span coverage must give the painter's image: the
+ * "Same" column counts the views whose S-buffer frame checksum (untimed)
+ * equals the painter's. Tiles must too: after each painter frame the
+ * same view is binned and painted tile by tile (rasterTiles, untimed, on
+ * the pool threads with GS3D_THREADS) and compared pixel by pixel. The
+ * "Tiled" column counts the identical views.
+ */
+static const char* bench_models[] = { BENCH_MODELS };
+static const int bench_sizes[][2] = { {160, 100}, {320, 200}, {640, 400} };
+
+static unsigned long benchChecksum(FrameBuffer* fb) {
+    long pixels = (long)fb->width * fb->height, p;
+    unsigned long sum = 0;
+    for (p = 0; p < pixels; p++) sum = sum * 31 + fb->color[p];
+    return sum;
+}
+
+static long benchRenderPass(Model3D* model, FrameBuffer* fb, ObserverParams* params, int raster_op,
+                            unsigned long* sums, FrameBuffer* tiled, int* tiled_same) {
+    ObserverParams view = *params;
+    long ticks = 0;
+    int f, i;
+    
+    for (f = 0; f < BENCH_FRAMES; f++) {
+        long start;
+        view.angle_h = params->angle_h + INT_TO_FIXED(f * (360 / BENCH_FRAMES));
+        transformVertices(model, &view);
+        
+        start = GetTick();
+        calculateFaceDepths(model, NULL, model->faces.face_count);
+        for (i = 0; i < model->faces.face_count; i++) {
+            model->faces.sorted_face_indices[i] = i;
+        }
+        if (raster_op != RASTER_ZTEST) sortFacesByDepth(model, model->faces.face_count);
+        rasterPrepareVertices(model, fb);
+        fbClear(fb, 0, raster_op == RASTER_ZTEST);
+        if (raster_op == RASTER_SBUFFER) sbufClear(fb);
+        for (i = 0; i < model->faces.face_count; i++) {
+            // S-buffer walks the sorted list nearest first
+            int face_id = model->faces.sorted_face_indices[(raster_op == RASTER_SBUFFER) ? model->faces.face_count - 1 - i : i];
+            if (!FACE_VISIBLE(model->faces.display_flag, face_id)) continue;
+            rasterFace(fb, model, face_id, raster_op);
+        }
+        ticks += GetTick() - start;
+        sums[f] = benchChecksum(fb);
+        if (tiled != NULL) {
+            fbClear(tiled, 0, 0);
+            if (tileBinFaces(model, model->faces.face_count, raster_x, raster_y, tiled->width, tiled->height) >= 0) {
+                rasterTiles(tiled, model);
+                if (memcmp(tiled->color, fb->color, (size_t)fb->width * fb->height) == 0) (*tiled_same)++;
+            }
+        }
     }
+    return ticks;
+}
+
+void runRenderBenchmark(ObserverParams* params) {
+    FILE *out = fopen(BENCH_FILE, "w");
+    FrameBuffer fb, tiled;
+    int m, r;
     
-    // Use median (now at low) as pivot
-    Fixed32 pivot = faces->z_max[faces->sorted_face_indices[low]];
-    SWAP_FACE(faces, low, high);  // Move pivot to end
+    memset(&fb, 0, sizeof(fb));
+    memset(&tiled, 0, sizeof(tiled));
+    printf("Render benchmark, %d views per model (ticks, 60 per second)\n", BENCH_FRAMES);
+    printf("%-12s %-8s %5s %7s %7s %7s %5s %5s\n", "Model", "Size", "Faces", "Paint", "Z-buf", "S-buf", "Same", "Tiled");
+    if (out != NULL) {
+        fprintf(out, "model,width,height,faces,paint_ticks,zbuffer_ticks,sbuffer_ticks,sbuffer_same_views,"
+                     "tiled_same_views\n");
+    }
     
-    int i = low - 1;
-    for (int j = low; j < high; j++) {
-        if (faces->z_max[faces->sorted_face_indices[j]] >= pivot) {  // Descending order
-            i++;
-            SWAP_FACE(faces, i, j);
+    for (m = 0; m < (int)(sizeof(bench_models) / sizeof(bench_models[0])); m++) {
+        Model3D* bench = createModel3D();
+        if (bench == NULL) break;
+        if (loadModel3D(bench, bench_models[m]) < 0 || bench->faces.face_count == 0) {
+            printf("%-14s skipped\n", bench_models[m]);
+            destroyModel3D(bench);
+            continue;
+        }
+        for (r = 0; r < (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0])); r++) {
+            unsigned long paint_sums[BENCH_FRAMES], sums[BENCH_FRAMES];
+            long paint, zbuf, sbuf;
+            int f, same = 0, tiled_same = 0;
+            if (fbReserve(&fb, bench_sizes[r][0], bench_sizes[r][1], 1) < 0 || sbufReserve(&fb) < 0 ||
+                fbReserve(&tiled, bench_sizes[r][0], bench_sizes[r][1], 0) < 0) {
+                printf("%-14s %dx%d: not enough memory\n", bench_models[m], bench_sizes[r][0], bench_sizes[r][1]);
+                continue;
+            }
+            paint = benchRenderPass(bench, &fb, params, RASTER_PAINT, paint_sums, &tiled, &tiled_same);
+            zbuf = benchRenderPass(bench, &fb, params, RASTER_ZTEST, sums, NULL, NULL);
+            sbuf = benchRenderPass(bench, &fb, params, RASTER_SBUFFER, sums, NULL, NULL);
+            for (f = 0; f < BENCH_FRAMES; f++) {
+                if (sums[f] == paint_sums[f]) same++;
+            }
+            printf("%-12s %3dx%-4d %5d %7ld %7ld %7ld %3d/%d %3d/%d\n", bench_models[m], bench_sizes[r][0],
+                   bench_sizes[r][1], bench->faces.face_count, paint, zbuf, sbuf, same, BENCH_FRAMES,
+                   tiled_same, BENCH_FRAMES);
+            if (out != NULL) {
+                fprintf(out, "%s,%d,%d,%d,%ld,%ld,%ld,%d,%d\n", bench_models[m], bench_sizes[r][0], bench_sizes[r][1],
+                        bench->faces.face_count, paint, zbuf, sbuf, same, tiled_same);
+            }
         }
+        destroyModel3D(bench);
+    }
+    fbRelease(&fb);
+    fbRelease(&tiled);
+    if (out != NULL) {
+        fclose(out);
+        printf("Results written to %s\n", BENCH_FILE);
     }
-    
-    SWAP_FACE(faces, i + 1, high);  // Move pivot to final position
-    return i + 1;
 }
 
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
 // Function to draw polygons with QuickDraw
-void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_count_total) {
+void drawPolygons(Model3D* model, Byte* vertex_count, int face_count, int vertex_count_total) {
     int i, j;
     VertexArrays3D* vtx = &model->vertices;
     FaceArrays3D* faces = &model->faces;
     Handle polyHandle;
     DynamicPolygon *poly;
-    int min_x, max_x, min_y, max_y;
     int valid_faces_drawn = 0;
     int invalid_faces_skipped = 0;
-    int triangle_count = 0;
-    int quad_count = 0;
-    Pattern pat;
     
     // Use global persistent handle to avoid repeated NewHandle/DisposeHandle
     // Each call allocates fresh if needed, but reuses same handle block
     if (globalPolyHandle == NULL) {
-        int max_polySize = 2 + 8 + (4 * 4);  // Max for quad (4 vertices)
+        int max_polySize = 2 + 8 + (MAX_FACE_VERTICES * 4);  // Largest face the loader accepts
         globalPolyHandle = NewHandle((long)max_polySize, userid(), 0xC014, 0L);
         if (globalPolyHandle == NULL) {
             printf("Error: Unable to allocate global polygon handle\n");
@@ -1860,6 +6978,28 @@ void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_
     //     keypress();
     // }
     
+    drawStateReset();
+    frame_aborted = 0;
+    outline_edges_drawn = 0;
+    dirty_faces_skipped = 0;
+    if (outline_mode == OUTLINE_FEATURE) outlineBeginPass(model, faces->sorted_face_indices, face_count);
+    if (render_mode == RENDER_TILED && drawPolygonsTiled(model, face_count, polyHandle) == 0) {
+        face_count = 0;  // Already drawn; fall through to the common cleanup
+    }
+#if mode == 320
+    // fbPresent writes 320-mode pixels; 640 mode keeps the QuickDraw path
+    else if (render_mode == RENDER_ZBUFFER && drawPolygonsZBuffer(model, face_count) == 0) {
+        face_count = 0;
+    }
+    else if (render_mode == RENDER_SBUFFER && drawPolygonsSBuffer(model, face_count) == 0) {
+        face_count = 0;
+    }
+#endif
+    else if (render_mode == RENDER_WIREFRAME && model->edges.edge_count > 0) {
+        drawPolygonsWireframe(model);
+        face_count = 0;
+    }
+    
     // Use sorted_face_indices to draw in correct depth order
     // Draw ALL faces - painter's algorithm handles occlusion
     int start_face = 0;
@@ -1867,9 +7007,9 @@ void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_
     
     for (i = start_face; i < start_face + max_faces_to_draw; i++) {
         int face_id = faces->sorted_face_indices[i];
-        if (faces->display_flag[face_id] == 0) continue;
+        if (!FACE_VISIBLE(faces->display_flag, face_id)) continue;
         if (faces->vertex_count[face_id] >= 3) {
-            int offset = faces->vertex_indices_ptr[face_id];
+            IndexOffset offset = faces->vertex_indices_ptr[face_id];
             if (face_log) {
                 fprintf(face_log, "Face %d:\n", face_id);
                 for (j = 0; j < faces->vertex_count[face_id]; j++) {
@@ -1888,38 +7028,26 @@ void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_
                     }
                 }
             }
-            // Calculate polySize for this specific face
-            int polySize = 2 + 8 + (faces->vertex_count[face_id] * 4);
             poly = (DynamicPolygon *)*polyHandle;
-            poly->polySize = polySize;
-            min_x = max_x = min_y = max_y = -1;
-            for (j = 0; j < faces->vertex_count[face_id]; j++) {
-                int vertex_idx = faces->vertex_indices_buffer[offset + j] - 1;
-                // Only draw valid vertices
-                if (vertex_idx >= 0 && vertex_idx < vtx->vertex_count) {
-                    poly->polyPoints[j].h = mode / 320 * vtx->x2d[vertex_idx];
-                    poly->polyPoints[j].v = vtx->y2d[vertex_idx];
-                    if (min_x == -1 || vtx->x2d[vertex_idx] < min_x) min_x = vtx->x2d[vertex_idx];
-                    if (max_x == -1 || vtx->x2d[vertex_idx] > max_x) max_x = vtx->x2d[vertex_idx];
-                    if (min_y == -1 || vtx->y2d[vertex_idx] < min_y) min_y = vtx->y2d[vertex_idx];
-                    if (max_y == -1 || vtx->y2d[vertex_idx] > max_y) max_y = vtx->y2d[vertex_idx];
-                }
+            buildFacePoly(model, face_id, poly);
+            // Outside the dirty rectangle the kept frame is already right
+            if (poly->polyBBox.h2 + 2 <= dirty_x0 || poly->polyBBox.h1 >= dirty_x1 ||
+                poly->polyBBox.v2 + 2 <= dirty_y0 || poly->polyBBox.v1 >= dirty_y1) {
+                dirty_faces_skipped++;
+                continue;
             }
-            poly->polyBBox.h1 = min_x;
-            poly->polyBBox.v1 = min_y;
-            poly->polyBBox.h2 = max_x;
-            poly->polyBBox.v2 = max_y;
-            SetSolidPenPat(14);
-            GetPenPat(pat);
-            FillPoly(polyHandle, pat);
-            SetSolidPenPat(7);
-            FramePoly(polyHandle);
+            paintFacePoly(model, face_id, polyHandle);
             valid_faces_drawn++;
+#if ENABLE_STATS && STATS_FILL_AREA
+            STATS_ADD(STAT_PIXELS_FILLED, polyPixelArea(poly, faces->vertex_count[face_id]));
+#endif
+            if (RENDER_POLL_DUE(valid_faces_drawn) && renderPoll()) break;
         } else {
             invalid_faces_skipped++;
         }
     }
     if (face_log) fclose(face_log);
+    STATS_ADD(STAT_FACES_DRAWN, valid_faces_drawn);
     
     // Cleanup: unlock handle but keep it allocated for next frame
     if (poly_handle_locked) {
@@ -1927,99 +7055,125 @@ void drawPolygons(Model3D* model, int* vertex_count, int face_count, int vertex_
         poly_handle_locked = 0;
     }
 }
+
+#ifdef __ORCAC__
+segment "GS3DSTATS";   // Load segment: frame statistics and trace
+#endif
+
 /**
- * DEBUG DATA SAVE
- * ===============
+ * BINARY FRAME TRACE
+ * ==================
+ * 
+ * Replaces the old text debug save: formatting every vertex and face with
+ * fprintf took longer than rendering the frame. Here each frame is a
+ * header of TRACE_HEADER_LONGS values followed by the raw SoA arrays, one
+ * fwrite per array, so a capture can stay on during a real session.
  * 
- * This function saves all 3D model data to a text file
- * to allow analysis of display problems.
+ * FRAME LAYOUT (little-endian: 65816 and the usual hosts):
+ *   header[18] : magic, version, frame, vertex_count, face_count,
+ *                total_indices, draw_count, angle_h, angle_v, angle_w,
+ *                distance, cull_mode, subpixel_area_min,
+ *                sizeof(int), sizeof(VertexIndex), sizeof(IndexOffset),
+ *                sizeof(Fixed32), has_source; always 4 bytes each,
+ *                whatever sizeof(long) is (8 on LP64 hosts)
+ *   Fixed32 x, y, z, xo, yo, zo       [vertex_count]
+ *   int     x2d, y2d                  [vertex_count]
+ *   Byte    vertex_count              [face_count]
+ *   IndexOffset vertex_indices_ptr    [face_count]
+ *   VertexIndex vertex_indices_buffer [total_indices]
+ *   Fixed32 z_max                     [face_count]
+ *   Byte    display_flag              [FACE_FLAG_BYTES(face_count)]
+ *   int     sorted_face_indices       [face_count]
+ *   int     cluster_source            [face_count], if has_source
  * 
- * DEBUG FILE CONTENT:
- * - Complete vertex list with 3D and 2D coordinates
- * - Complete face list with indices and calculated coordinates
- * - Model statistics
+ * Face numbers are those of the arrays, which buildFaceClusters reorders
+ * at load: when it did (has_source = 1), cluster_source gives the loaded
+ * (OBJ order) number of each face.
+ * 
+ * NOTES:
+ *   - FixedPoint/decode_trace.py rebuilds the former debug.txt report
+ *   - Element sizes are in the header, so both size profiles decode
+ *   - Version 1 (16 values) and 2 (17, no has_source) traces still decode
  */
-void saveDebugData(Model3D* model, const char* debug_filename) {
-    FILE *debug_file;
-    int i, j;
-    int triangle_count = 0, quad_count = 0, other_count = 0;
-    VertexArrays3D* vtx = &model->vertices;
-    // Open debug file for writing
-    debug_file = fopen(debug_filename, "w");
-    if (debug_file == NULL) {
-        printf("Error: Unable to create debug file '%s'\n", debug_filename);
-        return;
+int traceOpen(const char* filename) {
+    if (trace_file != NULL) traceClose();
+    trace_file = fopen(filename, "wb");
+    if (trace_file == NULL) {
+        printf("Error: Unable to create trace file '%s'\n", filename);
+        return -1;
     }
-    // Face statistics
-    for (i = 0; i < model->faces.face_count; i++) {
-        if (model->faces.vertex_count[i] == 3) triangle_count++;
-        else if (model->faces.vertex_count[i] == 4) quad_count++;
-        else other_count++;
-    }
-    fprintf(debug_file, "Triangles detected: %d\n", triangle_count);
-    fprintf(debug_file, "Quadrilaterals detected: %d\n", quad_count);
-    fprintf(debug_file, "Other polygons: %d\n", other_count);
-    fprintf(debug_file, "\n");
-    // Complete vertex list
-    fprintf(debug_file, "=== VERTICES ===\n");
-    fprintf(debug_file, "Format: Index | X3D Y3D Z3D | X2D Y2D\n");
-    fprintf(debug_file, "--------------------------------------\n");
-    for (i = 0; i < vtx->vertex_count; i++) {
-        fprintf(debug_file, "V%03d | %8.3f %8.3f %8.3f | %4d %4d\n",
-                i + 1,
-                FIXED_TO_FLOAT(vtx->x[i]), FIXED_TO_FLOAT(vtx->y[i]), FIXED_TO_FLOAT(vtx->z[i]),
-                vtx->x2d[i], vtx->y2d[i]);
-    }
-    fprintf(debug_file, "\n");
-    // Complete face list
-    fprintf(debug_file, "=== FACES ===\n");
-    for (i = 0; i < model->faces.face_count; i++) {
-        fprintf(debug_file, "Face F%03d (%d vertices):\n", i + 1, model->faces.vertex_count[i]);
-        fprintf(debug_file, "  Indices: ");
-        int offset = model->faces.vertex_indices_ptr[i];
-        for (j = 0; j < model->faces.vertex_count[i]; j++) {
-            fprintf(debug_file, "V%d", model->faces.vertex_indices_buffer[offset + j]);
-            if (j < model->faces.vertex_count[i] - 1) fprintf(debug_file, ", ");
-        }
-        fprintf(debug_file, "\n");
-        // 3D and 2D coordinates of each vertex of the face
-        fprintf(debug_file, "  Coordinates:\n");
-        for (j = 0; j < model->faces.vertex_count[i]; j++) {
-            int vertex_idx = model->faces.vertex_indices_buffer[offset + j] - 1; // Convert base-1 to base-0
-            if (vertex_idx >= 0 && vertex_idx < vtx->vertex_count) {
-                fprintf(debug_file, "    V%d: 3D(%.3f, %.3f, %.3f) -> 2D(%d, %d)\n",
-                        model->faces.vertex_indices_buffer[offset + j],
-                        FIXED_TO_FLOAT(vtx->x[vertex_idx]), FIXED_TO_FLOAT(vtx->y[vertex_idx]), FIXED_TO_FLOAT(vtx->z[vertex_idx]),
-                        vtx->x2d[vertex_idx], vtx->y2d[vertex_idx]);
-            } else {
-                fprintf(debug_file, "    V%d: ERROR - Index out of bounds!\n", model->faces.vertex_indices_buffer[offset + j]);
-            }
-        }
-        fprintf(debug_file, "\n");
-    }
-    // Integrity check
-    fprintf(debug_file, "=== INTEGRITY CHECK ===\n");
-    int errors = 0;
-    for (i = 0; i < model->faces.face_count; i++) {
-        int offset = model->faces.vertex_indices_ptr[i];
-        for (j = 0; j < model->faces.vertex_count[i]; j++) {
-            int vertex_idx = model->faces.vertex_indices_buffer[offset + j] - 1;
-            if (vertex_idx < 0 || vertex_idx >= vtx->vertex_count) {
-                fprintf(debug_file, "ERROR: Face F%d references non-existent vertex V%d (index %d out of bounds [1-%d])\n",
-                        i + 1, model->faces.vertex_indices_buffer[offset + j], vertex_idx + 1, vtx->vertex_count);
-                errors++;
-            }
-        }
+    trace_frames = 0;
+    return 0;
+}
+
+void traceWriteFrame(Model3D* model, ObserverParams* params) {
+    VertexArrays3D* vtx = &model->vertices;
+    FaceArrays3D* faces = &model->faces;
+    size_t nv = (size_t)vtx->vertex_count;
+    size_t nf = (size_t)faces->face_count;
+    long header[TRACE_HEADER_LONGS];
+    Byte raw[TRACE_HEADER_LONGS * 4];
+    int i;
+    
+    if (trace_file == NULL) return;
+    
+    header[0] = TRACE_MAGIC;
+    header[1] = TRACE_VERSION;
+    header[2] = trace_frames;
+    header[3] = vtx->vertex_count;
+    header[4] = faces->face_count;
+    header[5] = faces->total_indices;
+    header[6] = faces->draw_count;
+    header[7] = params->angle_h;
+    header[8] = params->angle_v;
+    header[9] = params->angle_w;
+    header[10] = params->distance;
+    header[11] = model->cull_mode;
+    header[12] = subpixel_area_min;
+    header[13] = sizeof(int);
+    header[14] = sizeof(VertexIndex);
+    header[15] = sizeof(IndexOffset);
+    header[16] = sizeof(Fixed32);
+    header[17] = (faces->cluster_source != NULL);
+    
+    for (i = 0; i < TRACE_HEADER_LONGS; i++) {
+        raw[4 * i] = (Byte)header[i];
+        raw[4 * i + 1] = (Byte)(header[i] >> 8);
+        raw[4 * i + 2] = (Byte)(header[i] >> 16);
+        raw[4 * i + 3] = (Byte)(header[i] >> 24);
     }
-    if (errors == 0) {
-        fprintf(debug_file, "No errors detected - All indices are valid.\n");
-    } else {
-        fprintf(debug_file, "TOTAL: %d errors detected!\n", errors);
+    fwrite(raw, 1, sizeof(raw), trace_file);
+    fwrite(vtx->x, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->y, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->z, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->xo, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->yo, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->zo, sizeof(Fixed32), nv, trace_file);
+    fwrite(vtx->x2d, sizeof(int), nv, trace_file);
+    fwrite(vtx->y2d, sizeof(int), nv, trace_file);
+    fwrite(faces->vertex_count, sizeof(Byte), nf, trace_file);
+    fwrite(faces->vertex_indices_ptr, sizeof(IndexOffset), nf, trace_file);
+    fwrite(faces->vertex_indices_buffer, sizeof(VertexIndex), (size_t)faces->total_indices, trace_file);
+    fwrite(faces->z_max, sizeof(Fixed32), nf, trace_file);
+    fwrite(faces->display_flag, sizeof(Byte), (size_t)FACE_FLAG_BYTES(faces->face_count), trace_file);
+    fwrite(faces->sorted_face_indices, sizeof(int), nf, trace_file);
+    if (faces->cluster_source != NULL) fwrite(faces->cluster_source, sizeof(int), nf, trace_file);
+    trace_frames++;
+}
+
+long traceClose(void) {
+    long frames = trace_frames;
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
     }
-    // Close file
-    fclose(debug_file);
+    trace_frames = 0;
+    return frames;
 }
 
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
 
 void DoColor() {
         Rect r;
@@ -2055,6 +7209,199 @@ void DoText() {
         putchar((char) 12); // Clear screen    
 }
 
+// ============================================================================
+//                        FRAME PRESENTATION
+// ============================================================================
+
+/**
+ * ONE FRAME, OFF-SCREEN THEN FLIPPED
+ * ==================================
+ * 
+ * renderFrame draws the processed faces into the off-screen frame (or
+ * straight to the screen if it cannot be allocated), closes the frame
+ * statistics and shows the result unless the frame was aborted. An
+ * aborted frame is dropped from the statistics ring, not recorded.
+ */
+void renderFrame(Model3D* model) {
+    int offscreen = (offscreenBegin(model) == 0);
+#if ENABLE_STATS
+    long start_draw_ticks = GetTick();
+    drawPolygons(model, model->faces.vertex_count, model->faces.draw_count, model->vertices.vertex_count);
+    STATS_ADD(STAT_TICKS_DRAW, GetTick() - start_draw_ticks);
+    if (frame_aborted) statsDropFrame();
+    else statsEndFrame();
+#else
+    drawPolygons(model, model->faces.vertex_count, model->faces.draw_count, model->vertices.vertex_count);
+#endif
+    if (offscreen) {
+        offscreenEnd();
+        offscreen_valid = !frame_aborted;
+        offscreen_draws++;
+    }
+    // Flip
+    if (offscreen_valid) {
+        offscreenBlit();
+    }
+}
+
+#ifdef __ORCAC__
+segment "GS3DBENCH";   // Load segment: benchmark and checks
+#endif
+
+/**
+ * ABORT CHECK ('J' key, runs headless)
+ * ====================================
+ * 
+ * Draws the processed frame once through a poll hook that never reports
+ * a key: P polls, no abort. Then again with the hook reporting a key at
+ * poll k = 1, P/2 and P, so the painter stops after k * RENDER_POLL_FACES
+ * faces. Each aborted frame must make exactly k polls and one abort, and
+ * (with ENABLE_STATS) stay out of the statistics ring while the complete
+ * frame enters it. Returns the number of failed checks.
+ */
+static long abort_check_at = 0;      // Poll the hook reports a key at (0 = never)
+static long abort_check_polls = 0;   // Polls seen by the hook this frame
+
+static int abortCheckHook(void) {
+    return ++abort_check_polls == abort_check_at;
+}
+
+int runAbortCheck(Model3D* model) {
+    int saved_interruptible = render_interruptible;
+    long at[3];
+    long full_polls, polls, aborts;
+    int k, failures = 0;
+#if ENABLE_STATS
+    long ended = stats_frames_ended, dropped = stats_frames_dropped;
+#endif
+    
+    render_interruptible = 1;
+    renderSetPollHook(abortCheckHook);
+    
+    // Reference: complete frame
+    abort_check_at = 0;
+    abort_check_polls = 0;
+    polls = render_polls;
+    aborts = render_aborts;
+    renderFrame(model);
+    full_polls = render_polls - polls;
+    if (frame_aborted || render_aborts != aborts || abort_check_polls != full_polls) failures++;
+#if ENABLE_STATS
+    if (stats_frames_ended != ended + 1 || stats_frames_dropped != dropped) failures++;
+#endif
+    printf("Complete frame: %ld polls, %ld aborts\n", full_polls, render_aborts - aborts);
+    
+    at[0] = (full_polls > 0) ? 1 : 0;  // No poll, no abort point
+    at[1] = full_polls / 2;
+    at[2] = full_polls;
+    for (k = 0; k < 3; k++) {
+        if (at[k] < 1 || (k > 0 && at[k] == at[k - 1])) continue;
+        abort_check_at = at[k];
+        abort_check_polls = 0;
+        polls = render_polls;
+        aborts = render_aborts;
+#if ENABLE_STATS
+        ended = stats_frames_ended;
+        dropped = stats_frames_dropped;
+#endif
+        renderFrame(model);
+        if (!frame_aborted || render_polls - polls != at[k] || render_aborts - aborts != 1) failures++;
+#if ENABLE_STATS
+        if (stats_frames_ended != ended || stats_frames_dropped != dropped + 1) failures++;
+#endif
+        printf("Abort at poll %ld (~%ld faces): %ld polls, %ld aborts\n",
+               at[k], at[k] * RENDER_POLL_FACES, render_polls - polls, render_aborts - aborts);
+    }
+    if (full_polls == 0) printf("Frame too small to poll (under %d faces)\n", RENDER_POLL_FACES);
+    
+    renderSetPollHook(NULL);
+    render_interruptible = saved_interruptible;
+    frame_aborted = 0;
+    offscreen_valid = 0;  // The last check left a partial frame
+    printf("Abort check: %s (%d failed)\n", failures ? "FAILED" : "passed", failures);
+    return failures;
+}
+
+#ifdef __ORCAC__
+segment "GS3DLOD";     // Load segment: levels of detail, clusters, octree
+#endif
+
+/**
+ * LEVEL OF DETAIL SELECTION
+ * =========================
+ * 
+ * bigloop picks the level before processing the view: the bounding
+ * sphere radius projected with the same scale as transformVertices
+ * (100 / zo of the centre) is compared with LOD_THRESHOLDS. Only the
+ * sphere centre is transformed, so choosing costs a few multiplies.
+ * Switching level flushes the view cache; the same view always selects
+ * the same level, so entries never mix levels.
+ */
+void lodActivate(Model3D* model, int level) {
+    if (level == model->lod_active) return;
+    if (model->lod_active != 0) swapFaceArrays(&model->faces, &model->lod[model->lod_active]);
+    if (level != 0) swapFaceArrays(&model->faces, &model->lod[level]);
+    model->lod_active = level;
+    viewCacheFlush();  // Cached orders index the faces of one level
+}
+
+int lodSelectLevel(Model3D* model, ObserverParams* params) {
+    static const int thresholds[LOD_LEVELS - 1] = { LOD_THRESHOLDS };
+    ViewTrig t;
+    Fixed32 zo;
+    int level = 0;
+    
+    if (model->bound_r <= 0) return 0;
+    computeViewTrig(params, &t);
+    // Depth of the sphere centre, as transformVertices would compute it
+    zo = t.distance - FIXED_MUL_64(model->bound_x, t.cos_h_cos_v)
+                    - FIXED_MUL_64(model->bound_y, t.sin_h_cos_v)
+                    - FIXED_MUL_64(model->bound_z, t.sin_v);
+    if (zo <= model->bound_r) {
+        lod_radius_px = -1;  // Observer inside the sphere
+        return 0;
+    }
+    lod_radius_px = (int)((FIXED_DIV_64(model->bound_r, zo) * 100L) >> FIXED_SHIFT);
+    if (!lod_mode || render_mode == RENDER_WIREFRAME || outline_mode == OUTLINE_FEATURE) return 0;
+    while (level + 1 < model->lod_count && lod_radius_px < thresholds[level]) level++;
+    return level;
+}
+
+/**
+ * PROGRESSIVE REFINEMENT
+ * ======================
+ * 
+ * After a view change on a model with a coarse level, bigloop processes
+ * the coarse faces (progressiveBegin swaps them into model->faces) and
+ * loopReDraw shows them at once, painter order with plain frames. The
+ * faces are then swapped back (progressiveEnd); if no key is waiting the
+ * full faces are processed and drawn over it, otherwise the coarse picture
+ * stays and the key is served first. The view cache is bypassed for the
+ * coarse pass, so it only ever holds full face orders.
+ */
+void progressiveBegin(Model3D* model) {
+    swapFaceLevels(model);
+    progressive_saved_render = render_mode;
+    progressive_saved_outline = outline_mode;
+    progressive_saved_cache = view_cache_mode;
+    render_mode = RENDER_PAINTER;
+    outline_mode = OUTLINE_FRAME;
+    view_cache_mode = VIEW_CACHE_OFF;
+    progressive_pending = 1;
+}
+
+void progressiveEnd(Model3D* model) {
+    swapFaceLevels(model);
+    render_mode = progressive_saved_render;
+    outline_mode = progressive_saved_outline;
+    view_cache_mode = progressive_saved_cache;
+    progressive_pending = 0;
+}
+
+#ifdef __ORCAC__
+segment "          ";  // Back to the blank (main) load segment
+#endif
+
 // ****************************************************************************
 //                              Fonction main
 // ****************************************************************************
@@ -2066,13 +7413,24 @@ int main() {
     char input[50];
     int colorpalette = 0; // default color palette
     
+    subpixel_area_min = SUBPIXEL_AREA_MIN;
+#if GS3D_THREADS
+    poolInit();
+#endif
+    
+    model = NULL;
+    
+#if ENABLE_DEBUG_SAVE
+    traceOpen(TRACE_FILE);  // Capture the whole session
+#endif
+    
 newmodel:
     printf("===================================\n");
     printf("       3D OBJ file viewer\n");
     printf("===================================\n\n");
     
-    // Creer le modele 3D
-    model = createModel3D();
+    // Creer le modele 3D (kept across 'N' so its arena block is reused)
+    if (model == NULL) model = createModel3D();
     if (model == NULL) {
         printf("Error: Unable to allocate memory for 3D model\n");
         printf("Press any key to quit...\n");
@@ -2103,16 +7461,30 @@ newmodel:
     
     // Get observer parameters
     getObserverParams(&params);
+    
+    // Verify the fast transform kernels on this model before using them
+    if (transformKernelSelfCheck(model, &params) == 0) {
+        printf("Warning: transform kernel mismatch, using the %s kernel\n",
+               transform_kernel == KERNEL_SPLIT32 ? "32-bit split" : "64-bit reference");
+    }
 
     bigloop:
     // Process model with parameters - OPTIMIZED VERSION
     printf("Processing model...\n");
+    progressive_start_ticks = GetTick();
+    lodActivate(model, lodSelectLevel(model, &params));
+    if (progressive_mode && model->coarse_block != NULL && render_mode != RENDER_WIREFRAME &&
+        model->lod_active == 0) {  // A reduced level is already quick
+        progressiveBegin(model);  // Coarse faces processed first, full ones in loopReDraw
+    }
     processModelFast(model, &params, filename);
+    offscreen_valid = 0;  // New geometry: the kept frame is stale
+    view_cache_dirty = 0;
     
-#if ENABLE_DEBUG_SAVE
-    // Debug save (WARNING: very slow!)
-    saveDebugData(model, "debug.txt");
-#endif
+    // Binary frame trace (cheap: one fwrite per array)
+    if (trace_file != NULL && !progressive_pending) {
+        traceWriteFrame(model, &params);
+    }
     
     // Display information and results
     // displayModelInfo(model);
@@ -2124,17 +7496,65 @@ newmodel:
         int key = 0;
         char input[50];
         
+        // Idle precompute left another view in the vertex arrays, or a
+        // progressive refinement was skipped: the face order is not current
+        if (view_cache_dirty) {
+            view_cache_dirty = 0;
+            processModelFast(model, &params, filename);
+        }
+        
         if (model->faces.face_count > 0) {
             // Initialize QuickDraw
             startgraph(mode);
-            // Draw 3D object
-            drawPolygons(model, model->faces.vertex_count, model->faces.face_count, model->vertices.vertex_count);
+            if (shade_mode) {
+                shadeSetPalette();
+            }
+            // Progressive: coarse picture first, full detail only if no key is waiting
+            if (progressive_pending) {
+                renderFrame(model);
+                progressive_coarse_ticks = GetTick() - progressive_start_ticks;
+                progressiveEnd(model);
+                offscreen_valid = 0;  // Coarse picture only
+                if (KBD_DATA & 0x80) {
+                    view_cache_dirty = 1;  // Full order not computed: redone on the next redraw
+                    progressive_skipped++;
+                } else {
+                    processModelFast(model, &params, filename);
+                    if (trace_file != NULL) {
+                        traceWriteFrame(model, &params);
+                    }
+                    progressive_refining = 1;
+                }
+            }
+            // Draw 3D object off-screen, unless the kept frame is still current
+            if (!view_cache_dirty) {
+                if (!offscreen_valid) {
+                    renderFrame(model);
+                } else {
+                    offscreen_blits++;
+                    offscreenBlit();
+                }
+                if (progressive_refining) {
+                    progressive_full_ticks = GetTick() - progressive_start_ticks;
+                    progressive_refining = 0;
+                }
+            }
             // display available colors
             if (colorpalette == 1) { 
                 DoColor(); 
             }
+            
+            // Idle time: precompute neighbouring grid views until a key arrives
+            if (view_cache_mode == VIEW_CACHE_IDLE) {
+                while (!(KBD_DATA & 0x80)) {
+                    int step = viewCachePrecomputeStep(model, &params);
+                    if (step != 0) view_cache_dirty = 1;
+                    if (step <= 0) break;
+                }
+            }
 
             // Wait for key press and get key code
+#ifdef __ORCAC__
     asm 
         {
         sep #0x20
@@ -2146,6 +7566,9 @@ newmodel:
         sta key         // Store the key code in variable 'key'
         rep #0x30
         }
+#else
+    key = hostReadKey();  // Next byte of the stdin script
+#endif
 
     endgraph();        // Close QuickDraw
     
@@ -2173,6 +7596,112 @@ newmodel:
             printf("===================================\n");
             printf("Model: %s\n", filename);
             printf("Vertices: %d, Faces: %d\n", model->vertices.vertex_count, model->faces.face_count);
+            printf("Degenerate faces removed at load: %d\n", model->faces.degenerate_removed);
+            printf("Sub-pixel threshold: %d, culled last frame: %d\n", subpixel_area_min, frame_culled_subpixel);
+            printf("View cache: %s, %d bytes, hits %ld, misses %ld",
+                   view_cache_mode == VIEW_CACHE_IDLE ? "idle" : (view_cache_mode == VIEW_CACHE_LAZY ? "lazy" : "off"),
+                   (int)view_cache_bytes, view_cache_hits, view_cache_misses);
+            if (view_cache_hits + view_cache_misses > 0) {
+                printf(" (%ld%%)", view_cache_hits * 100 / (view_cache_hits + view_cache_misses));
+            }
+            printf("\n");
+            printf("Render mode: %s\n", render_mode == RENDER_TILED ? "tiled" :
+                   (render_mode == RENDER_ZBUFFER ? "z-buffer" :
+                   (render_mode == RENDER_SBUFFER ? "s-buffer" :
+                   (render_mode == RENDER_WIREFRAME ? "wireframe" : "painter"))));
+            if (render_mode == RENDER_WIREFRAME) {
+                printf("Edges: %d unique (FramePoly strokes %ld), %d drawn last frame\n",
+                       model->edges.edge_count, model->faces.total_indices, wire_edges_drawn);
+            }
+            if (render_mode == RENDER_SBUFFER && overdraw_covered > 0) {
+                long factor100 = overdraw_rasterized * 100 / overdraw_covered;
+                printf("Overdraw: %ld span pixels over %ld covered (%ld%% of frame), factor %ld.%02ld (painter) vs 1.00\n",
+                       overdraw_rasterized, overdraw_covered, overdraw_covered * 100 / (320L * 200L),
+                       factor100 / 100, factor100 % 100);
+            }
+            if (render_mode == RENDER_TILED && tile_load_used > 0) {
+                long avg100 = tile_load_total * 100 / tile_load_used;
+                printf("Tiles: %d used, %ld faces binned, max %ld per tile, avg %ld.%02ld",
+                       tile_load_used, tile_load_total, tile_load_max, avg100 / 100, avg100 % 100);
+                if (avg100 > 0) {
+                    long ratio100 = (long)tile_load_max * 10000L / avg100;
+                    printf(", imbalance %ld.%02ld", ratio100 / 100, ratio100 % 100);
+                }
+                printf("%s\n", tile_load_raster ? ", frame buffer on the pool" : "");
+            }
+            printf("Off-screen frame: %s, %ld drawn, %ld redraws by blit\n",
+                   offscreen_pixels != NULL ? "on" : "off", offscreen_draws, offscreen_blits);
+            printf("Last repaint: %ld pixels (%ld%% of screen), %d faces outside\n",
+                   dirty_pixels, dirty_pixels * 100 / (320L * 200L), dirty_faces_skipped);
+            if (model->coarse_block != NULL) {
+                printf("Progressive: %s, coarse level %d faces; last view: coarse %ld ticks, full %ld ticks, %ld refinements skipped\n",
+                       progressive_mode ? "on" : "off", model->coarse.face_count,
+                       progressive_coarse_ticks, progressive_full_ticks, progressive_skipped);
+            } else {
+                printf("Progressive: no coarse level (model below %d faces or not reducible)\n", PROGRESSIVE_MIN_FACES);
+            }
+            if (model->lod_count > 1) {
+                printf("LOD: %s, level %d of %d (%d faces, %d triangles), projected radius %d px\n",
+                       lod_mode ? "on" : "off", model->lod_active, model->lod_count - 1,
+                       model->faces.face_count, model->faces.triangle_count, lod_radius_px);
+            } else {
+                printf("LOD: no reduced level (model below %d faces or not reducible)\n", LOD_MIN_FACES);
+            }
+            printf("Interruptible drawing: %s, %ld polls, %ld frames aborted, %ld keys coalesced\n",
+                   render_interruptible ? "on" : "off", render_polls, render_aborts, nav_coalesced);
+            printf("Materials: %d, draw state changes last frame: %d\n",
+                   model->faces.material_count, draw_state_changes);
+            printf("Shading: %s\n", shade_mode ? "Lambert flat, dithered grey ramp" : "off");
+            if (outline_mode == OUTLINE_FEATURE) {
+                printf("Outlines: silhouette/crease (%d deg), %d edges drawn last frame\n",
+                       CREASE_ANGLE, outline_edges_drawn);
+            } else {
+                printf("Outlines: every face edge (FramePoly)\n");
+            }
+            printf("Transform kernel: %s%s%s\n",
+                   transform_kernel == KERNEL_SSE41 ? "SSE4.1, 4 vertices per step" :
+                   transform_kernel == KERNEL_SPLIT32 ? "32-bit split" : "64-bit reference",
+                   transform_kernel_checked ? " (split verified)" : "",
+                   transform_kernel_simd ? " (SSE4.1 verified)" : "");
+            {
+                FaceArrays3D* loaded = model->lod_active ? &model->lod[model->lod_active] : &model->faces;
+                if (loaded->convex == CONVEX_UNCHECKED) {
+                    printf("Convex: not checked (%ld plane tests over %ld)\n",
+                           (long)loaded->face_count * model->vertices.vertex_count, CONVEX_MAX_TESTS);
+                } else {
+                    printf("Convex: %s after %ld plane tests%s, %ld frames without sort\n",
+                           loaded->convex == CONVEX_YES ? "yes" : "no", model->convex_tests,
+                           loaded->convex == CONVEX_YES && model->cull_mode == CULL_NONE ?
+                           " (needs winding culling, B)" : "", convex_frames);
+                }
+            }
+            printf("Winding culling: %s, culled last frame: %d\n",
+                   model->cull_mode == CULL_BACK ? "back" : (model->cull_mode == CULL_FRONT ? "front" : "none"),
+                   frame_culled_winding);
+            if (model->faces.cluster_count > 0) {
+                printf("Face clusters: %d, last frame accepted %d, rejected %d, partial %d\n",
+                       model->faces.cluster_count, frame_clusters_accepted,
+                       frame_clusters_rejected, frame_clusters_partial);
+            } else {
+                printf("Face clusters: none (%s)\n", model->lod_active ? "reduced level in use" : "small model");
+            }
+            if (model->faces.octree == NULL) {
+                printf("Octree: none (%s)\n", model->lod_active ? "reduced level in use" : "small model");
+            } else if (frame_octree_listed == OCTREE_NOT_WALKED) {
+                printf("Octree: %d nodes, not walked last frame (convex model or cached view)\n",
+                       model->faces.octree_nodes);
+            } else if (frame_octree_listed < 0) {
+                printf("Octree: %d nodes, whole model in view last frame (%d visited)\n",
+                       model->faces.octree_nodes, frame_octree_nodes);
+            } else {
+                printf("Octree: %d nodes, last frame %d visited, %d faces listed, %ld outside view\n",
+                       model->faces.octree_nodes, frame_octree_nodes, frame_octree_listed,
+                       frame_octree_outside);
+            }
+#if GS3D_THREADS
+            printf("Threads: %d of %d CPUs (stages from %ld vertices or faces)\n",
+                   pool_threads, pool_cpus, POOL_MIN_ITEMS);
+#endif
             printf("Observer Parameters:\n");
             printf("    Distance: %.2f\n", FIXED_TO_FLOAT(params.distance));
             printf("    Horizontal Angle: %.1f\n", FIXED_TO_FLOAT(params.angle_h));
@@ -2186,38 +7715,27 @@ newmodel:
             
         case 65:  // 'A' - decrease distance
         case 97:  // 'a'
-            params.distance = params.distance - (params.distance / 10);
-            goto bigloop;
-            
         case 90:  // 'Z' - increase distance  
         case 122: // 'z'
-            params.distance = params.distance + (params.distance / 10);
-            goto bigloop;
-            
         case 21:  // Right arrow - increase horizontal angle
-            params.angle_h = params.angle_h + INT_TO_FIXED(10);
-            goto bigloop;
-            
         case 8:   // Left arrow - decrease horizontal angle
-            params.angle_h = params.angle_h - INT_TO_FIXED(10);
-            goto bigloop;
-            
         case 10:  // Down arrow - decrease vertical angle
-            params.angle_v = params.angle_v - INT_TO_FIXED(10);
-            goto bigloop;
-            
         case 11:  // Up arrow - increase vertical angle
-            params.angle_v = params.angle_v + INT_TO_FIXED(10);
-            goto bigloop;
-            
         case 87:  // 'W' - increase screen rotation angle
         case 119: // 'w'
-            params.angle_w = params.angle_w + INT_TO_FIXED(10);
-            goto bigloop;
-            
         case 88:  // 'X' - decrease screen rotation angle
         case 120: // 'x'
-            params.angle_w = params.angle_w - INT_TO_FIXED(10);
+            applyNavigationKey(&params, key);
+            // Keys that arrived meanwhile (auto-repeat) join this view change:
+            // one target view, one frame
+            while (KBD_DATA & 0x80) {
+                int next = KBD_DATA & 0x7F;
+                ObserverParams merged = params;
+                if (!applyNavigationKey(&merged, next)) break;
+                KBD_STROBE = 0;
+                params = merged;
+                nav_coalesced++;
+            }
             goto bigloop;
         
         case 67:  // 'C' - toggle color palette display
@@ -2225,9 +7743,164 @@ newmodel:
             colorpalette ^= 1; // Toggle between 0 and 1
             goto loopReDraw;
 
-        case 78:  // 'N' - load new model
+        case 80:  // 'P' - cycle sub-pixel culling threshold (0, 1, 2, 4, 8)
+        case 112: // 'p'
+            if (subpixel_area_min == 0) subpixel_area_min = 1;
+            else if (subpixel_area_min >= 8) subpixel_area_min = 0;
+            else subpixel_area_min = subpixel_area_min * 2;
+            viewCacheFlush();
+            goto bigloop;
+
+        case 66:  // 'B' - cycle winding culling for this model (none, back, front)
+        case 98:  // 'b'
+            model->cull_mode = (model->cull_mode + 1) % 3;
+            viewCacheFlush();
+            goto bigloop;
+
+        case 86:  // 'V' - cycle view cache mode (off, lazy, idle precompute)
+        case 118: // 'v'
+            view_cache_mode = (view_cache_mode + 1) % 3;
+            if (view_cache_mode == VIEW_CACHE_OFF) viewCacheFlush();
+            view_cache_hits = 0;
+            view_cache_misses = 0;
+            goto loopReDraw;
+
+#if ENABLE_STATS
+        case 83:  // 'S' - frame statistics summary (min/avg/p95)
+        case 115: // 's'
+            statsSummary(stdout);
+            printf("\nPress any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+
+        case 68:  // 'D' - dump frame statistics to STATS_DUMP_FILE
+        case 100: // 'd'
+            if (statsDump(STATS_DUMP_FILE) == 0) {
+                printf("Frame statistics written to %s\n", STATS_DUMP_FILE);
+            }
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+#endif
+
+        case 82:  // 'R' - cycle rasterization mode
+        case 114: // 'r'
+            render_mode = (render_mode + 1) % RENDER_MODE_COUNT;
+#if mode != 320
+            // No fbPresent in 640 mode: the software rasterizer modes would be the painter
+            while (render_mode == RENDER_ZBUFFER || render_mode == RENDER_SBUFFER) {
+                render_mode = (render_mode + 1) % RENDER_MODE_COUNT;
+            }
+#endif
+            goto bigloop;  // Sorted or not depends on the mode
+
+        case 77:  // 'M' - render benchmark (sort + paint versus z-buffer)
+        case 109: // 'm'
+            runRenderBenchmark(&params);
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;  // Benchmark models are separate: current frame untouched
+
+        case 76:  // 'L' - toggle Lambert flat shading
+        case 108: // 'l'
+            shade_mode ^= 1;
+            offscreen_valid = 0;
+            goto loopReDraw;
+
+        case 79:  // 'O' - toggle outlines (every face edge / silhouette and creases)
+        case 111: // 'o'
+            outline_mode = (outline_mode == OUTLINE_FRAME) ? OUTLINE_FEATURE : OUTLINE_FRAME;
+            goto bigloop;  // Facing is computed per frame
+
+        case 69:  // 'E' - toggle distance level of detail
+        case 101: // 'e'
+            lod_mode ^= 1;
+            goto bigloop;
+
+        case 71:  // 'G' - toggle progressive refinement (coarse first frame)
+        case 103: // 'g'
+            progressive_mode ^= 1;
+            goto loopReDraw;
+
+        case 73:  // 'I' - toggle interruptible drawing
+        case 105: // 'i'
+            render_interruptible ^= 1;
+            goto loopReDraw;
+
+        case 74:  // 'J' - abort check: forced aborts through the poll hook
+        case 106: // 'j'
+            runAbortCheck(model);
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+
+        case 75:  // 'K' - cycle vertex transform kernel (verified SSE4.1 / 32-bit / 64-bit reference)
+        case 107: // 'k'
+            if (transform_kernel == KERNEL_SSE41) transform_kernel = KERNEL_SPLIT32;
+            else if (transform_kernel == KERNEL_SPLIT32) transform_kernel = KERNEL_SCALAR64;
+            else if (transform_kernel_simd) transform_kernel = KERNEL_SSE41;
+            else if (transform_kernel_checked) transform_kernel = KERNEL_SPLIT32;
+            goto bigloop;
+
+        case 85:  // 'U' - transform kernel test: every kernel against the 64-bit reference
+        case 117: // 'u'
+            runTransformKernelTest();
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+
+        case 70:  // 'F' - cycle pool threads (1, 2, 4, ... the CPUs, POOL_MAX_THREADS)
+        case 102: // 'f'
+#if GS3D_THREADS
+            if (pool_threads >= POOL_MAX_THREADS) pool_threads = 1;
+            else if (pool_threads < pool_cpus && pool_threads * 2 > pool_cpus) pool_threads = pool_cpus;
+            else if (pool_threads * 2 > POOL_MAX_THREADS) pool_threads = POOL_MAX_THREADS;
+            else pool_threads *= 2;
+            goto bigloop;
+#else
+            printf("No thread pool in this build (GS3D_THREADS = 0)\n");
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+#endif
+
+        case 81:  // 'Q' - thread scaling report and determinism check
+        case 113: // 'q'
+#if GS3D_THREADS
+            if (view_cache_dirty) {  // Arrays hold an idle precompute view
+                view_cache_dirty = 0;
+                processModelFast(model, &params, filename);
+            }
+            runThreadScaling(model, &params);
+#else
+            printf("No thread pool in this build (GS3D_THREADS = 0)\n");
+#endif
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+
+        case 84:  // 'T' - start/stop binary frame trace to TRACE_FILE
+        case 116: // 't'
+            if (trace_file == NULL) {
+                if (traceOpen(TRACE_FILE) == 0) {
+                    if (view_cache_dirty) {  // Arrays hold an idle precompute view
+                        view_cache_dirty = 0;
+                        processModelFast(model, &params, filename);
+                    }
+                    traceWriteFrame(model, &params);
+                    printf("Tracing frames to %s\n", TRACE_FILE);
+                }
+            } else {
+                printf("Trace stopped: %ld frames in %s\n", traceClose(), TRACE_FILE);
+            }
+            printf("Press any key to continue...\n");
+            keypress();
+            goto loopReDraw;
+
+        case 78:  // 'N' - load new model (same Model3D, arena reused)
         case 110: // 'n'
-            destroyModel3D(model);
+            viewCacheFlush();
+            view_cache_dirty = 0;
             goto newmodel;
         
         // dispaly help
@@ -2242,6 +7915,27 @@ newmodel:
             printf("Arrow Up/Down: Increase/Decrease vertical angle\n");
             printf("W/X: Increase/Decrease screen rotation angle\n");
             printf("C: Toggle color palette display\n");
+            printf("P: Cycle sub-pixel culling threshold\n");
+            printf("B: Cycle back-face culling (none/back/front)\n");
+            printf("V: Cycle view cache (off/lazy/idle precompute)\n");
+#if ENABLE_STATS
+            printf("S/D: Frame statistics summary / dump to %s\n", STATS_DUMP_FILE);
+#endif
+            printf("R: Cycle render mode (painter/tiled/z-buffer/s-buffer/wireframe)\n");
+            printf("M: Render benchmark, paint vs z-buffer vs s-buffer (%s)\n", BENCH_FILE);
+            printf("L: Toggle flat shading (painter/tiled)\n");
+            printf("O: Toggle outlines (all edges / silhouette + creases)\n");
+            printf("G: Toggle progressive refinement (coarse frame first)\n");
+            printf("E: Toggle distance level of detail\n");
+            printf("I: Toggle interruptible drawing (abort on key)\n");
+            printf("J: Abort check (forced aborts, poll counters)\n");
+            printf("K: Cycle transform kernel (SSE4.1 / 32-bit split / 64-bit)\n");
+            printf("U: Transform kernel test (each kernel against 64-bit)\n");
+#if GS3D_THREADS
+            printf("F: Cycle pool threads (transform, depth, sort)\n");
+            printf("Q: Thread scaling report, 1 to N threads\n");
+#endif
+            printf("T: Start/stop binary frame trace (%s)\n", TRACE_FILE);
             printf("N: Load new model\n");
             printf("H: Display this help message\n");
             printf("ESC: Quit program\n");
@@ -2271,6 +7965,18 @@ newmodel:
         globalPolyHandle = NULL;
     }
     
+    traceClose();
+    viewCacheFlush();
+    if (tile_bins != NULL) {
+        free(tile_bins);
+        tile_bins = NULL;
+    }
+    fbRelease(&frame_buffer);
+    if (offscreen_handle != NULL) {
+        DisposeHandle(offscreen_handle);
+        offscreen_handle = NULL;
+        offscreen_pixels = NULL;
+    }
     destroyModel3D(model);
     return 0;
 }
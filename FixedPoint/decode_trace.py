@@ -0,0 +1,169 @@
+import sys
+import struct
+
+# Offline decoder for the binary frame trace written by GS3Df (key 'T',
+# or every frame with ENABLE_DEBUG_SAVE). Rebuilds the text report that
+# saveDebugData used to write on the IIGS (debug.txt), one per frame.
+
+TRACE_MAGIC = 0x47533354  # "GS3T"
+
+# Header values are 4 bytes little-endian whatever sizeof(long) is.
+# Version 2 adds sizeof_fixed; version 1 Fixed32 arrays are 4 bytes.
+# Version 3 adds has_source: the faces were reordered into clusters at
+# load and the frame ends with the loaded (OBJ order) number of each face.
+HEADER_FIELDS = ['magic', 'version', 'frame', 'vertex_count', 'face_count',
+                 'total_indices', 'draw_count', 'angle_h', 'angle_v', 'angle_w',
+                 'distance', 'cull_mode', 'subpixel_area_min',
+                 'sizeof_int', 'sizeof_index', 'sizeof_offset', 'sizeof_fixed',
+                 'has_source']
+HEADER_LONGS = {1: 16, 2: 17, 3: 18}
+
+INT_FORMATS = {1: 'B', 2: 'h', 4: 'i'}
+UINT_FORMATS = {1: 'B', 2: 'H', 4: 'I'}
+
+def fixed_to_float(val):
+    return val / 65536.0
+
+def read_array(f, fmt, count):
+    size = struct.calcsize('<' + fmt)
+    data = f.read(size * count)
+    if len(data) != size * count:
+        raise EOFError('truncated trace')
+    return list(struct.unpack('<%d%s' % (count, fmt), data))
+
+def read_frame(f):
+    start = f.tell()
+    raw = f.read(8)
+    if not raw:
+        return None
+    if len(raw) != 8:
+        raise EOFError('truncated frame header')
+    magic, version = struct.unpack('<2l', raw)
+    if magic != TRACE_MAGIC:
+        raise ValueError('bad magic at frame offset %d' % start)
+    if version not in HEADER_LONGS:
+        raise ValueError('unknown trace version %d' % version)
+    count = HEADER_LONGS[version]
+    raw += f.read(4 * (count - 2))
+    if len(raw) != 4 * count:
+        raise EOFError('truncated frame header')
+    header = dict(zip(HEADER_FIELDS, struct.unpack('<%dl' % count, raw)))
+    header.setdefault('sizeof_fixed', 4)
+    header.setdefault('has_source', 0)
+    nv = header['vertex_count']
+    nf = header['face_count']
+    fmt_int = INT_FORMATS[header['sizeof_int']]
+    fmt_fixed = INT_FORMATS[header['sizeof_fixed']]
+    frame = {'header': header}
+    for name in ('x', 'y', 'z', 'xo', 'yo', 'zo'):
+        frame[name] = read_array(f, fmt_fixed, nv)
+    frame['x2d'] = read_array(f, fmt_int, nv)
+    frame['y2d'] = read_array(f, fmt_int, nv)
+    frame['vertex_count'] = read_array(f, 'B', nf)
+    frame['vertex_indices_ptr'] = read_array(f, UINT_FORMATS[header['sizeof_offset']], nf)
+    frame['vertex_indices_buffer'] = read_array(f, UINT_FORMATS[header['sizeof_index']], header['total_indices'])
+    frame['z_max'] = read_array(f, fmt_fixed, nf)
+    frame['display_flag'] = read_array(f, 'B', (nf + 7) // 8)
+    frame['sorted_face_indices'] = read_array(f, fmt_int, nf)
+    if header['has_source']:
+        frame['source'] = read_array(f, fmt_int, nf)
+    else:
+        frame['source'] = list(range(nf))
+    return frame
+
+def face_indices(frame, i):
+    offset = frame['vertex_indices_ptr'][i]
+    return frame['vertex_indices_buffer'][offset:offset + frame['vertex_count'][i]]
+
+def write_report(out, frame):
+    # Same layout as the former saveDebugData() text file
+    nv = frame['header']['vertex_count']
+    counts = frame['vertex_count']
+    out.write("Triangles detected: %d\n" % sum(1 for c in counts if c == 3))
+    out.write("Quadrilaterals detected: %d\n" % sum(1 for c in counts if c == 4))
+    out.write("Other polygons: %d\n" % sum(1 for c in counts if c not in (3, 4)))
+    out.write("\n")
+    out.write("=== VERTICES ===\n")
+    out.write("Format: Index | X3D Y3D Z3D | X2D Y2D\n")
+    out.write("--------------------------------------\n")
+    for i in range(nv):
+        out.write("V%03d | %8.3f %8.3f %8.3f | %4d %4d\n" % (
+            i + 1, fixed_to_float(frame['x'][i]), fixed_to_float(frame['y'][i]),
+            fixed_to_float(frame['z'][i]), frame['x2d'][i], frame['y2d'][i]))
+    out.write("\n")
+    out.write("=== FACES ===\n")
+    for i in range(len(counts)):
+        indices = face_indices(frame, i)
+        if frame['source'][i] != i:
+            out.write("Face F%03d (%d vertices, OBJ face %d):\n" % (i + 1, counts[i], frame['source'][i] + 1))
+        else:
+            out.write("Face F%03d (%d vertices):\n" % (i + 1, counts[i]))
+        out.write("  Indices: " + ", ".join("V%d" % v for v in indices) + "\n")
+        out.write("  Coordinates:\n")
+        for v in indices:
+            k = v - 1
+            if 0 <= k < nv:
+                out.write("    V%d: 3D(%.3f, %.3f, %.3f) -> 2D(%d, %d)\n" % (
+                    v, fixed_to_float(frame['x'][k]), fixed_to_float(frame['y'][k]),
+                    fixed_to_float(frame['z'][k]), frame['x2d'][k], frame['y2d'][k]))
+            else:
+                out.write("    V%d: ERROR - Index out of bounds!\n" % v)
+        out.write("\n")
+    out.write("=== INTEGRITY CHECK ===\n")
+    errors = 0
+    for i in range(len(counts)):
+        for v in face_indices(frame, i):
+            if v < 1 or v > nv:
+                out.write("ERROR: Face F%d references non-existent vertex V%d (index %d out of bounds [1-%d])\n" % (
+                    i + 1, v, v, nv))
+                errors += 1
+    if errors == 0:
+        out.write("No errors detected - All indices are valid.\n")
+    else:
+        out.write("TOTAL: %d errors detected!\n" % errors)
+
+def write_render_state(out, frame):
+    # Data the text report never had: observer space, depths, draw order
+    h = frame['header']
+    out.write("\n=== RENDER STATE ===\n")
+    out.write("Observer: angle_h=%.1f angle_v=%.1f angle_w=%.1f distance=%.3f\n" % (
+        fixed_to_float(h['angle_h']), fixed_to_float(h['angle_v']),
+        fixed_to_float(h['angle_w']), fixed_to_float(h['distance'])))
+    out.write("Cull mode: %d, sub-pixel threshold: %d, faces to draw: %d\n" % (
+        h['cull_mode'], h['subpixel_area_min'], h['draw_count']))
+    out.write("Vertex\txo\tyo\tzo\n")
+    for i in range(h['vertex_count']):
+        out.write("%d\t%.4f\t%.4f\t%.4f\n" % (i + 1, fixed_to_float(frame['xo'][i]),
+                  fixed_to_float(frame['yo'][i]), fixed_to_float(frame['zo'][i])))
+    out.write("Draw order (face, OBJ face, z_max, visible):\n")
+    for face in frame['sorted_face_indices'][:h['draw_count']]:
+        visible = (frame['display_flag'][face >> 3] >> (face & 7)) & 1
+        out.write("F%03d\t%d\t%.4f\t%d\n" % (face + 1, frame['source'][face] + 1,
+                  fixed_to_float(frame['z_max'][face]), visible))
+
+def main():
+    if len(sys.argv) < 2:
+        print("Usage: python decode_trace.py tracefile [frame] [--state]")
+        sys.exit(1)
+    wanted = None
+    state = '--state' in sys.argv
+    args = [a for a in sys.argv[2:] if a != '--state']
+    if args:
+        wanted = int(args[0])
+    with open(sys.argv[1], 'rb') as f:
+        while True:
+            frame = read_frame(f)
+            if frame is None:
+                break
+            number = frame['header']['frame']
+            if wanted is not None and number != wanted:
+                continue
+            out_name = 'debug_%04d.txt' % number
+            with open(out_name, 'w') as out:
+                write_report(out, frame)
+                if state:
+                    write_render_state(out, frame)
+            print("Frame %d written to %s" % (number, out_name))
+
+if __name__ == '__main__':
+    main()
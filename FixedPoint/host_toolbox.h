@@ -0,0 +1,136 @@
+/*
+ * ============================================================================
+ *                  HOST_TOOLBOX.H - Headless IIGS toolbox stand-ins
+ * ============================================================================
+ *
+ * Included by GS3Df.cc instead of the ORCA/C toolbox headers when the
+ * compiler is not ORCA/C (host profile, GS3D_LARGE_MODELS). Everything the
+ * viewer touches outside standard C gets a plain C stand-in here, so the
+ * same source builds with any C99 compiler:
+ *
+ *   cc -x c -std=gnu99 -O2 -pthread -o gs3df FixedPoint/GS3Df.cc -lm
+ *
+ * BEHAVIOUR:
+ *   - QuickDraw II calls do nothing: the pipeline (load, transform, cull,
+ *     sort, software rasterizer) runs, the QuickDraw painter draws nothing
+ *   - Memory Manager handles are malloc blocks behind a master pointer
+ *   - GetTick counts 1/60 s ticks of wall time (CLOCK_MONOTONIC), like the
+ *     VBL counter: CPU time would add up the thread pool workers
+ *   - Keyboard: the main loop reads one byte per key from stdin (EOF = ESC);
+ *     KBD_DATA is a plain variable, 0 unless a poll hook or test sets it
+ *   - Super Hi-Res memory is a static 32000-byte array
+ *
+ * NOTES:
+ *   - Types keep the IIGS field names, with 16-bit Rect/Point fields
+ *   - No windows, events or sound: the viewer never uses them
+ * ============================================================================
+ */
+
+#ifndef HOST_TOOLBOX_H
+#define HOST_TOOLBOX_H
+
+#include <stdint.h>
+#include <time.h>
+
+// --- Toolbox types ---
+typedef uint8_t Byte;
+typedef uint16_t Word;
+typedef uint32_t LongWord;
+typedef void *Pointer;
+typedef Pointer *Handle;                // Master pointer, as on the IIGS
+
+typedef struct { int16_t v1, h1, v2, h2; } Rect;
+typedef struct { int16_t v, h; } Point;
+typedef Byte Pattern[32];
+
+typedef struct {
+    Word portSCB;
+    Pointer ptrToPixImage;
+    Word width;
+    Rect boundsRect;
+} LocInfo;
+
+typedef struct {
+    LocInfo portInfo;
+    Rect portRect;
+} GrafPort, *GrafPortPtr;
+
+// --- Memory Manager ---
+#define attrLocked  0x8000
+#define attrFixed   0x4000
+#define attrNoCross 0x0010
+#define attrPage    0x0004
+
+static Handle NewHandle(long size, Word owner, Word attributes, Pointer location) {
+    Handle h = (Handle)malloc(sizeof(Pointer));
+    (void)owner; (void)attributes; (void)location;
+    if (h == NULL) return NULL;
+    *h = malloc(size > 0 ? (size_t)size : 1);
+    if (*h == NULL) {
+        free(h);
+        return NULL;
+    }
+    return h;
+}
+static void DisposeHandle(Handle h) {
+    if (h != NULL) {
+        free(*h);
+        free(h);
+    }
+}
+static void HLock(Handle h) { (void)h; }
+static void HUnlock(Handle h) { (void)h; }
+static Word userid(void) { return 0; }
+
+// --- Misc tools ---
+static long GetTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 60 + (long)(ts.tv_nsec / (1000000000L / 60));
+}
+
+// --- QuickDraw II (no output) ---
+static GrafPort host_screen_port;
+static GrafPortPtr host_port = &host_screen_port;
+
+static void SetRect(Rect *r, int h1, int v1, int h2, int v2) {
+    r->h1 = (int16_t)h1; r->v1 = (int16_t)v1; r->h2 = (int16_t)h2; r->v2 = (int16_t)v2;
+}
+static void OffsetRect(Rect *r, int dh, int dv) {
+    r->h1 += dh; r->h2 += dh; r->v1 += dv; r->v2 += dv;
+}
+static void ClipRect(Rect *r) { (void)r; }
+static void PaintRect(Rect *r) { (void)r; }
+static void FrameRect(Rect *r) { (void)r; }
+static void FillPoly(Handle poly, Pattern pat) { (void)poly; (void)pat; }
+static void FramePoly(Handle poly) { (void)poly; }
+static void SetSolidPenPat(int color) { (void)color; }
+static void GetPenPat(Pattern pat) { memset(pat, 0, sizeof(Pattern)); }
+static void SetPenMode(int pen_mode) { (void)pen_mode; }
+static void MoveTo(int h, int v) { (void)h; (void)v; }
+static void LineTo(int h, int v) { (void)h; (void)v; }
+static void DrawString(Pointer str) { (void)str; }
+static void SetColorEntry(Word table, Word entry, Word color) { (void)table; (void)entry; (void)color; }
+static void SetPortLoc(LocInfo *loc) { host_port->portInfo = *loc; }
+static void OpenPort(GrafPortPtr port) { memset(port, 0, sizeof(GrafPort)); }
+static void ClosePort(GrafPortPtr port) { (void)port; }
+static void SetPort(GrafPortPtr port) { host_port = port; }
+static GrafPortPtr GetPort(void) { return host_port; }
+
+// --- ORCA/C library (orca.h, asm.h) ---
+static void startgraph(int graph_mode) { (void)graph_mode; }
+static void endgraph(void) { }
+static void shroff(void) { }
+static int keypress(void) { return 0; }  // "Hit a key" prompts do not consume script keys
+
+// --- Hardware ---
+static unsigned char host_kbd_data = 0;        // KBD_DATA / KBD_STROBE (see GS3Df.cc)
+static Byte host_shr_screen[32000];            // SHR_SCREEN
+
+// Next key of the stdin script (main loop); end of input quits
+static int hostReadKey(void) {
+    int c = getchar();
+    return (c == EOF) ? 27 : (c & 0x7F);
+}
+
+#endif
@@ -60,8 +60,9 @@
 #define PERFORMANCE_MODE 0      // 1 = no printf, 0 = normal printf
 
 #define MAX_LINE_LENGTH 256     // Maximum file line size
-#define MAX_VERTICES 1000       // Maximum vertices in a 3D model
-#define MAX_FACES 1000          // Maximum faces in a 3D model
+#define INITIAL_VERTICES 64     // Initial vertex array capacity (doubled as needed)
+#define INITIAL_FACES 64        // Initial face array capacity (doubled as needed)
+#define MAX_ARRAY_CAPACITY 32767 // Largest element count an int can index
 #define MAX_FACE_VERTICES 20    // Maximum vertices per face (polygon)
 #define PI 3.14159265359        // Mathematical constant Pi
 #define CENTRE_X 160            // Screen center in X (320/2)
@@ -190,7 +191,8 @@ typedef struct {
  *   face_count    : Actual number of loaded faces
  * 
  * MEMORY MANAGEMENT:
- *   - Arrays are dynamically allocated (malloc)
+ *   - Arrays are dynamically allocated (malloc) and grow by doubling
+ *     (realloc) while the file is read, so there is no fixed model limit
  *   - Allows exceeding Apple IIGS stack limits
  *   - Mandatory cleanup with destroyModel3D()
  * 
@@ -205,6 +207,8 @@ typedef struct {
     Face3D *faces;          // Dynamic face array of the model
     int vertex_count;       // Actual number of loaded vertices
     int face_count;         // Actual number of loaded faces
+    int vertex_capacity;    // Allocated vertex slots (grows by doubling)
+    int face_capacity;      // Allocated face slots (grows by doubling)
 } Model3D;
 
 // ============================================================================
@@ -225,8 +229,8 @@ typedef struct {
  * 
  * PARAMETERS:
  *   filename     : OBJ filename to read
- *   vertices     : Destination array to store vertices
- *   max_vertices : Maximum array size (overflow protection)
+ *   vertices     : Address of the destination array (may be reallocated)
+ *   capacity     : Address of the array capacity (updated when it grows)
  * 
  * RETURN:
  *   Number of successfully read vertices, or -1 on error
@@ -235,7 +239,7 @@ typedef struct {
  *   v 1.234 5.678 9.012
  *   v -2.5 0.0 3.14
  */
-int readVertices(const char* filename, Vertex3D* vertices, int max_vertices);
+int readVertices(const char* filename, Vertex3D** vertices, int* capacity);
 
 /**
  * readFaces
@@ -246,8 +250,8 @@ int readVertices(const char* filename, Vertex3D* vertices, int max_vertices);
  * 
  * PARAMETERS:
  *   filename   : OBJ filename to read
- *   faces      : Destination array to store faces
- *   max_faces  : Maximum array size (overflow protection)
+ *   faces      : Address of the destination array (may be reallocated)
+ *   capacity   : Address of the array capacity (updated when it grows)
  * 
  * RETURN:
  *   Number of successfully read faces, or -1 on error
@@ -256,7 +260,24 @@ int readVertices(const char* filename, Vertex3D* vertices, int max_vertices);
  *   f 1 2 3        (triangle with vertices 1, 2, 3)
  *   f 4 5 6 7      (quadrilateral with vertices 4, 5, 6, 7)
  */
-int readFaces(const char* filename, Face3D* faces, int max_faces);
+int readFaces(const char* filename, Face3D** faces, int* capacity);
+
+/**
+ * growArray
+ * 
+ * DESCRIPTION:
+ *   Doubles the capacity of a dynamic array with realloc(). Amortized
+ *   cost per element stays constant however large the model is.
+ * 
+ * PARAMETERS:
+ *   array        : Address of the array pointer (updated on success)
+ *   capacity     : Address of the current capacity (updated on success)
+ *   element_size : Size of one element in bytes
+ * 
+ * RETURN:
+ *   0 on success, -1 if memory is exhausted (array left unchanged)
+ */
+int growArray(void** array, int* capacity, size_t element_size);
 
 /**
  * 3D GEOMETRIC TRANSFORMATION FUNCTIONS
@@ -401,8 +422,8 @@ void delay(int seconds);
  * 
  * MEMORY MANAGEMENT:
  *   - Main structure allocation
- *   - Vertex array allocation (MAX_VERTICES)
- *   - Face array allocation (MAX_FACES)
+ *   - Vertex array allocation (INITIAL_VERTICES, grows on load)
+ *   - Face array allocation (INITIAL_FACES, grows on load)
  *   - Automatic cleanup on partial failure
  */
 Model3D* createModel3D(void);
@@ -542,8 +563,8 @@ void delay(int seconds) {
  * 
  * ALLOCATION STRATEGY:
  * 1. Main Model3D structure allocation
- * 2. Vertex array allocation (MAX_VERTICES elements)
- * 3. Face array allocation (MAX_FACES elements)
+ * 2. Vertex array allocation (INITIAL_VERTICES elements)
+ * 3. Face array allocation (INITIAL_FACES elements)
  * 4. On failure: cleanup of previous allocations
  * 
  * ERROR HANDLING:
@@ -559,16 +580,16 @@ Model3D* createModel3D(void) {
     }
     
     // Step 2: Vertex array allocation
-    // Size: MAX_VERTICES * sizeof(Vertex3D) bytes
-    model->vertices = (Vertex3D*)malloc(MAX_VERTICES * sizeof(Vertex3D));
+    // Size: INITIAL_VERTICES * sizeof(Vertex3D) bytes, doubled by readVertices()
+    model->vertices = (Vertex3D*)malloc(INITIAL_VERTICES * sizeof(Vertex3D));
     if (model->vertices == NULL) {
         free(model);  // Cleanup: free main structure
         return NULL;  // Vertex array allocation failed
     }
     
     // Step 3: Face array allocation
-    // Size: MAX_FACES * sizeof(Face3D) bytes
-    model->faces = (Face3D*)malloc(MAX_FACES * sizeof(Face3D));
+    // Size: INITIAL_FACES * sizeof(Face3D) bytes, doubled by readFaces()
+    model->faces = (Face3D*)malloc(INITIAL_FACES * sizeof(Face3D));
     if (model->faces == NULL) {
         free(model->vertices);  // Cleanup: free vertex array
         free(model);            // Cleanup: free main structure
@@ -578,6 +599,8 @@ Model3D* createModel3D(void) {
     // Step 4: Counter initialization
     model->vertex_count = 0;    // No vertices loaded initially
     model->face_count = 0;      // No faces loaded initially
+    model->vertex_capacity = INITIAL_VERTICES;
+    model->face_capacity = INITIAL_FACES;
     
     return model;  // Success: return initialized model
 }
@@ -642,13 +665,13 @@ int loadModel3D(Model3D* model, const char* filename) {
     }
     
     // Step 1: Read vertices from OBJ file
-    model->vertex_count = readVertices(filename, model->vertices, MAX_VERTICES);
+    model->vertex_count = readVertices(filename, &model->vertices, &model->vertex_capacity);
     if (model->vertex_count < 0) {
         return -1;  // Critical failure: unable to read vertices
     }
     
     // Step 2: Read faces from OBJ file
-    model->face_count = readFaces(filename, model->faces, MAX_FACES);
+    model->face_count = readFaces(filename, &model->faces, &model->face_capacity);
     if (model->face_count < 0) {
         // Critical failure: unable to read vertices
         printf("\nWarning: Unable to read faces\n");
@@ -972,8 +995,9 @@ void processModelFast(Model3D* model, ObserverParams* params) {
  * - Array overflow protection
  * - Coordinate format validation
  */
-int readVertices(const char* filename, Vertex3D* vertices, int max_vertices) {
+int readVertices(const char* filename, Vertex3D** vertex_array, int* capacity) {
     FILE *file;
+    Vertex3D* vertices = *vertex_array;
     char line[MAX_LINE_LENGTH];
     int line_number = 1;
     int vertex_count = 0;
@@ -995,7 +1019,11 @@ int readVertices(const char* filename, Vertex3D* vertices, int max_vertices) {
         
         // Check if line starts with "v " (vertex - standard OBJ format)
         if (line[0] == 'v' && line[1] == ' ') {
-            if (vertex_count < max_vertices) {
+            if (vertex_count == *capacity &&
+                growArray((void**)vertex_array, capacity, sizeof(Vertex3D)) == 0) {
+                vertices = *vertex_array;
+            }
+            if (vertex_count < *capacity) {
                 float x, y, z;  // Temporary reading in float
                 // Extract coordinates x, y, z
                 if (sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3) {
@@ -1008,7 +1036,7 @@ int readVertices(const char* filename, Vertex3D* vertices, int max_vertices) {
                     //        vertex_count, x, y, z);
                 }
             } else {
-                printf("     -> WARNING: Vertex limit reached (%d)\n", max_vertices);
+                printf("     -> WARNING: Vertex limit reached (%d)\n", *capacity);
             }
         }
         
@@ -1022,9 +1050,36 @@ int readVertices(const char* filename, Vertex3D* vertices, int max_vertices) {
     return vertex_count;  // Return the number of vertices read
 }
 
+/**
+ * DYNAMIC ARRAY GROWTH
+ * ====================
+ * 
+ * Doubles the capacity with realloc(), clamped to MAX_ARRAY_CAPACITY.
+ * On failure the old block is kept, so the caller simply stops adding
+ * elements (same behavior as the former fixed limit, but only when
+ * memory is really exhausted).
+ */
+int growArray(void** array, int* capacity, size_t element_size) {
+    int new_capacity;
+    void* grown;
+    
+    if (*capacity >= MAX_ARRAY_CAPACITY) {
+        return -1;
+    }
+    new_capacity = (*capacity > MAX_ARRAY_CAPACITY / 2) ? MAX_ARRAY_CAPACITY : *capacity * 2;
+    grown = realloc(*array, (size_t)new_capacity * element_size);
+    if (grown == NULL) {
+        return -1;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
 // Function to read faces from a 3D file
-int readFaces(const char* filename, Face3D* faces, int max_faces) {
+int readFaces(const char* filename, Face3D** face_array, int* capacity) {
     FILE *file;
+    Face3D* faces = *face_array;
     char line[MAX_LINE_LENGTH];
     char *token;
     int line_number = 1;
@@ -1045,7 +1100,11 @@ int readFaces(const char* filename, Face3D* faces, int max_faces) {
     while (fgets(line, sizeof(line), file) != NULL) {
         // Check if line starts with "f " (face)
         if (line[0] == 'f' && line[1] == ' ') {
-            if (face_count < max_faces) {
+            if (face_count == *capacity &&
+                growArray((void**)face_array, capacity, sizeof(Face3D)) == 0) {
+                faces = *face_array;
+            }
+            if (face_count < *capacity) {
                 // printf("%3d: %s", line_number, line);
                 
                 faces[face_count].vertex_count = 0;
@@ -1098,7 +1157,7 @@ int readFaces(const char* filename, Face3D* faces, int max_faces) {
                     face_count++;
                 }
             } else {
-                printf("     -> WARNING: Face limit reached (%d)\n", max_faces);
+                printf("     -> WARNING: Face limit reached (%d)\n", *capacity);
             }
         }
         